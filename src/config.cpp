@@ -0,0 +1,125 @@
+#include "config.h"
+
+#include "shared.h"
+#include "status_codes.h"
+
+#include <exception>
+
+/*---------------------------------------------------------------*/
+
+struct Config_Option {
+    const char* name;
+    int datatype;
+    void* value;
+};
+
+static Config_Option config_options [] = {
+    { "memoization",               CONFIG_BOOL,    &MEMOIZATION               },
+    { "memo_capacity",             CONFIG_INT,     &MEMO_CAPACITY             },
+    { "result_cache",              CONFIG_STRING,  &RESULT_CACHE              },
+    { "building_attribution",      CONFIG_BOOL,    &BUILDING_ATTRIBUTION      },
+    { "tile_huge_pages",           CONFIG_INT,     &TILE_HUGE_PAGES           },
+    { "numa_policy",               CONFIG_INT,     &NUMA_POLICY               },
+    { "tile_layout",               CONFIG_INT,     &TILE_LAYOUT               },
+    { "height_quantisation",       CONFIG_BOOL,    &HEIGHT_QUANTISATION       },
+    { "height_quantisation_step",  CONFIG_DOUBLE,  &HEIGHT_QUANTISATION_STEP  },
+    { "tile_compression",          CONFIG_BOOL,    &TILE_COMPRESSION          },
+    { "block_cache_size",          CONFIG_INT,     &BLOCK_CACHE_SIZE          },
+    { "region_archive",            CONFIG_STRING,  &REGION_ARCHIVE            },
+    { "resampled_tile_cache",      CONFIG_BOOL,    &RESAMPLED_TILE_CACHE      },
+    { "lazy_geotiff_tiles",        CONFIG_BOOL,    &LAZY_GEOTIFF_TILES        },
+    { "remote_geotiff_tiles",      CONFIG_BOOL,    &REMOTE_GEOTIFF_TILES      },
+    { "tile_buffer_pool_size",     CONFIG_INT,     &TILE_BUFFER_POOL_SIZE     },
+    { "tile_cache_budget_dgm",     CONFIG_INT,     &TILE_CACHE_BUDGET_DGM     },
+    { "tile_cache_budget_dom",     CONFIG_INT,     &TILE_CACHE_BUDGET_DOM     },
+    { "tile_cache_budget_lod2",    CONFIG_INT,     &TILE_CACHE_BUDGET_LOD2    },
+    { "prefetch_threads",          CONFIG_INT,     &PREFETCH_THREADS          },
+    { "download_connections",      CONFIG_INT,     &DOWNLOAD_CONNECTIONS      },
+    { "memory_downloads",          CONFIG_BOOL,    &MEMORY_DOWNLOADS          },
+    { "persist_downloads",         CONFIG_BOOL,    &PERSIST_DOWNLOADS         }
+};
+
+#define N_CONFIG_OPTIONS ( sizeof(config_options) / sizeof(Config_Option) )
+
+/*---------------------------------------------------------------*/
+
+int setConfigOption ( std::string option, std::string value ) {
+    for ( uint i = 0; i < N_CONFIG_OPTIONS; i++ ) {
+        if ( option != config_options[i].name ) {
+            continue;
+        }
+
+        try {
+            switch ( config_options[i].datatype ) {
+                case CONFIG_BOOL:
+                    if ( value == "true" || value == "on" || value == "1" ) {
+                        *(bool*)config_options[i].value = true;
+                    }
+                    else if ( value == "false" || value == "off" || value == "0" ) {
+                        *(bool*)config_options[i].value = false;
+                    }
+                    else {
+                        return INVALID_TYPE_FOR_OPTION;
+                    }
+                    break;
+
+                case CONFIG_INT:
+                    *(int*)config_options[i].value = std::stoi( value );
+                    break;
+
+                case CONFIG_DOUBLE:
+                    *(double*)config_options[i].value = std::stod( value );
+                    break;
+
+                case CONFIG_STRING:
+                    *(std::string*)config_options[i].value = value;
+                    break;
+
+                default:
+                    return UNKNOWN_CONFIG_DATATYPE;
+            }
+        }
+        catch ( std::exception& e ) {
+            return INVALID_TYPE_FOR_OPTION;
+        }
+
+        return SUCCESS;
+    }
+
+    return UNKNOWN_CONFIG_OPTION;
+} /* setConfigOption() */
+
+/*---------------------------------------------------------------*/
+
+int getConfigOption ( std::string option, std::string& value ) {
+    for ( uint i = 0; i < N_CONFIG_OPTIONS; i++ ) {
+        if ( option != config_options[i].name ) {
+            continue;
+        }
+
+        switch ( config_options[i].datatype ) {
+            case CONFIG_BOOL:
+                value = *(bool*)config_options[i].value ? "true" : "false";
+                break;
+
+            case CONFIG_INT:
+                value = std::to_string( *(int*)config_options[i].value );
+                break;
+
+            case CONFIG_DOUBLE:
+                value = std::to_string( *(double*)config_options[i].value );
+                break;
+
+            case CONFIG_STRING:
+                value = *(std::string*)config_options[i].value;
+                break;
+
+            default:
+                return UNKNOWN_CONFIG_DATATYPE;
+        }
+
+        return SUCCESS;
+    }
+
+    return UNKNOWN_CONFIG_OPTION;
+} /* getConfigOption() */
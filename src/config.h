@@ -0,0 +1,48 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+
+/*
+Data types of the configuration options
+*/
+enum ConfigDatatypes {
+    CONFIG_BOOL,
+    CONFIG_INT,
+    CONFIG_DOUBLE,
+    CONFIG_STRING
+};
+
+/*
+Set a configuration option (global variable in shared.h) by its name
+
+Args:
+ - option : Name of the option
+ - value  : Value of the option as a string
+            (Booleans: "true"/"false", "on"/"off", "1"/"0")
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - UNKNOWN_CONFIG_OPTION
+    - INVALID_TYPE_FOR_OPTION
+*/
+int setConfigOption ( std::string option, std::string value );
+
+/*
+Return the value of a configuration option as a string
+
+Args:
+ - option : Name of the option
+ - value  : Reference to the string to store the value in
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - UNKNOWN_CONFIG_OPTION
+*/
+int getConfigOption ( std::string option, std::string& value );
+
+#endif
@@ -2,19 +2,464 @@
 
 #include "../status_codes.h"
 #include "../tile/tile_types.h"
+#include "../tile/tile_allocator.h"
+#include "../tile/grid_tile.h"
+
+#include "../shared.h"
+#include "../statistics.h"
+#include "../worker_pool.h"
+
+#include "../web/remote_file.h"
 
 #include <tiffio.h>
 #include <gdal.h>
+#include <cpl_vsi.h>
 #include <cstring>
 #include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*---------------------------------------------------------------*/
 
 #define FLOAT_SIZE 4
 
-union sample {
-    uint8_t bytes [FLOAT_SIZE];
-    float f32;
+// GeoTIFF tags with the georeferencing of the raster
+#define GEOTIFF_TAG_PIXEL_SCALE  33550
+#define GEOTIFF_TAG_TIEPOINT     33922
+
+/*---------------------------------------------------------------*/
+
+/*
+GeoTIFF file in memory read by libtiff (See TIFFClientOpen)
+*/
+struct Memory_Tiff {
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+};
+
+static tmsize_t memoryTiffRead ( thandle_t handle, void* buf, tmsize_t size ) {
+    Memory_Tiff* file = (Memory_Tiff*) handle;
+
+    if ( file->position >= file->size ) {
+        return 0;
+    }
+
+    size_t n_bytes = std::min( (size_t) size, file->size - file->position );
+    memcpy( buf, file->data + file->position, n_bytes );
+    file->position += n_bytes;
+
+    return n_bytes;
+} /* memoryTiffRead() */
+
+static tmsize_t memoryTiffWrite ( thandle_t handle, void* buf, tmsize_t size ) {
+    return 0;
+} /* memoryTiffWrite() */
+
+static toff_t memoryTiffSeek ( thandle_t handle, toff_t offset, int whence ) {
+    Memory_Tiff* file = (Memory_Tiff*) handle;
+
+    switch ( whence ) {
+        case SEEK_SET: file->position = offset;               break;
+        case SEEK_CUR: file->position += offset;              break;
+        case SEEK_END: file->position = file->size + offset;  break;
+    }
+
+    return file->position;
+} /* memoryTiffSeek() */
+
+static int memoryTiffClose ( thandle_t handle ) {
+    return 0;
+} /* memoryTiffClose() */
+
+static toff_t memoryTiffSize ( thandle_t handle ) {
+    return ( (Memory_Tiff*) handle )->size;
+} /* memoryTiffSize() */
+
+// libtiff reads the strips and tiles directly from the memory
+static int memoryTiffMap ( thandle_t handle, void** base, toff_t* size ) {
+    *base = (void*)( (Memory_Tiff*) handle )->data;
+    *size = ( (Memory_Tiff*) handle )->size;
+
+    return 1;
+} /* memoryTiffMap() */
+
+static void memoryTiffUnmap ( thandle_t handle, void* base, toff_t size ) {
+} /* memoryTiffUnmap() */
+
+/*
+Open a GeoTIFF file in memory with libtiff
+
+Args:
+ - file : Reference to the file (must stay valid until TIFFClose)
+
+Returns:
+ - TIFF handle (NULL if the file is not a valid TIFF file)
+*/
+static TIFF* openMemoryTiff ( Memory_Tiff& file ) {
+    file.position = 0;
+
+    return TIFFClientOpen(
+        "GeoTIFF", "r", (thandle_t) &file,
+        memoryTiffRead, memoryTiffWrite, memoryTiffSeek, memoryTiffClose,
+        memoryTiffSize, memoryTiffMap, memoryTiffUnmap
+    );
+} /* openMemoryTiff() */
+
+/*---------------------------------------------------------------*/
+
+/*
+GeoTIFF file on a web server read by libtiff with range requests
+(See RemoteFile)
+*/
+struct Remote_Tiff {
+    RemoteFile* file;
+    size_t position;
+};
+
+static tmsize_t remoteTiffRead ( thandle_t handle, void* buf, tmsize_t size ) {
+    Remote_Tiff* file = (Remote_Tiff*) handle;
+
+    long n_bytes = file->file->read( file->position, buf, size );
+    if ( n_bytes < 0 ) {
+        return -1;
+    }
+    file->position += n_bytes;
+
+    return n_bytes;
+} /* remoteTiffRead() */
+
+static toff_t remoteTiffSeek ( thandle_t handle, toff_t offset, int whence ) {
+    Remote_Tiff* file = (Remote_Tiff*) handle;
+
+    switch ( whence ) {
+        case SEEK_SET: file->position = offset;                          break;
+        case SEEK_CUR: file->position += offset;                         break;
+        case SEEK_END: file->position = file->file->getSize() + offset;  break;
+    }
+
+    return file->position;
+} /* remoteTiffSeek() */
+
+static toff_t remoteTiffSize ( thandle_t handle ) {
+    return ( (Remote_Tiff*) handle )->file->getSize();
+} /* remoteTiffSize() */
+
+// The file is not in memory, libtiff reads the blocks with remoteTiffRead
+static int remoteTiffMap ( thandle_t handle, void** base, toff_t* size ) {
+    return 0;
+} /* remoteTiffMap() */
+
+/*
+Open a GeoTIFF file on a web server with libtiff
+Only the header is fetched
+
+Args:
+ - file : Reference to the file (must stay valid until TIFFClose)
+
+Returns:
+ - TIFF handle (NULL if the file is not a valid TIFF file)
+*/
+static TIFF* openRemoteTiff ( Remote_Tiff& file ) {
+    file.position = 0;
+
+    return TIFFClientOpen(
+        "GeoTIFF", "rm", (thandle_t) &file,
+        remoteTiffRead, memoryTiffWrite, remoteTiffSeek, memoryTiffClose,
+        remoteTiffSize, remoteTiffMap, memoryTiffUnmap
+    );
+} /* openRemoteTiff() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Layout of the strips or internal tiles (blocks) of a GeoTIFF file
+*/
+struct GeoTiff_Block_Layout {
+    uint32_t image_width;
+
+    // Internal tiles or strips (width = image width)
+    bool tiled;
+    uint32_t block_width, block_height;
+
+    uint32_t blocks_per_row, n_blocks;
+};
+
+/*
+Read the layout of the blocks of a GeoTIFF file
+
+Args:
+ - tiff   : TIFF handle
+ - layout : Reference to the layout to store the result in
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - FILE_CORRUPT
+*/
+static int readBlockLayout ( TIFF* tiff, GeoTiff_Block_Layout& layout ) {
+    uint32_t
+        image_width = 0,
+        image_height = 0;
+    uint16_t
+        bits_per_sample = 0,
+        samples_per_pixel = 1;
+
+    TIFFGetField( tiff, TIFFTAG_IMAGEWIDTH, &image_width );
+    TIFFGetField( tiff, TIFFTAG_IMAGELENGTH, &image_height );
+    TIFFGetField( tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample );
+    TIFFGetField( tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel );
+
+    // The tiles are square grids of 32 bit floats
+    if (
+        image_width == 0 || image_width != image_height ||
+        bits_per_sample != 32 || samples_per_pixel != 1
+    ) {
+        return FILE_CORRUPT;
+    }
+
+    layout.image_width = image_width;
+    layout.tiled = TIFFIsTiled( tiff );
+
+    if ( layout.tiled ) {
+        layout.block_width = 0;
+        layout.block_height = 0;
+        TIFFGetField( tiff, TIFFTAG_TILEWIDTH, &layout.block_width );
+        TIFFGetField( tiff, TIFFTAG_TILELENGTH, &layout.block_height );
+        layout.n_blocks = TIFFNumberOfTiles( tiff );
+    }
+    else {
+        uint32_t rows_per_strip = image_height;
+        TIFFGetField( tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip );
+
+        layout.block_width = image_width;
+        layout.block_height = std::min( rows_per_strip, image_height );
+        layout.n_blocks = TIFFNumberOfStrips( tiff );
+    }
+
+    if ( layout.block_width == 0 || layout.block_height == 0 ) {
+        return FILE_CORRUPT;
+    }
+
+    layout.blocks_per_row = ( image_width + layout.block_width - 1 ) / layout.block_width;
+
+    return SUCCESS;
+} /* readBlockLayout() */
+
+/*
+Position of a block of a GeoTIFF file in the image (rows from top to bottom)
+
+Args:
+ - layout    : Layout of the blocks
+ - block     : Index of the block
+ - block_x   : Reference for the first column
+ - block_y   : Reference for the first row
+ - n_columns : Reference for the number of columns inside the image
+ - n_rows    : Reference for the number of rows inside the image
+*/
+static void geoTiffBlockRegion (
+    const GeoTiff_Block_Layout& layout,
+    uint32_t block,
+    uint32_t& block_x, uint32_t& block_y,
+    uint32_t& n_columns, uint32_t& n_rows
+) {
+    if ( layout.tiled ) {
+        block_x = ( block % layout.blocks_per_row ) * layout.block_width;
+        block_y = ( block / layout.blocks_per_row ) * layout.block_height;
+    }
+    else {
+        block_x = 0;
+        block_y = block * layout.block_height;
+    }
+
+    n_columns = std::min( layout.block_width, layout.image_width - block_x );
+    n_rows    = std::min( layout.block_height, layout.image_width - block_y );
+} /* geoTiffBlockRegion() */
+
+/*
+Decode a block of a GeoTIFF file into the data array
+
+Args:
+ - tiff   : TIFF handle
+ - layout : Layout of the blocks
+ - block  : Index of the block
+ - buf    : Array with space for block_width*block_height floats
+ - data   : Array of image_width*image_width floats (rows from bottom to top)
+
+Returns:
+ - Block decoded?
+*/
+static bool decodeGeoTiffBlock (
+    TIFF* tiff,
+    const GeoTiff_Block_Layout& layout,
+    uint32_t block,
+    float* buf,
+    float* data
+) {
+    uint32_t
+        width = layout.image_width,
+        block_width = layout.block_width,
+        block_x, block_y, n_columns, n_rows;
+
+    tmsize_t
+        block_size = (tmsize_t) block_width * layout.block_height * FLOAT_SIZE,
+        n_bytes;
+
+    if ( layout.tiled ) {
+        n_bytes = TIFFReadEncodedTile( tiff, block, buf, block_size );
+    }
+    else {
+        n_bytes = TIFFReadEncodedStrip( tiff, block, buf, block_size );
+    }
+
+    if ( n_bytes < 0 ) {
+        return false;
+    }
+
+    geoTiffBlockRegion( layout, block, block_x, block_y, n_columns, n_rows );
+
+    // In TIFF files the rows are stored from top to bottom whereas
+    // the tiles are accessed from bottom to top since the northing
+    // increases towards the north
+    for ( uint32_t row = 0; row < n_rows; row++ ) {
+        memcpy(
+            &data[ (size_t)( width - 1 - (block_y + row) ) * width + block_x ],
+            &buf[ (size_t) row * block_width ],
+            n_columns * FLOAT_SIZE
+        );
+    }
+
+    return true;
+} /* decodeGeoTiffBlock() */
+
+/*
+Map a file into memory (read only)
+
+Args:
+ - file_path : Path to the file
+ - size      : Reference to store the size of the file in
+
+Returns:
+ - Pointer to the mapping (NULL if the file can't be mapped)
+*/
+static void* mapFile ( std::string file_path, size_t& size ) {
+    int fd = open( file_path.data(), O_RDONLY );
+    if ( fd < 0 ) {
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if ( fstat(fd, &file_stat) != 0 || file_stat.st_size == 0 ) {
+        close( fd );
+        return NULL;
+    }
+
+    size = file_stat.st_size;
+    void* mapping = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+
+    return ( mapping == MAP_FAILED ) ? NULL : mapping;
+} /* mapFile() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Blocks of a GeoTIFF file decoded by one task of the worker pool
+*/
+struct GeoTiff_Decode_Thread_Data {
+    Memory_Tiff file;
+    GeoTiff_Block_Layout layout;
+
+    // Destination (rows from bottom to top)
+    float* data;
+
+    uint32_t first_block, end_block;
+
+    bool success;
+};
+
+void* Thread_decodeGeoTiff ( void* arg ) {
+    GeoTiff_Decode_Thread_Data* data = (GeoTiff_Decode_Thread_Data*) arg;
+
+    data->success = false;
+
+    // libtiff handles must not be shared between threads
+    TIFF* tiff = openMemoryTiff( data->file );
+    if ( tiff == NULL ) {
+        return NULL;
+    }
+
+    float* buf = new float [ (size_t) data->layout.block_width * data->layout.block_height ];
+
+    data->success = true;
+
+    for ( uint32_t block = data->first_block; block < data->end_block; block++ ) {
+        if ( !decodeGeoTiffBlock(tiff, data->layout, block, buf, data->data) ) {
+            data->success = false;
+            break;
+        }
+    }
+
+    delete[] buf;
+    TIFFClose( tiff );
+
+    return NULL;
+} /* Thread_decodeGeoTiff() */
+
+/*---------------------------------------------------------------*/
+
+/*
+GeoTIFF file whose blocks are decoded on demand
+(See GeoTiffFile::openGeoTiffFile and GeoTiffFile::openRemoteGeoTiffFile)
+*/
+struct GeoTiff_Lazy_Blocks {
+    // Local file mapped into memory
+    void* mapping = NULL;
+    size_t mapping_size = 0;
+    Memory_Tiff file;
+
+    // Remote file
+    RemoteFile* remote = NULL;
+    Remote_Tiff remote_file;
+
+    TIFF* tiff = NULL;
+
+    GeoTiff_Block_Layout layout;
+    float* buf = NULL;
+
+    // 1 bit per block, set once the block has been decoded into the data
+    std::vector<std::atomic<uint8_t>> decoded;
+
+    // Byte ranges of the blocks of a remote file (empty if unknown)
+    std::vector<uint64_t> block_offsets, block_sizes;
+
+    // Serializes the decoding (the TIFF handle is shared)
+    pthread_mutex_t mutex;
+
+    GeoTiff_Lazy_Blocks ( uint32_t n_blocks ) : decoded( (n_blocks + 7) / 8 ) {
+        pthread_mutex_init( &mutex, NULL );
+    }
+
+    ~GeoTiff_Lazy_Blocks () {
+        delete[] buf;
+        if ( tiff != NULL ) {
+            TIFFClose( tiff );
+        }
+        if ( mapping != NULL ) {
+            munmap( mapping, mapping_size );
+        }
+        delete remote;
+        pthread_mutex_destroy( &mutex );
+    }
 };
 
 /*---------------------------------------------------------------*/
@@ -25,104 +470,308 @@ int GeoTiffFile::readGeoTiffFile ( std::string file_path, int tile_type ) {
         return INVALID_TILE_TYPE;
     }
 
-    TIFF* tiff = TIFFOpen( file_path.data(), "r" );
-    if ( tiff == NULL ) {
+    // The file is opened once and shared by all decoding threads
+    if ( !FILE_EXISTS(file_path.data()) ) {
         return FILE_NOT_FOUND;
     }
 
-    uint32_t
-        image_width,
-        buf_size;
+    size_t file_size;
+    void* mapping = mapFile( file_path, file_size );
+    if ( mapping == NULL ) {
+        return FILE_CORRUPT;
+    }
 
-    TIFFGetField( tiff, TIFFTAG_IMAGEWIDTH, &image_width );
+    Memory_Tiff file = { (const uint8_t*) mapping, file_size, 0 };
 
-    uint8_t* buf;
-    data = new float [image_width * image_width];
+    int status = decodeGeoTiff( file );
 
-    //tile_width = image_width;
+    munmap( mapping, file_size );
 
-    union sample current_sample;
+    if ( status != SUCCESS ) {
+        return status;
+    }
 
-    int
-        pixel_it = 0,
-        dst_it = 0,
-        x = 0;
+    return readOrigin( file_path, tile_type );
+} /* readGeoTiffFile () */
 
+/*---------------------------------------------------------------*/
 
-    // In case of a DGM1 GeoTIFF file, the data is presented in lines
-    // from top to bottom
-    if ( tile_type == DGM1 || tile_type == DOM20_MASKED ) {
-        buf_size = TIFFScanlineSize(tiff);
-        buf = new uint8_t [buf_size];
+int GeoTiffFile::readGeoTiffBuffer ( const uint8_t* data, size_t size, std::string file_name, int tile_type ) {
 
-        for ( size_t i = 0; i < image_width; i++ ) {
-            TIFFReadScanline( tiff, buf, i, 0 );
+    if ( tile_type != DGM1  && tile_type != DOM20 && tile_type != DOM20_MASKED ) {
+        return INVALID_TILE_TYPE;
+    }
 
-            for ( size_t j = 0; j < buf_size; j++ ) {
-                current_sample.bytes[pixel_it] = buf[j];
-                pixel_it++;
+    Memory_Tiff file = { data, size, 0 };
 
-                if ( pixel_it == FLOAT_SIZE ) {
-                    data[dst_it] = current_sample.f32;
-                    dst_it++;
-                    pixel_it = 0;
-                    x++;
-                }
-            }
-            x = 0;
-        }
+    int status = decodeGeoTiff( file );
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    if ( georeferenced || tile_type == DOM20_MASKED ) {
+        return readOrigin( file_name, tile_type );
     }
 
-    // In case of a DOM20 GeoTIFF file, the data is presented as a grid
-    // of tiles
-    else if ( tile_type == DOM20 ) {
-        uint32_t tiff_tile_width;
-        TIFFGetField( tiff, TIFFTAG_TILEWIDTH, &tiff_tile_width );
+    // GDAL reads the origin from the memory (the path is unique per object)
+    char vsi_dir [64];
+    snprintf( vsi_dir, sizeof(vsi_dir), "/vsimem/geotiff_%p/", (void*) this );
+    std::string vsi_path = vsi_dir + file_name;
+
+    VSILFILE* vsi_file = VSIFileFromMemBuffer( vsi_path.data(), (GByte*) data, size, FALSE );
+    if ( vsi_file == NULL ) {
+        return FILE_CORRUPT;
+    }
+    VSIFCloseL( vsi_file );
 
-        buf_size = tiff_tile_width * tiff_tile_width * sizeof(float);
-        buf = new uint8_t [buf_size];
+    status = readOrigin( vsi_path, tile_type );
 
+    VSIUnlink( vsi_path.data() );
 
-        uint32_t
-            x_grid,
-            y_grid,
-            index;
+    return status;
+} /* readGeoTiffBuffer () */
+
+/*---------------------------------------------------------------*/
 
-        for ( size_t y = 0; y < image_width; y += tiff_tile_width ) {
-            for ( size_t x = 0; x < image_width; x += tiff_tile_width ) {
-                TIFFReadTile( tiff, buf, x, y, 0, 0 );
+int GeoTiffFile::openGeoTiffFile ( std::string file_path, int tile_type ) {
+
+    if ( tile_type != DGM1  && tile_type != DOM20 && tile_type != DOM20_MASKED ) {
+        return INVALID_TILE_TYPE;
+    }
 
-                for ( size_t i = 0; i < tiff_tile_width; i++ ) {
-                    for ( size_t j = 0; j < tiff_tile_width; j++ ) {
-                        x_grid = x + j;
-                        y_grid = y + i;
+    if ( !FILE_EXISTS(file_path.data()) ) {
+        return FILE_NOT_FOUND;
+    }
 
-                        if ( x_grid >= image_width || y_grid >= image_width ) {
-                            break;
-                        }
+    size_t file_size;
+    void* mapping = mapFile( file_path, file_size );
+    if ( mapping == NULL ) {
+        return FILE_CORRUPT;
+    }
 
-                        memcpy(
-                            current_sample.bytes,
-                            &buf[i*tiff_tile_width*FLOAT_SIZE+j*FLOAT_SIZE],
-                            FLOAT_SIZE
-                        );
+    Memory_Tiff file = { (const uint8_t*) mapping, file_size, 0 };
 
-                        index = y_grid * image_width + x_grid;
+    GeoTiff_Block_Layout layout;
 
-                        data[index] = current_sample.f32;
-                    }
-                }
-            }
+    TIFF* tiff = openMemoryTiff( file );
+    if ( tiff == NULL || readHeader(tiff, layout) != SUCCESS ) {
+        if ( tiff != NULL ) {
+            TIFFClose( tiff );
         }
+        munmap( mapping, file_size );
+        return FILE_CORRUPT;
+    }
+    TIFFClose( tiff );
+
+    closeLazyBlocks();
+
+    lazy_blocks = new GeoTiff_Lazy_Blocks( layout.n_blocks );
+    lazy_blocks->mapping = mapping;
+    lazy_blocks->mapping_size = file_size;
+    lazy_blocks->file = file;
+    lazy_blocks->layout = layout;
+    lazy_blocks->buf = new float [ (size_t) layout.block_width * layout.block_height ];
+
+    // The handle refers to the copy of the file in lazy_blocks
+    lazy_blocks->tiff = openMemoryTiff( lazy_blocks->file );
+    if ( lazy_blocks->tiff == NULL ) {
+        closeLazyBlocks();
+        return FILE_CORRUPT;
+    }
+
+    RUN_STATISTICS.lazy_blocks_total += layout.n_blocks;
+
+    return readOrigin( file_path, tile_type );
+} /* openGeoTiffFile () */
+
+/*---------------------------------------------------------------*/
+
+int GeoTiffFile::openRemoteGeoTiffFile ( std::string url, std::string file_path, int tile_type ) {
+
+    if ( tile_type != DGM1  && tile_type != DOM20 ) {
+        return INVALID_TILE_TYPE;
+    }
+
+    RemoteFile* remote = new RemoteFile;
+
+    int status = remote->open( url, file_path );
+    if ( status != SUCCESS ) {
+        delete remote;
+        return status;
     }
 
+    Remote_Tiff file = { remote, 0 };
+
+    GeoTiff_Block_Layout layout;
+
+    // The origin can't be read with GDAL from the partial file
+    TIFF* tiff = openRemoteTiff( file );
+    if ( tiff == NULL || readHeader(tiff, layout) != SUCCESS || !georeferenced ) {
+        if ( tiff != NULL ) {
+            TIFFClose( tiff );
+        }
+        delete remote;
+        return FILE_CORRUPT;
+    }
     TIFFClose( tiff );
-    delete[] buf;
 
-    if ( tile_type != DOM20_MASKED ) {
+    closeLazyBlocks();
+
+    lazy_blocks = new GeoTiff_Lazy_Blocks( layout.n_blocks );
+    lazy_blocks->remote = remote;
+    lazy_blocks->remote_file = file;
+    lazy_blocks->layout = layout;
+    lazy_blocks->buf = new float [ (size_t) layout.block_width * layout.block_height ];
+
+    lazy_blocks->tiff = openRemoteTiff( lazy_blocks->remote_file );
+    if ( lazy_blocks->tiff == NULL ) {
+        closeLazyBlocks();
+        return FILE_CORRUPT;
+    }
+
+    // The byte ranges of the blocks are fetched before decoding them
+    // (See decodeBlock)
+    toff_t *offsets = NULL, *sizes = NULL;
+    if (
+        TIFFGetField( lazy_blocks->tiff, layout.tiled ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS, &offsets ) &&
+        TIFFGetField( lazy_blocks->tiff, layout.tiled ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS, &sizes ) &&
+        offsets != NULL && sizes != NULL
+    ) {
+        lazy_blocks->block_offsets.assign( offsets, offsets + layout.n_blocks );
+        lazy_blocks->block_sizes.assign( sizes, sizes + layout.n_blocks );
+    }
+
+    RUN_STATISTICS.lazy_blocks_total += layout.n_blocks;
+
+    return readOrigin( file_path, tile_type );
+} /* openRemoteGeoTiffFile () */
+
+/*---------------------------------------------------------------*/
+
+bool GeoTiffFile::getRemoteValidator ( size_t& size, std::string& validator ) const {
+    if ( lazy_blocks == NULL || lazy_blocks->remote == NULL ) {
+        return false;
+    }
+
+    size = lazy_blocks->remote->getSize();
+    validator = lazy_blocks->remote->getValidator();
+
+    return true;
+} /* getRemoteValidator () */
+
+/*---------------------------------------------------------------*/
+
+int GeoTiffFile::decodeBlockAt ( uint x, uint y ) const {
+    if ( lazy_blocks == NULL ) {
+        return SUCCESS;
+    }
+
+    const GeoTiff_Block_Layout& layout = lazy_blocks->layout;
+
+    // y is counted from the bottom, the blocks from the top
+    uint32_t
+        tiff_y = layout.image_width - 1 - y,
+        block = ( tiff_y / layout.block_height ) * layout.blocks_per_row;
+
+    if ( layout.tiled ) {
+        block += x / layout.block_width;
+    }
+
+    return decodeBlock( block );
+} /* decodeBlockAt () */
+
+int GeoTiffFile::decodeAllBlocks () const {
+    if ( lazy_blocks == NULL ) {
+        return SUCCESS;
+    }
+
+    int status = SUCCESS;
+
+    for ( uint32_t block = 0; block < lazy_blocks->layout.n_blocks; block++ ) {
+        int block_status = decodeBlock( block );
+        if ( block_status != SUCCESS ) {
+            status = block_status;
+        }
+    }
+
+    return status;
+} /* decodeAllBlocks () */
+
+int GeoTiffFile::decodeBlock ( uint32_t block ) const {
+    std::atomic<uint8_t>& bits = lazy_blocks->decoded[block >> 3];
+    uint8_t bit = 1 << (block & 7);
+
+    if ( bits.load(std::memory_order_acquire) & bit ) {
+        return SUCCESS;
+    }
+
+    // The bytes of a remote block are fetched before taking the mutex,
+    // so the blocks of a file are downloaded in parallel and only the
+    // decoding with the shared TIFF handle is serialized
+    if ( lazy_blocks->remote != NULL && block < lazy_blocks->block_offsets.size() ) {
+        int fetch_status = lazy_blocks->remote->fetch(
+            lazy_blocks->block_offsets[block], lazy_blocks->block_sizes[block]
+        );
+        if ( fetch_status != SUCCESS ) {
+            return FILE_CORRUPT;
+        }
+    }
+
+    int status = SUCCESS;
+
+    pthread_mutex_lock( &lazy_blocks->mutex );
+
+    // The block may have been decoded while waiting for the mutex
+    if ( !(bits.load(std::memory_order_relaxed) & bit) ) {
+        if ( decodeGeoTiffBlock(lazy_blocks->tiff, lazy_blocks->layout, block, lazy_blocks->buf, data) ) {
+            bits.fetch_or( bit, std::memory_order_release );
+            RUN_STATISTICS.lazy_blocks_decoded++;
+        }
+        else {
+            // The cells stay undecoded and must not be read, the block is
+            // decoded again with the next access (e.g. after a failed
+            // range request)
+            status = FILE_CORRUPT;
+        }
+    }
+
+    pthread_mutex_unlock( &lazy_blocks->mutex );
+
+    return status;
+} /* decodeBlock () */
+
+/*---------------------------------------------------------------*/
+
+void GeoTiffFile::closeLazyBlocks () {
+    if ( lazy_blocks != NULL ) {
+        delete lazy_blocks;
+        lazy_blocks = NULL;
+    }
+} /* closeLazyBlocks () */
+
+/*---------------------------------------------------------------*/
+
+int GeoTiffFile::readOrigin ( std::string file_path, int tile_type ) {
+    if ( tile_type == DOM20_MASKED ) {
+        tile_name = extractFilename( file_path );
+        tile_name = removeFileEnding( tile_name );
+        tile_name = tile_name.substr( 2, 8 );
+
+        std::string tile_name_parts [2];
+        splitString( tile_name, tile_name_parts, '_' );
+
+        utm_origin_x = std::stoi( tile_name_parts[0] ) * 1000;
+        utm_origin_y = std::stoi( tile_name_parts[1] ) * 1000;
+
+        tile_width = 5000;
+
+        return SUCCESS;
+    }
+
+    // Files without the GeoTIFF tags readable by libtiff
+    if ( !georeferenced ) {
         GDALDatasetH hDataset = GDALOpen( file_path.data(), GA_ReadOnly );
         if ( hDataset == NULL ) {
-            GDALClose( hDataset );
             return FILE_NOT_FOUND;
         }
 
@@ -138,27 +787,96 @@ int GeoTiffFile::readGeoTiffFile ( std::string file_path, int tile_type ) {
 
         utm_origin_x = (uint)( gt[0] + 0 * gt[1] + height * gt[2] );
         utm_origin_y = (uint)( gt[3] + 0 * gt[4] + height * gt[5] );
-        tile_width = height;
+    }
+
+    tile_name = buildTileName( utm_origin_x/1000, utm_origin_y/1000 );
 
-        tile_name = buildTileName( utm_origin_x/1000, utm_origin_y/1000 );
+    return SUCCESS;
+} /* readOrigin () */
+
+/*---------------------------------------------------------------*/
+
+int GeoTiffFile::readHeader ( TIFF* tiff, GeoTiff_Block_Layout& layout ) {
+    if ( readBlockLayout(tiff, layout) != SUCCESS ) {
+        return FILE_CORRUPT;
     }
-    else {
-        tile_name = extractFilename( file_path );
-        tile_name = removeFileEnding( tile_name );
-        tile_name = tile_name.substr( 2, 8 );
 
-        std::string tile_name_parts [2];
-        splitString( tile_name, tile_name_parts, '_' );
+    // Georeferencing from the GeoTIFF tags (the origin is rounded to
+    // meters, so that pixel-is-point rasters give the same origin)
+    uint32_t n_scale = 0, n_tiepoint = 0;
+    double *scale = NULL, *tiepoint = NULL;
 
-        utm_origin_x = std::stoi( tile_name_parts[0] ) * 1000;
-        utm_origin_y = std::stoi( tile_name_parts[1] ) * 1000;
+    georeferenced =
+        TIFFGetField( tiff, GEOTIFF_TAG_PIXEL_SCALE, &n_scale, &scale ) && n_scale >= 2 &&
+        TIFFGetField( tiff, GEOTIFF_TAG_TIEPOINT, &n_tiepoint, &tiepoint ) && n_tiepoint >= 6;
 
-        tile_width = 5000;
+    if ( georeferenced ) {
+        double
+            origin_x = tiepoint[3] - tiepoint[0] * scale[0],
+            top_y    = tiepoint[4] + tiepoint[1] * scale[1];
+
+        utm_origin_x = (uint) round( origin_x );
+        utm_origin_y = (uint) round( top_y - layout.image_width * scale[1] );
     }
 
+    if ( data_memalloc ) {
+        freeTileBuffer( data );
+    }
+    data = allocateTileArray<float>( (size_t) layout.image_width * layout.image_width );
     data_memalloc = true;
+
+    tile_width = layout.image_width;
+
     return SUCCESS;
-} /* readGeoTiffFile () */
+} /* readHeader() */
+
+/*---------------------------------------------------------------*/
+
+int GeoTiffFile::decodeGeoTiff ( Memory_Tiff& file ) {
+    TIFF* tiff = openMemoryTiff( file );
+    if ( tiff == NULL ) {
+        return FILE_CORRUPT;
+    }
+
+    GeoTiff_Block_Layout layout;
+
+    int status = readHeader( tiff, layout );
+    TIFFClose( tiff );
+
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    closeLazyBlocks();
+
+    // Decode the blocks in parallel on the worker pool
+    int n_threads = ( MAX_THREADS > 0 ) ? MAX_THREADS : NUM_CORES;
+    if ( (uint32_t) n_threads > layout.n_blocks ) {
+        n_threads = layout.n_blocks;
+    }
+
+    std::vector<GeoTiff_Decode_Thread_Data> thread_data( n_threads );
+    std::vector<void*> args;
+
+    for ( int i = 0; i < n_threads; i++ ) {
+        thread_data[i].file = { file.data, file.size, 0 };
+        thread_data[i].layout = layout;
+        thread_data[i].data = data;
+        thread_data[i].first_block = (uint64_t) layout.n_blocks * i / n_threads;
+        thread_data[i].end_block = (uint64_t) layout.n_blocks * (i+1) / n_threads;
+
+        args.push_back( (void*)&thread_data[i] );
+    }
+
+    WORKER_POOL.run( Thread_decodeGeoTiff, args );
+
+    bool success = true;
+    for ( int i = 0; i < n_threads; i++ ) {
+        success = success && thread_data[i].success;
+    }
+
+    return success ? SUCCESS : FILE_CORRUPT;
+} /* decodeGeoTiff() */
 
 /*---------------------------------------------------------------*/
 
@@ -171,7 +889,10 @@ GeoTiffFile::GeoTiffFile( const GeoTiffFile& old_geotiff ) {
 
     uint len = tile_width * tile_width;
 
-    data = new float [len];
+    // The copy is not lazy
+    old_geotiff.decodeAllBlocks();
+
+    data = allocateTileArray<float>( len );
     memcpy( data, old_geotiff.getData(), len*FLOAT_SIZE );
 
     tile_name = old_geotiff.getTileName();
@@ -179,9 +900,38 @@ GeoTiffFile::GeoTiffFile( const GeoTiffFile& old_geotiff ) {
     data_memalloc = true;
 } /* GeoTiffFile() */
 
+GeoTiffFile::GeoTiffFile( GeoTiffFile&& old_geotiff ) {
+    *this = std::move( old_geotiff );
+} /* GeoTiffFile() */
+
+GeoTiffFile& GeoTiffFile::operator= ( GeoTiffFile&& old_geotiff ) {
+    if ( this == &old_geotiff ) {
+        return *this;
+    }
+
+    closeLazyBlocks();
+    if ( data_memalloc ) {
+        freeTileBuffer( data );
+    }
+
+    tile_width = old_geotiff.tile_width;
+    utm_origin_x = old_geotiff.utm_origin_x;
+    utm_origin_y = old_geotiff.utm_origin_y;
+    georeferenced = old_geotiff.georeferenced;
+    tile_name = std::move( old_geotiff.tile_name );
+
+    // The data array is handed over, the old object is left empty
+    data = std::exchange( old_geotiff.data, nullptr );
+    data_memalloc = std::exchange( old_geotiff.data_memalloc, false );
+    lazy_blocks = std::exchange( old_geotiff.lazy_blocks, nullptr );
+
+    return *this;
+} /* operator=() */
+
 GeoTiffFile::~GeoTiffFile () {
+    closeLazyBlocks();
     if ( data_memalloc ) {
-        delete[] data;
+        freeTileBuffer( data );
     }
 } /* ~GeoTiffFile () */
 
@@ -191,6 +941,19 @@ float* GeoTiffFile::getData () const {
     return data;
 } /* getData () */
 
+float* GeoTiffFile::releaseData () {
+    // The remaining blocks can't be decoded into the array afterwards
+    decodeAllBlocks();
+    closeLazyBlocks();
+
+    float* released_data = data;
+
+    data = NULL;
+    data_memalloc = false;
+
+    return released_data;
+} /* releaseData () */
+
 /*---------------------------------------------------------------*/
 
 std::string GeoTiffFile::getTileName () const {
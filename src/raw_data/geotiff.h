@@ -5,6 +5,12 @@
 
 #include <string>
 
+struct Memory_Tiff;
+struct GeoTiff_Block_Layout;
+struct GeoTiff_Lazy_Blocks;
+
+typedef struct tiff TIFF;
+
 /*
 Class to read and save the content of a GeoTIFF file
 */
@@ -18,11 +24,19 @@ public:
     /* Copy constructor */
     GeoTiffFile( const GeoTiffFile& old_geotiff );
 
+    /* Move constructor (takes over the data array of the old object) */
+    GeoTiffFile( GeoTiffFile&& old_geotiff );
+
+    /* Move assignment (takes over the data array of the old object) */
+    GeoTiffFile& operator= ( GeoTiffFile&& old_geotiff );
+
     /* DESTRUCTOR */
     ~GeoTiffFile();
 
     /*
     Create a GeoTiffFile object from a GeoTIFF file
+    The file is opened once and its strips or internal tiles are decoded
+    in parallel (MAX_THREADS threads) directly into the data array
 
     Args:
      - file_path : File path to the GeoTIFF file
@@ -34,16 +48,131 @@ public:
 
         - INVALID_TILE_TYPE
         - FILE_NOT_FOUND
+        - FILE_CORRUPT
     */
     int readGeoTiffFile( std::string file_path, int tile_type );
 
+    /*
+    Open a GeoTIFF file without decoding it
+    The file stays mapped into memory and its strips or internal tiles
+    (blocks) are only decoded into the data array when a cell of them is
+    needed (See decodeBlockAt)
+
+    Args:
+     - file_path : File path to the GeoTIFF file
+     - tile_type : Tile type (DGM1, DOM20, DOM20_MASKED)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_TILE_TYPE
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+    */
+    int openGeoTiffFile( std::string file_path, int tile_type );
+
+    /*
+    Open a GeoTIFF file on a web server without downloading it
+    Like openGeoTiffFile, but the header and the blocks are fetched with
+    HTTP range requests when they are needed and kept in a local cache
+    file, which becomes the local copy once it is complete (See RemoteFile)
+
+    Args:
+     - url       : URL of the GeoTIFF file
+     - file_path : Path of the local copy of the file
+     - tile_type : Tile type (DGM1, DOM20)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_TILE_TYPE
+        - FILE_NOT_FOUND
+        - FILE_NOT_CREATABLE
+        - FILE_CORRUPT (also if the file has no GeoTIFF tags)
+    */
+    int openRemoteGeoTiffFile( std::string url, std::string file_path, int tile_type );
+
+    /*
+    Return the size and the validator of the file opened with
+    openRemoteGeoTiffFile (See RemoteFile::getValidator)
+
+    Args:
+     - size      : Reference to store the size of the file in bytes in
+     - validator : Reference to store the validator in
+
+    Returns:
+     - Is the file a remote file?
+    */
+    bool getRemoteValidator( size_t& size, std::string& validator ) const;
+
+    /*
+    Create a GeoTiffFile object from a GeoTIFF file in memory
+    (e.g. a downloaded file that is not saved yet)
+    Like readGeoTiffFile, the file is decoded in parallel
+
+    Args:
+     - data      : Content of the GeoTIFF file
+     - size      : Size of the file in bytes
+     - file_name : Name of the file (DOM20_MASKED tiles are named after it)
+     - tile_type : Tile type (DGM1, DOM20, DOM20_MASKED)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_TILE_TYPE
+        - FILE_CORRUPT
+    */
+    int readGeoTiffBuffer( const uint8_t* data, size_t size, std::string file_name, int tile_type );
+
+    /*
+    Decode the block containing the cell (x,y) of a file opened with
+    openGeoTiffFile unless it is already decoded (thread-safe)
+    (No effect for files read with readGeoTiffFile)
+    The cells of a block that can't be decoded must not be read, the block
+    is decoded again with the next call.
+
+    Args:
+     - x : x coordinate of the cell
+     - y : y coordinate of the cell (counted from the bottom)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int decodeBlockAt ( uint x, uint y ) const;
+
+    /*
+    Decode all blocks of a file opened with openGeoTiffFile which are not
+    decoded yet (thread-safe, See decodeBlockAt)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int decodeAllBlocks () const;
+
     /* GETTERS */
 
     /*
     Return the array with the data from the GeoTIFF file
+    The rows are ordered from bottom (south) to top (north)
     */
     float* getData () const;
 
+    /*
+    Hand the data array over to the caller
+    The caller must free it with freeTileBuffer (See tile_allocator.h)
+    (The blocks of a file opened with openGeoTiffFile are decoded first)
+    */
+    float* releaseData ();
+
     /*
     Return the tile name
     */
@@ -65,7 +194,7 @@ public:
     uint getUtmOriginY () const;
 
 private:
-    float* data;
+    float* data = NULL;
     uint tile_width;
 
     uint
@@ -74,6 +203,74 @@ private:
 
     bool data_memalloc = false;
 
+    // Origin read from the GeoTIFF tags (See readHeader)
+    bool georeferenced = false;
+
     std::string tile_name;
+
+    // Blocks decoded on demand (See openGeoTiffFile)
+    GeoTiff_Lazy_Blocks* lazy_blocks = NULL;
+
+    /*
+    Read the layout of the blocks and the georeferencing of a GeoTIFF file
+    and allocate the data array
+
+    Args:
+     - tiff   : TIFF handle
+     - layout : Reference to the layout to store the result in
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int readHeader ( TIFF* tiff, GeoTiff_Block_Layout& layout );
+
+    /*
+    Set the origin and the name of the tile after reading the header
+    (The origin of DOM20_MASKED tiles is taken from the file name and the
+    origin of files without GeoTIFF tags is read with GDAL)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+    */
+    int readOrigin ( std::string file_path, int tile_type );
+
+    /*
+    Decode a GeoTIFF file in memory into the data array
+
+    Args:
+     - file : Reference to the file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int decodeGeoTiff ( Memory_Tiff& file );
+
+    /*
+    Decode a block of a file opened with openGeoTiffFile unless it is
+    already decoded (See decodeBlockAt)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int decodeBlock ( uint32_t block ) const;
+
+    /*
+    Close the file opened with openGeoTiffFile or openRemoteGeoTiffFile
+    (the decoded blocks are kept)
+    */
+    void closeLazyBlocks ();
 };
 #endif
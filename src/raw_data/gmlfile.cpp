@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <spanstream>
 
 /*---------------------------------------------------------------*/
 
@@ -81,7 +82,7 @@ Args:
  - file    : Reference to the file object
  - xml_tag : Tag in the beginning of the line
 */
-std::string getNextLineWithXmlTag( std::ifstream& file, std::string xml_tag ) {
+std::string getNextLineWithXmlTag( std::istream& file, std::string xml_tag ) {
     std::string line = "";
 
     if ( xml_tag.back() == '>' ) {
@@ -160,6 +161,21 @@ int GmlFile::readGmlFile ( std::string file_path ) {
         return FILE_NOT_FOUND;
     }
 
+    return readGml( gmlfile );
+} /* readGmlFile() */
+
+/*---------------------------------------------------------------*/
+
+int GmlFile::readGmlBuffer ( const char* data, size_t size ) {
+    // The lines are read directly from the memory without a copy
+    std::ispanstream gmlfile ( std::span<const char>( data, size ) );
+
+    return readGml( gmlfile );
+} /* readGmlBuffer() */
+
+/*---------------------------------------------------------------*/
+
+int GmlFile::readGml ( std::istream& gmlfile ) {
     std::string
         line,
         line_content;
@@ -238,7 +254,7 @@ int GmlFile::readGmlFile ( std::string file_path ) {
     }
     return SUCCESS;
 
-} /* readGmlFile() */
+} /* readGml() */
 
 /*---------------------------------------------------------------*/
 
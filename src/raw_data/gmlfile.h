@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <istream>
 
 #include "../geometry/vector.h"
 #include "surface.h"
@@ -30,6 +31,23 @@ public:
     */
     int readGmlFile ( std::string file_path );
 
+    /*
+    Read a GML file in memory (e.g. a downloaded file that is not saved
+    yet) (See readGmlFile)
+
+    Args:
+    - data : Content of the GML file
+    - size : Size of the file in bytes
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+        - NO_SURFACES
+    */
+    int readGmlBuffer ( const char* data, size_t size );
+
 
     /* GETTERS */
 
@@ -55,6 +73,12 @@ private:
         upper_corner;
 
     std::vector<Surface> surfaces;
+
+    /*
+    Read the surfaces and the corners from a stream with the content of
+    a GML file (See readGmlFile)
+    */
+    int readGml ( std::istream& gmlfile );
 };
 
 #endif
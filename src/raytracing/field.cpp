@@ -7,6 +7,8 @@
 #include "../tile/tile_types.h"
 #include "../status_codes.h"
 #include "../raw_data/surface.h"
+#include "../statistics.h"
+#include "../worker_pool.h"
 
 #include <exception>
 #include <unistd.h>
@@ -18,181 +20,604 @@
 
 /*---------------------------------------------------------------*/
 
-Field::Field () {
-    pthread_mutex_init( &dgm_mutex, NULL );
-    pthread_mutex_init( &dom_mutex, NULL );
-    pthread_mutex_init( &dom_masked_mutex, NULL );
+/*
+Return the time of a monotonic clock in microseconds
+*/
+static unsigned long monotonicTimeUs () {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (unsigned long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+} /* monotonicTimeUs() */
+
+/*---------------------------------------------------------------*/
+
+Field::Field () :
+    grid_tiles_dgm( &RUN_STATISTICS.tile_cache_dgm ),
+    grid_tiles_dom( &RUN_STATISTICS.tile_cache_dom ),
+    vector_tiles_lod2( &RUN_STATISTICS.tile_cache_lod2 ),
+    prefetcher( this )
+{
+    pthread_mutex_init( &building_mutex, NULL );
+    pthread_mutex_init( &footprint_mutex, NULL );
+
+    grid_tiles_dgm.setBudget( (size_t)TILE_CACHE_BUDGET_DGM * 1048576 );
+    grid_tiles_dom.setBudget( (size_t)TILE_CACHE_BUDGET_DOM * 1048576 );
+    vector_tiles_lod2.setBudget( (size_t)TILE_CACHE_BUDGET_LOD2 * 1048576 );
+
+    // ID 0 is reserved for cells without a building
+    building_names.push_back( "" );
+
+    if ( REGION_ARCHIVE != "" ) {
+        if ( region_archive.open(REGION_ARCHIVE) != SUCCESS ) {
+            printf( "WARNING: Unable to open the region archive \"%s\"\n", REGION_ARCHIVE.data() );
+        }
+    }
 
     GDALAllRegister();
 } /* Field() */
 
 /*---------------------------------------------------------------*/
 
-int Field::loadTile ( std::string tile_name, int tile_type ) {
-    GridTile grid_tile;
-    VectorTile vector_tile;
+int Field::readSourceTile ( std::string tile_name, int tile_type, GridTile& grid_tile ) {
+    int raw_tile_type;
+    double resample_factor;
 
-    int status;
-    if ( tile_type == DGM || tile_type == DOM || tile_type == DOM_MASKED ) {
-        double resample_factor;
+    switch ( tile_type ) {
+        case DGM:
+            raw_tile_type = DGM1;
+            resample_factor = 1.0 / GRID_RESOLUTION;
+            break;
+
+        // The footprint mask of the DOM_MASKED layer needs the LOD2 tile
+        // and is only attached when it is read (See maskGridTile)
+        case DOM:
+            raw_tile_type = DOM20;
+            resample_factor = 0.2 / GRID_RESOLUTION;
+            break;
+
+        case DOM_MASKED:
+            raw_tile_type = DOM20_MASKED;
+            resample_factor = 0.2 / GRID_RESOLUTION;
+            break;
 
-        switch ( tile_type ) {
-            case DGM:
-                status = getGridTile( grid_tile, tile_name, DGM1 );
-                if ( status != SUCCESS ) {
-                    return status;
-                }
-                resample_factor = 1.0 / GRID_RESOLUTION;
-                grid_tile.resampleTile( resample_factor );
+        default:
+            return TILE_NOT_AVAILABLE;
+    }
 
-                grid_tiles_dgm.insert( {tile_name, grid_tile} );
+    std::string tile_name_parts [2];
+    splitString( tile_name, tile_name_parts, '_' );
+
+    // The archive only holds the masked DOM tiles (the mask comes at no
+    // extra cost there)
+    bool from_archive =
+        region_archive.isOpen() &&
+        region_archive.getGridTile(
+            grid_tile,
+            std::stoi( tile_name_parts[0] ), std::stoi( tile_name_parts[1] ),
+            raw_tile_type == DOM20 ? DOM20_MASKED : raw_tile_type, GRID_RESOLUTION
+        ) == SUCCESS &&
+        ( raw_tile_type != DOM20_MASKED || !BUILDING_ATTRIBUTION || grid_tile.hasBuildingIds() );
+
+    if ( from_archive ) {
+        return SUCCESS;
+    }
 
-                break;
+    return getResampledGridTile( grid_tile, tile_name, raw_tile_type, resample_factor );
+} /* readSourceTile() */
 
-            case DOM:
-                status = getGridTile( grid_tile, tile_name, DOM20 );
-                if ( status != SUCCESS ) {
-                    return status;
-                }
-                resample_factor = 0.2 / GRID_RESOLUTION;
-                grid_tile.resampleTile( resample_factor );
+/*---------------------------------------------------------------*/
 
-                grid_tiles_dom.insert( {tile_name, grid_tile} );
+int Field::readGridTile ( std::string tile_name, int tile_type, GridTile& grid_tile ) {
+    int status = readSourceTile( tile_name, tile_type, grid_tile );
+    if ( status != SUCCESS ) {
+        return status;
+    }
 
-                break;
+    status = grid_tile.setLayout( TILE_LAYOUT );
 
-            case DOM_MASKED:
-                status = getGridTile( grid_tile, tile_name, DOM20_MASKED );
-                if ( status != SUCCESS ) {
-                    return status;
-                }
-                resample_factor = 0.2 / GRID_RESOLUTION;
-                grid_tile.resampleTile( resample_factor );
+    if ( status == SUCCESS && HEIGHT_QUANTISATION ) {
+        status = grid_tile.quantiseTile( HEIGHT_QUANTISATION_STEP );
+    }
+    if ( status == SUCCESS && TILE_COMPRESSION ) {
+        status = grid_tile.compressTile();
+    }
+    if ( status != SUCCESS ) {
+        return status;
+    }
 
-                grid_tiles_dom_masked.insert( {tile_name, grid_tile} );
+    if ( grid_tile.hasBuildingIds() ) {
+        registerBuildings( grid_tile );
+    }
 
-                break;
+    return SUCCESS;
+} /* readGridTile() */
+
+/*---------------------------------------------------------------*/
+
+int Field::loadGridTile (
+    uint tile_x, uint tile_y,
+    int tile_type,
+    Tile_Cache_Entry<GridTile>*& entry,
+    bool prefetch
+) {
+    TileCache<GridTile>* cache;
+
+    switch ( tile_type ) {
+        case DGM:
+            cache = &grid_tiles_dgm;
+            break;
+
+        case DOM:
+        case DOM_MASKED:
+            cache = &grid_tiles_dom;
+            break;
+
+        default:
+            return TILE_NOT_AVAILABLE;
+    }
+
+    std::string tile_name = buildTileName( tile_x, tile_y );
+
+    // The accesses of the prefetcher are not counted
+    entry = cache->acquire( tile_name, !prefetch );
+    if ( entry != NULL ) {
+        return SUCCESS;
+    }
+
+    unsigned long stall_start = monotonicTimeUs();
+
+    // Set if this thread loads the tile (and not another thread)
+    bool loaded = false;
+
+    int status = cache->load(
+        tile_name,
+        [&] ( GridTile& grid_tile ) {
+            loaded = true;
+            return readGridTile( tile_name, tile_type, grid_tile );
+        },
+        entry, prefetch
+    );
+
+    if ( prefetch ) {
+        if ( status == SUCCESS && loaded ) {
+            RUN_STATISTICS.prefetch_loads++;
+        }
+    }
+    else {
+        // The prefetcher might have been too late
+        if ( status == SUCCESS ) {
+            entry->prefetched = false;
         }
 
+        RUN_STATISTICS.tile_stalls++;
+        RUN_STATISTICS.tile_stall_time_us += monotonicTimeUs() - stall_start;
+    }
+
+    return status;
+} /* loadGridTile() */
+
+/*---------------------------------------------------------------*/
+
+int Field::maskGridTile ( Tile_Cache_Entry<GridTile>* entry ) {
+    GridTile& grid_tile = entry->tile;
+
+    pthread_mutex_lock( &footprint_mutex );
+    bool masked = grid_tile.hasFootprint() && ( !BUILDING_ATTRIBUTION || grid_tile.hasBuildingIds() );
+    pthread_mutex_unlock( &footprint_mutex );
+
+    if ( masked ) {
         return SUCCESS;
     }
-    else if ( tile_type == LOD2 ) {
-        status = getVectorTile( vector_tile, tile_name );
-        if ( status != SUCCESS ) {
-            return status;
+
+    // The mask is created without the lock, so other tiles are masked
+    // in parallel (threads masking the tiles under the same LOD2 tile
+    // wait for each other in getGridTile)
+    GridTile masked_tile;
+    int status = readSourceTile( entry->tile_name, DOM_MASKED, masked_tile );
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    if ( masked_tile.hasBuildingIds() ) {
+        registerBuildings( masked_tile );
+    }
+
+    pthread_mutex_lock( &footprint_mutex );
+
+    // Another thread might have masked the tile meanwhile
+    masked = grid_tile.hasFootprint() && ( !BUILDING_ATTRIBUTION || grid_tile.hasBuildingIds() );
+
+    if ( !masked ) {
+        status = grid_tile.takeFootprint( masked_tile );
+        if ( status == SUCCESS ) {
+            grid_tiles_dom.resize( entry, grid_tile.getMemorySize() );
         }
+    }
 
-        vector_tiles_lod2.insert( {tile_name, vector_tile} );
+    pthread_mutex_unlock( &footprint_mutex );
 
+    return status == SUCCESS ? SUCCESS : TILE_NOT_AVAILABLE;
+} /* maskGridTile() */
+
+/*---------------------------------------------------------------*/
+
+int Field::loadVectorTile (
+    std::string tile_name,
+    Tile_Cache_Entry<VectorTile>*& entry,
+    bool prefetch
+) {
+    // The accesses of the prefetcher are not counted
+    entry = vector_tiles_lod2.acquire( tile_name, !prefetch );
+    if ( entry != NULL ) {
         return SUCCESS;
     }
+
+    unsigned long stall_start = monotonicTimeUs();
+
+    // Set if this thread loads the tile (and not another thread)
+    bool loaded = false;
+
+    int status = vector_tiles_lod2.load(
+        tile_name,
+        [&] ( VectorTile& vector_tile ) -> int {
+            loaded = true;
+
+            std::string tile_name_parts [2];
+            splitString( tile_name, tile_name_parts, '_' );
+
+            bool from_archive =
+                region_archive.isOpen() &&
+                region_archive.getVectorTile(
+                    vector_tile, std::stoi( tile_name_parts[0] ), std::stoi( tile_name_parts[1] )
+                ) == SUCCESS;
+
+            if ( from_archive ) {
+                return SUCCESS;
+            }
+
+            vector_tile = VectorTile();
+            return getVectorTile( vector_tile, tile_name );
+        },
+        entry, prefetch
+    );
+
+    if ( prefetch ) {
+        if ( status == SUCCESS && loaded ) {
+            RUN_STATISTICS.prefetch_loads++;
+        }
+    }
     else {
-        return TILE_NOT_AVAILABLE;
+        // The prefetcher might have been too late
+        if ( status == SUCCESS ) {
+            entry->prefetched = false;
+        }
+
+        RUN_STATISTICS.tile_stalls++;
+        RUN_STATISTICS.tile_stall_time_us += monotonicTimeUs() - stall_start;
     }
-} /* loadTile() */
+
+    return status;
+} /* loadVectorTile() */
 
 /*---------------------------------------------------------------*/
 
-bool Field::tileAlreadyLoaded ( std::string tile_name, int tile_type ) {
-    switch ( tile_type ) {
-        case DGM:
-            return grid_tiles_dgm.contains( tile_name );
+void Field::prefetchTile ( Prefetch_Job& job ) {
+    if ( job.tile_type == LOD2 ) {
+        Tile_Cache_Entry<VectorTile>* entry;
+        if ( loadVectorTile( buildTileName(job.tile_x, job.tile_y), entry, true ) == SUCCESS ) {
+            vector_tiles_lod2.release( entry );
+        }
+        return;
+    }
 
-        case DOM:
-            return grid_tiles_dom.contains( tile_name );
+    // Tiles that can't be loaded are reported by the raytracing
+    Tile_Cache_Entry<GridTile>* entry;
+    if ( loadGridTile( job.tile_x, job.tile_y, job.tile_type, entry, true ) == SUCCESS ) {
+        ( job.tile_type == DGM ? grid_tiles_dgm : grid_tiles_dom ).release( entry );
+    }
+} /* prefetchTile() */
 
-        case DOM_MASKED:
-            return grid_tiles_dom_masked.contains( tile_name );
+/*---------------------------------------------------------------*/
 
-        case LOD2:
-            return vector_tiles_lod2.contains( tile_name );
+int Field::requestDownload ( Prefetch_Job& job, Download_Callback callback, void* arg ) {
+    // The tiles of the region archive are not downloaded
+    if ( region_archive.isOpen() ) {
+        return FILE_ALREADY_EXISTS;
+    }
+
+    // (The LOD2 tiles of the footprint masks are requested separately)
+    int raw_tile_type;
+
+    switch ( job.tile_type ) {
+        case DGM:  raw_tile_type = DGM1;         break;
+        case DOM:  raw_tile_type = DOM20;        break;
+        case LOD2: raw_tile_type = LOD2;         break;
 
         default:
-            return false;
+            return INVALID_TILE_TYPE;
     }
-} /* tileAlreadyLoaded() */
+
+    return requestTileDownload(
+        buildTileName( job.tile_x, job.tile_y ), raw_tile_type, callback, arg
+    );
+} /* requestDownload() */
 
 /*---------------------------------------------------------------*/
 
-double Field::getAltitudeAtXY ( double x, double y, int tile_type ) {
-    uint
-        tile_x = (uint)( x / 1000.0 ),
-        tile_y = (uint)( y / 1000.0 );
+void Field::prefetchLine ( Vector& start, Vector& end, int tile_type ) {
+    double
+        x_start = start.getX() / 1000.0,
+        y_start = start.getY() / 1000.0,
+        dx = end.getX() / 1000.0 - x_start,
+        dy = end.getY() / 1000.0 - y_start;
 
-    std::string tile_name = buildTileName( tile_x, tile_y );
+    int
+        tile_x = (int) x_start,
+        tile_y = (int) y_start,
+        tile_x_end = (int)( end.getX() / 1000.0 ),
+        tile_y_end = (int)( end.getY() / 1000.0 ),
+        step_x = ( dx >= 0.0 ) ? 1 : -1,
+        step_y = ( dy >= 0.0 ) ? 1 : -1;
+
+    // Line parameter (0 = start, 1 = end) at the next tile border on
+    // each axis and the distance between two tile borders
+    double
+        t_next_x = ( dx != 0.0 ) ? ( tile_x + (step_x > 0) - x_start ) / dx : INFINITY,
+        t_next_y = ( dy != 0.0 ) ? ( tile_y + (step_y > 0) - y_start ) / dy : INFINITY,
+        t_delta_x = ( dx != 0.0 ) ? step_x / dx : INFINITY,
+        t_delta_y = ( dy != 0.0 ) ? step_y / dy : INFINITY;
 
-    int status = 1;
+    int n_tiles = abs( tile_x_end - tile_x ) + abs( tile_y_end - tile_y ) + 1;
 
-    switch ( tile_type ) {
-        case DGM:
-            if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                pthread_mutex_lock( &dgm_mutex );
-                if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                    status = loadTile( tile_name, tile_type );
-                }
-                pthread_mutex_unlock( &dgm_mutex );
-            }
-            break;
+    for ( int i = 0; i < n_tiles; i++ ) {
+        prefetcher.request( tile_x, tile_y, tile_type );
 
-        case DOM:
-            if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                pthread_mutex_lock( &dom_mutex );
-                if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                    status = loadTile( tile_name, tile_type );
-                }
-                pthread_mutex_unlock( &dom_mutex );
-            }
-            break;
+        if ( t_next_x < t_next_y ) {
+            tile_x += step_x;
+            t_next_x += t_delta_x;
+        }
+        else {
+            tile_y += step_y;
+            t_next_y += t_delta_y;
+        }
+    }
+} /* prefetchLine() */
 
-        case DOM_MASKED:
-            if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                pthread_mutex_lock( &dom_masked_mutex );
-                if ( !tileAlreadyLoaded(tile_name, tile_type) ) {
-                    status = loadTile( tile_name, tile_type );
-                }
-                pthread_mutex_unlock( &dom_masked_mutex );
+/*---------------------------------------------------------------*/
+
+void Field::prefetchRays (
+    Vector& start_point,
+    std::vector<Vector>& end_points,
+    bool with_reflection,
+    int fresnel_zone, double freq
+) {
+    for ( Vector& end_point : end_points ) {
+        if ( with_reflection ) {
+            // Same ground area as in precalculate
+            Polygon ground_area = fresnelZone( start_point, end_point, fresnel_zone, freq, 16 );
+
+            // The reflected rays stay within the Fresnel zone
+            prefetchArea(
+                ground_area.getMinX(), ground_area.getMinY(),
+                ground_area.getMaxX(), ground_area.getMaxY(),
+                true
+            );
+        }
+        else {
+            prefetchLine( start_point, end_point, DGM );
+            prefetchLine( start_point, end_point, DOM );
+        }
+    }
+} /* prefetchRays() */
+
+/*---------------------------------------------------------------*/
+
+void Field::prefetchArea ( double min_x, double min_y, double max_x, double max_y, bool with_lod2 ) {
+    uint
+        min_tile_x = (uint)( min_x / 1000.0 ),
+        min_tile_y = (uint)( min_y / 1000.0 ),
+        max_tile_x = (uint)( max_x / 1000.0 ),
+        max_tile_y = (uint)( max_y / 1000.0 );
+
+    // The polygons are selected before the rays are traced
+    // (LOD2 tiles have a width of 2 km and even coordinates)
+    if ( with_lod2 ) {
+        for ( uint y = min_tile_y - min_tile_y % 2; y <= max_tile_y; y += 2 ) {
+            for ( uint x = min_tile_x - min_tile_x % 2; x <= max_tile_x; x += 2 ) {
+                prefetcher.request( x, y, LOD2 );
             }
-            break;
+        }
     }
 
-    if ( status != SUCCESS ) {
-        throw std::runtime_error( "ERROR: Unable to load tile \"" + tile_name + "\"! Exiting...\n" );
+    for ( uint y = min_tile_y; y <= max_tile_y; y++ ) {
+        for ( uint x = min_tile_x; x <= max_tile_x; x++ ) {
+            prefetcher.request( x, y, DGM );
+            prefetcher.request( x, y, DOM );
+        }
     }
+} /* prefetchArea() */
 
-    GridTile* tile;
-    switch ( tile_type ) {
-        case DGM:
-            tile = &grid_tiles_dgm[tile_name];
-            break;
+/*---------------------------------------------------------------*/
 
-        case DOM:
-            tile = &grid_tiles_dom[tile_name];
-            break;
+void Field::releaseTile ( Pinned_Tile& pinned ) {
+    if ( pinned.entry != NULL ) {
+        pinned.cache->release( pinned.entry );
+        pinned.entry = NULL;
+    }
+} /* releaseTile() */
 
-        case DOM_MASKED:
-            tile = &grid_tiles_dom_masked[tile_name];
-            break;
+/*---------------------------------------------------------------*/
+
+void Field::registerBuildings ( GridTile& grid_tile ) {
+    std::vector<std::string>& tile_building_names = grid_tile.getBuildingNames();
+
+    std::vector<uint32_t> global_ids;
+    global_ids.push_back( 0 );
+
+    pthread_mutex_lock( &building_mutex );
+
+    for ( std::string& name : tile_building_names ) {
+        auto it = building_name_ids.find( name );
+        if ( it == building_name_ids.end() ) {
+            uint32_t id = building_names.size();
+            building_names.push_back( name );
+            building_name_ids[name] = id;
+            global_ids.push_back( id );
+        }
+        else {
+            global_ids.push_back( it->second );
+        }
+    }
+
+    pthread_mutex_unlock( &building_mutex );
+
+    grid_tile.setGlobalBuildingIds( global_ids );
+} /* registerBuildings() */
+
+/*---------------------------------------------------------------*/
+
+std::string Field::getBuildingName ( uint32_t building_id ) {
+    pthread_mutex_lock( &building_mutex );
+
+    std::string name;
+    if ( building_id < building_names.size() ) {
+        name = building_names[building_id];
     }
 
+    pthread_mutex_unlock( &building_mutex );
+
+    return name;
+} /* getBuildingName() */
+
+/*---------------------------------------------------------------*/
+
+uint32_t Field::getBuildingIdAtXY ( double x, double y, Pinned_Tile& pinned ) {
+    if ( pinned.cache != &grid_tiles_dom ) {
+        return 0;
+    }
+
+    uint easting, northing;
+    GridTile* tile = getGridTileAtXY( x, y, DOM_MASKED, easting, northing, pinned );
+
+    return tile->getBuildingId( easting, northing );
+} /* getBuildingIdAtXY() */
+
+/*---------------------------------------------------------------*/
+
+GridTile* Field::getGridTileAtXY (
+    double x, double y,
+    int tile_type,
+    uint& easting, uint& northing,
+    Pinned_Tile& pinned
+) {
     uint
-        easting  = (uint)( (fmod(x, 1000.0) / 1000.0) * tile->getTileWidth() ),
-        northing = (uint)( (fmod(y, 1000.0) / 1000.0) * tile->getTileWidth() );
+        tile_x = (uint)( x / 1000.0 ),
+        tile_y = (uint)( y / 1000.0 );
+
+    TileCache<GridTile>* cache = ( tile_type == DGM ) ? &grid_tiles_dgm : &grid_tiles_dom;
+
+    // Keep the pinned tile as long as the thread stays on it
+    if (
+        pinned.entry == NULL ||
+        pinned.cache != cache ||
+        pinned.tile_x != tile_x ||
+        pinned.tile_y != tile_y
+    ) {
+        releaseTile( pinned );
+
+        int status = loadGridTile( tile_x, tile_y, tile_type, pinned.entry );
+        if ( status != SUCCESS ) {
+            throw std::runtime_error(
+                "ERROR: Unable to load tile \"" + buildTileName(tile_x, tile_y) + "\"! Exiting...\n"
+            );
+        }
+
+        pinned.cache  = cache;
+        pinned.tile_x = tile_x;
+        pinned.tile_y = tile_y;
+        pinned.masked = false;
+    }
+
+    // Without its mask a DOM tile would show the buildings in the
+    // DOM_MASKED layer
+    if ( tile_type == DOM_MASKED && !pinned.masked ) {
+        if ( maskGridTile( pinned.entry ) != SUCCESS ) {
+            throw std::runtime_error(
+                "ERROR: Unable to load the footprint mask of tile \"" + buildTileName(tile_x, tile_y) + "\"! Exiting...\n"
+            );
+        }
+        pinned.masked = true;
+    }
+
+    GridTile* tile = &pinned.entry->tile;
+
+    easting  = (uint)( (fmod(x, 1000.0) / 1000.0) * tile->getTileWidth() );
+    northing = (uint)( (fmod(y, 1000.0) / 1000.0) * tile->getTileWidth() );
+
+    return tile;
+} /* getGridTileAtXY() */
+
+/*---------------------------------------------------------------*/
+
+double Field::getAltitudeAtXY ( double x, double y, int tile_type ) {
+    Pinned_Tile pinned;
+
+    uint easting, northing;
+    GridTile* tile = getGridTileAtXY( x, y, tile_type, easting, northing, pinned );
 
     float value;
-    tile->getValue( easting, northing, value );
+    int status;
+    if ( tile_type == DOM_MASKED ) {
+        status = tile->getMaskedValue( easting, northing, value );
+    }
+    else {
+        status = tile->getValue( easting, northing, value );
+    }
+
+    if ( status != SUCCESS ) {
+        std::string tile_name = tile->getTileName();
+        releaseTile( pinned );
+
+        throw std::runtime_error( "ERROR: Unable to read the tile \"" + tile_name + "\"! Exiting...\n" );
+    }
+
+    releaseTile( pinned );
 
     return value;
 } /* getAltitudeAtXY () */
 
 /*---------------------------------------------------------------*/
 
+double Field::getClearanceAtXY ( double x, double y, double altitude, int tile_type, Pinned_Tile& pinned ) {
+    uint easting, northing;
+    GridTile* tile = getGridTileAtXY( x, y, tile_type, easting, northing, pinned );
+
+    double clearance;
+    int status = tile->getClearance( easting, northing, altitude, clearance, tile_type == DOM_MASKED );
+
+    // An undecodable block of a lazy tile (e.g. after a failed range
+    // request) fails the ray like a tile that can't be loaded
+    if ( status != SUCCESS ) {
+        throw std::runtime_error(
+            "ERROR: Unable to read the tile \"" + tile->getTileName() + "\"! Exiting...\n"
+        );
+    }
+
+    return clearance;
+} /* getClearanceAtXY() */
+
+/*---------------------------------------------------------------*/
+
 int Field::bresenhamPseudo3D (
     Vector& start,
     Vector& end,
     float ground_level_threshold,
     std::vector<bool>* decision_arrays_united,
     int tile_type,
-    bool cancel_on_ground
+    bool cancel_on_ground,
+    double* min_clearance,
+    std::vector<uint32_t>* building_ids_united
 )
 {
     if ( tile_type != DGM && tile_type != DOM && tile_type != DOM_MASKED ) {
@@ -208,6 +633,43 @@ int Field::bresenhamPseudo3D (
         y_end   = (int) ( end.getY() / GRID_RESOLUTION ),
         z_end   = (int) ( round( end.getZ() ) / GRID_RESOLUTION );
 
+    // End points in the same grid cells result in the same trace
+    Ray_Key ray_key = {
+        x_start, y_start, z_start,
+        x_end, y_end, z_end,
+        tile_type, ground_level_threshold, cancel_on_ground,
+        building_ids_united != NULL
+    };
+
+    if ( MEMOIZATION ) {
+        Ray_Memo_Entry memo_entry;
+
+        if ( ray_memo.lookup(ray_key, memo_entry) ) {
+            RUN_STATISTICS.memo_hits++;
+
+            decision_arrays_united->insert(
+                decision_arrays_united->end(),
+                memo_entry.decision_array.begin(), memo_entry.decision_array.end()
+            );
+            if ( building_ids_united != NULL ) {
+                building_ids_united->insert(
+                    building_ids_united->end(),
+                    memo_entry.building_ids.begin(), memo_entry.building_ids.end()
+                );
+            }
+            if ( min_clearance != NULL ) {
+                *min_clearance = memo_entry.min_clearance;
+            }
+
+            if ( memo_entry.intersection_found ) {
+                return INTERSECTION_FOUND;
+            }
+            return NO_INTERSECTION_FOUND;
+        }
+
+        RUN_STATISTICS.memo_misses++;
+    }
+
     // Distances between the start and end coordinate
     int
         dx = abs( x_end - x_start ),
@@ -233,6 +695,8 @@ int Field::bresenhamPseudo3D (
 
     bool intersection_found = false;
 
+    std::vector<void*> args;
+
     for ( int i = 0; i < MAX_THREADS; i++ ) {
         bresenham_data[i].x_start = (int) x_start_f + x_start;
         bresenham_data[i].y_start = (int) y_start_f + y_start;
@@ -261,24 +725,65 @@ int Field::bresenhamPseudo3D (
 
         bresenham_data[i].h_curve_correction = h_curve_correction;
 
+        bresenham_data[i].min_clearance = INFINITY;
+
         decision_arrays[i].clear();
         bresenham_data[i].decision_array = &decision_arrays[i];
+
+        building_id_arrays[i].clear();
+        if ( building_ids_united != NULL ) {
+            bresenham_data[i].building_id_array = &building_id_arrays[i];
+        }
+        else {
+            bresenham_data[i].building_id_array = NULL;
+        }
+
         bresenham_data[i].field = this;
 
-        pthread_create( &bresenham_threads[i], NULL, Thread_bresenhamPseudo3D, (void*)&bresenham_data[i] );
+        args.push_back( (void*)&bresenham_data[i] );
     }
 
-    for ( int i = 0; i < MAX_THREADS; i++ ) {
-        pthread_join( bresenham_threads[i], NULL );
-    }
+    WORKER_POOL.run( Thread_bresenhamPseudo3D, args );
+
+    Ray_Memo_Entry memo_entry;
+    memo_entry.intersection_found = intersection_found;
+    memo_entry.min_clearance = INFINITY;
 
     for ( int i = 0; i < MAX_THREADS; i++ ) {
         uint len_decision_array = decision_arrays[i].size();
         for ( uint j = 0; j < len_decision_array; j++ ) {
-            decision_arrays_united->push_back( decision_arrays[i][j] );
+            memo_entry.decision_array.push_back( decision_arrays[i][j] );
+        }
+        memo_entry.building_ids.insert(
+            memo_entry.building_ids.end(),
+            building_id_arrays[i].begin(), building_id_arrays[i].end()
+        );
+
+        if ( bresenham_data[i].min_clearance < memo_entry.min_clearance ) {
+            memo_entry.min_clearance = bresenham_data[i].min_clearance;
         }
     }
 
+    decision_arrays_united->insert(
+        decision_arrays_united->end(),
+        memo_entry.decision_array.begin(), memo_entry.decision_array.end()
+    );
+
+    if ( building_ids_united != NULL ) {
+        building_ids_united->insert(
+            building_ids_united->end(),
+            memo_entry.building_ids.begin(), memo_entry.building_ids.end()
+        );
+    }
+
+    if ( min_clearance != NULL ) {
+        *min_clearance = memo_entry.min_clearance;
+    }
+
+    if ( MEMOIZATION ) {
+        ray_memo.insert( ray_key, memo_entry );
+    }
+
     if ( intersection_found ) {
         return INTERSECTION_FOUND;
     }
@@ -307,6 +812,9 @@ void* Thread_bresenhamPseudo3D ( void* arg ) {
 
     double utm_x, utm_y, altitude;
 
+    // Tile the thread is currently on
+    Pinned_Tile pinned;
+
     // Axes
     enum IterationAxes {
         ITERATION_AXIS_X,
@@ -453,21 +961,35 @@ void* Thread_bresenhamPseudo3D ( void* arg ) {
 
         altitude = z * GRID_RESOLUTION;
 
-        // Get the altitude at the current x/y position
-        float altitude_at_xy =
-            data->field->getAltitudeAtXY(utm_x, utm_y, data->tile_type) - data->ground_level_threshold;
+        // Distance between the ray and the surface lowered by the
+        // ground level threshold at the current x/y position
+        double clearance = data->field->getClearanceAtXY(
+            utm_x, utm_y,
+            altitude - data->h_curve_correction + data->ground_level_threshold,
+            data->tile_type,
+            pinned
+        );
+        if ( clearance < data->min_clearance ) {
+            data->min_clearance = clearance;
+        }
 
         // If the value of z is equal or smaller than the altitude
         // at x/y they ray has hit the ground
-        if ( altitude - data->h_curve_correction <= altitude_at_xy ) {
+        if ( clearance <= 0.0 ) {
             data->decision_array->push_back( true );
             *(data->intersection_found) = true;
         } /* if ( z <= altitude_at_xy ) */
         else {
             data->decision_array->push_back( false );
         }
+
+        if ( data->building_id_array != NULL ) {
+            data->building_id_array->push_back( data->field->getBuildingIdAtXY(utm_x, utm_y, pinned) );
+        }
     } /* while ( it != end_it ) */
 
+    data->field->releaseTile( pinned );
+
     return NULL;
 } /* Thread_bresenhamPseudo3D() */
 
@@ -482,13 +1004,15 @@ int Field::precalculate (
     std::vector<Polygon> polygons_in_ground_area;
     std::vector<Polygon> global_selected_polygons;
 
-    Polygon ground_area = fresnelZone( start_point, end_point, fresnel_zone, 868.0e6, 16 );
+    Polygon ground_area = fresnelZone( start_point, end_point, fresnel_zone, freq, 16 );
     getPolygonsInGroundArea( polygons_in_ground_area, ground_area );
 
     double part_size = (double)polygons_in_ground_area.size() / (double)MAX_THREADS;
 
     double start_idx = 0.0;
 
+    std::vector<void*> args;
+
     for ( int i = 0; i < MAX_THREADS; i++ ) {
         precalc_data[i].start_idx = (uint) start_idx;
         start_idx += part_size;
@@ -502,13 +1026,10 @@ int Field::precalculate (
 
         precalc_data[i].selected_polygons_mutex = &selected_polygons_mutex;
 
-
-        pthread_create( &precalc_threads[i], NULL, Thread_precalculate, (void*)&precalc_data[i] );
+        args.push_back( (void*)&precalc_data[i] );
     }
 
-    for ( int i = 0; i < MAX_THREADS; i++ ) {
-        pthread_join( precalc_threads[i], NULL );
-    }
+    WORKER_POOL.run( Thread_precalculate, args );
 
     selected_polygons = global_selected_polygons;
 
@@ -607,10 +1128,11 @@ void* Thread_getPolygonsInGroundArea ( void* arg ) {
     struct PolygonsInGroundArea_Thread_Data* data =
         (struct PolygonsInGroundArea_Thread_Data*) arg;
 
-    if ( !data->field->tileAlreadyLoaded( data->tile_name, LOD2 ) ) {
-        data->field->loadTile( data->tile_name, LOD2 );
+    Tile_Cache_Entry<VectorTile>* entry;
+    if ( data->field->loadVectorTile( data->tile_name, entry ) != SUCCESS ) {
+        return NULL;
     }
-    VectorTile& vector_tile = data->field->vector_tiles_lod2[data->tile_name];
+    VectorTile& vector_tile = entry->tile;
 
     uint len_polygons;
 
@@ -641,6 +1163,8 @@ void* Thread_getPolygonsInGroundArea ( void* arg ) {
         }
     }
 
+    data->field->vector_tiles_lod2.release( entry );
+
     return NULL;
 } /* Thread_getPolygonsInGroundArea() */
 
@@ -652,49 +1176,25 @@ int Field::getPolygonsInGroundArea (
     std::vector<std::string> tile_names = tilesInGroundArea( ground_area );
 
     int n_tiles = tile_names.size();
-    int n_thread_blocks = n_tiles / MAX_THREADS;
-    if ( n_tiles < MAX_THREADS ) {
-        n_thread_blocks += 1;
-    }
-
-    int list_index = 0;
 
+    // One task per tile
+    std::vector<PolygonsInGroundArea_Thread_Data> data( n_tiles );
+    std::vector<std::vector<Polygon>> tile_polygons( n_tiles );
+    std::vector<void*> args;
 
-    int n_threads = MAX_THREADS;
+    for ( int i = 0; i < n_tiles; i++ ) {
+        data[i].field = this;
+        data[i].ground_area = &ground_area;
+        data[i].polygon_list = &tile_polygons[i];
+        data[i].tile_name = tile_names[i];
 
-
-    for ( int i = 0; i < MAX_THREADS; i++ ) {
-        ground_area_polygons[i].clear();
+        args.push_back( (void*)&data[i] );
     }
 
-    for ( int i = 0; i < n_thread_blocks; i++ ) {
-        if ( n_tiles / MAX_THREADS > 0 ) {
-            n_threads = MAX_THREADS;
-        }
-        else {
-            n_threads = n_tiles;
-        }
-
+    WORKER_POOL.run( Thread_getPolygonsInGroundArea, args );
 
-        for ( int j = 0; j < n_threads; j++ ) {
-            ground_area_data[j].field = this;
-            ground_area_data[j].ground_area = &ground_area;
-            ground_area_data[j].polygon_list = &ground_area_polygons[j];
-            ground_area_data[j].tile_name = tile_names[list_index++];
-
-            pthread_create(
-                &ground_area_threads[j], NULL,
-                Thread_getPolygonsInGroundArea, (void*)&ground_area_data[j]
-            );
-        }
-        for ( int j = 0; j < n_threads; j++ ) {
-            pthread_join( ground_area_threads[j], NULL );
-        }
-
-    }
-
-    for ( int i = 0; i < MAX_THREADS; i++ ) {
-         polygons.insert( polygons.end(), ground_area_polygons[i].begin(), ground_area_polygons[i].end() );
+    for ( int i = 0; i < n_tiles; i++ ) {
+         polygons.insert( polygons.end(), tile_polygons[i].begin(), tile_polygons[i].end() );
     }
 
     return SUCCESS;
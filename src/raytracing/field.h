@@ -7,6 +7,10 @@
 #include "../geometry/polygon.h"
 #include "../tile/grid_tile.h"
 #include "../tile/vector_tile.h"
+#include "../tile/region_archive.h"
+#include "ray_memo.h"
+#include "tile_cache.h"
+#include "tile_prefetcher.h"
 
 
 #include "../utils.h"
@@ -18,6 +22,23 @@
 #include <pthread.h>
 
 
+/*
+Grid tile pinned in a tile cache by a thread (See Field::getGridTileAtXY)
+The tile stays pinned until the thread moves to another tile or calls
+Field::releaseTile
+*/
+struct Pinned_Tile {
+    Tile_Cache_Entry<GridTile>* entry = NULL;
+    TileCache<GridTile>* cache = NULL;
+
+    uint tile_x = 0, tile_y = 0;
+
+    // The footprint mask of the pinned DOM tile is attached
+    // (See Field::maskGridTile)
+    bool masked = false;
+};
+
+
 /*
 Class for managing grid tiles and vector tiles and performing
 raytracing on the data
@@ -28,32 +49,140 @@ letting him concentrate on the raytracing
 class Field {
 
 private:
-    // Hashmaps for the tiles
-    std::unordered_map<std::string, GridTile> grid_tiles_dgm;
-    std::unordered_map<std::string, GridTile> grid_tiles_dom;
-    std::unordered_map<std::string, GridTile> grid_tiles_dom_masked;
-    std::unordered_map<std::string, VectorTile> vector_tiles_lod2;
+    // Caches for the tiles (See TILE_CACHE_BUDGET_*)
+    // (DOM tiles carry the footprint mask for the DOM_MASKED layer once
+    // it is read, See maskGridTile)
+    TileCache<GridTile> grid_tiles_dgm;
+    TileCache<GridTile> grid_tiles_dom;
+    TileCache<VectorTile> vector_tiles_lod2;
+
+    // Archive to load the tiles from before the data directory (See REGION_ARCHIVE)
+    RegionArchive region_archive;
+
+    // Bresenham traces already performed in this run
+    RayMemo ray_memo;
+
+    // Run-wide building IDs (index = ID, ID 0 = no building)
+    std::vector<std::string> building_names;
+    std::unordered_map<std::string, uint32_t> building_name_ids;
+    pthread_mutex_t building_mutex;
+
+    // Held to check and attach the footprint masks of the DOM tiles
+    // (See maskGridTile)
+    pthread_mutex_t footprint_mutex;
+
+    // Background loading of the tiles ahead of the raytracing
+    // (declared last so that its threads are stopped before the
+    // caches are destroyed)
+    TilePrefetcher prefetcher;
+
+    /*
+    Assign run-wide IDs to the buildings of a DOM tile and
+    set the tile's table of global building IDs
+
+    Args:
+     - grid_tile : Reference to the tile with a building ID raster
+    */
+    void registerBuildings ( GridTile& grid_tile );
 
-    pthread_mutex_t dgm_mutex, dom_mutex, dom_masked_mutex;
+    /*
+    Return the run-wide ID of the building at the UTM x, y coordinates
+    (0 = no building or the pinned tile is not a DOM tile)
+
+    Args:
+     - x      : UTM x coordinate (easting)
+     - y      : UTM y coordinate (northing)
+     - pinned : Tile pinned by the calling thread (See getGridTileAtXY)
+    */
+    uint32_t getBuildingIdAtXY ( double x, double y, Pinned_Tile& pinned );
+
+    /*
+    Read a grid tile from the region archive or the data directory in
+    the grid resolution (See readGridTile)
+    A DOM tile is read without its footprint mask (from the data
+    directory), a DOM_MASKED tile with it
+
+    Args:
+     - tile_name : Name of the tile (easting_northing)
+     - tile_type : Tile type (DGM, DOM, DOM_MASKED)
+     - grid_tile : Reference to the tile to store the data in
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
+    */
+    int readSourceTile ( std::string tile_name, int tile_type, GridTile& grid_tile );
 
     /*
-    Check if a tile has already been loaded into the hashmaps using a tile name
+    Read a grid tile from the data directory and prepare it for the
+    raytracing (resampling, layout, quantisation, compression)
 
     Args:
      - tile_name : Name of the tile (easting_northing)
-     - tile_type : Tile type (DGM, DOM, DOM_MASKED, LOD2)
+     - tile_type : Tile type (DGM, DOM, DOM_MASKED)
+     - grid_tile : Reference to the tile to store the data in
 
     Returns:
-     - Tile with name tile_name already loaded?
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
     */
-    bool tileAlreadyLoaded ( std::string tile_name, int tile_type );
+    int readGridTile ( std::string tile_name, int tile_type, GridTile& grid_tile );
 
     /*
-    Load a tile of a certain type into the corresponding map
+    Pin a grid tile in the cache of its layer and load it if necessary
+    The time the raytracing waits for the tile is recorded in RUN_STATISTICS
+
+    Args:
+     - tile_x    : x coordinate of the tile in km (easting)
+     - tile_y    : y coordinate of the tile in km (northing)
+     - tile_type : Tile type (DGM, DOM, DOM_MASKED)
+     - entry     : Reference to store the pinned cache entry in
+                   (release with TileCache::release)
+     - prefetch  : The tile is loaded by the prefetcher (Default: false)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
+    */
+    int loadGridTile (
+        uint tile_x, uint tile_y,
+        int tile_type,
+        Tile_Cache_Entry<GridTile>*& entry,
+        bool prefetch = false
+    );
+
+    /*
+    Attach the footprint mask and the building IDs to a cached DOM tile
+    the first time the DOM_MASKED layer is read from it, so that the DOM
+    layer is loaded without the LOD2 tiles
+    A tile whose mask can't be created stays unmasked (the next call
+    tries again).
+
+    Args:
+     - entry : Pinned entry of the DOM tile
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
+    */
+    int maskGridTile ( Tile_Cache_Entry<GridTile>* entry );
+
+    /*
+    Pin a vector tile in the LOD2 cache and load it if necessary
 
     Args:
      - tile_name : Name of the tile (easting_northing)
-     - tile_type : Tile type (DGM, DOM, DOM_MASKED, LOD2)
+     - entry     : Reference to store the pinned cache entry in
+                   (release with TileCache::release)
+     - prefetch  : The tile is loaded by the prefetcher (Default: false)
 
     Returns:
      - Status code
@@ -61,7 +190,57 @@ private:
 
         - TILE_NOT_AVAILABLE
     */
-    int loadTile ( std::string tile_name, int tile_type );
+    int loadVectorTile (
+        std::string tile_name,
+        Tile_Cache_Entry<VectorTile>*& entry,
+        bool prefetch = false
+    );
+
+    /*
+    Load a tile requested from the prefetcher into its cache
+    (called by the I/O threads of the prefetcher)
+
+    Args:
+     - job : Tile to load
+    */
+    void prefetchTile ( Prefetch_Job& job );
+
+    /*
+    Request the download of the raw file of a tile requested from the
+    prefetcher if it is needed (See requestTileDownload)
+
+    Args:
+     - job      : Tile to download
+     - callback : Function called when the download is finished
+     - arg      : Argument passed to the callback
+
+    Returns:
+     - Status code
+        - SUCCESS (the download was requested)
+
+        - FILE_ALREADY_EXISTS
+        - INVALID_TILE_TYPE
+    */
+    int requestDownload ( Prefetch_Job& job, Download_Callback callback, void* arg );
+
+    /*
+    Request the grid tiles crossed by the 2D line between two points
+    from the prefetcher (in the order the line crosses them)
+
+    Args:
+     - start     : Start point as UTM coordinates
+     - end       : End point as UTM coordinates
+     - tile_type : Tile type (DGM, DOM)
+    */
+    void prefetchLine ( Vector& start, Vector& end, int tile_type );
+
+    /*
+    Unpin the tile pinned by a thread
+
+    Args:
+     - pinned : Tile pinned by the calling thread (See getGridTileAtXY)
+    */
+    void releaseTile ( Pinned_Tile& pinned );
 
     /*
     Get the altitude at the UTM x, y coordinates (grid)
@@ -76,6 +255,47 @@ private:
     */
     double getAltitudeAtXY ( double x, double y, int tile_type );
 
+    /*
+    Get the signed distance between an altitude and the surface at the
+    UTM x, y coordinates (grid) (zero or negative if the altitude is at
+    or below the surface) (See GridTile::getClearance)
+
+    Args:
+     - x         : UTM x coordinate (easting)
+     - y         : UTM y coordinate (northing)
+     - altitude  : Altitude in meters
+     - tile_type : Tile type (DGM, DOM, DOM_MASKED)
+     - pinned    : Tile pinned by the calling thread (See getGridTileAtXY)
+
+    Returns:
+     - Distance in meters
+    */
+    double getClearanceAtXY ( double x, double y, double altitude, int tile_type, Pinned_Tile& pinned );
+
+    /*
+    Return the tile containing the UTM x, y coordinates and load it if
+    necessary
+    The tile is pinned in its cache until the thread moves on to another
+    tile or releases it with releaseTile
+
+    Args:
+     - x         : UTM x coordinate (easting)
+     - y         : UTM y coordinate (northing)
+     - tile_type : Tile type (DGM, DOM, DOM_MASKED)
+     - easting   : Reference to store the x coordinate within the tile in
+     - northing  : Reference to store the y coordinate within the tile in
+     - pinned    : Tile pinned by the calling thread
+
+    Returns:
+     - Pointer to the tile
+    */
+    GridTile* getGridTileAtXY (
+        double x, double y,
+        int tile_type,
+        uint& easting, uint& northing,
+        Pinned_Tile& pinned
+    );
+
 
     /*
     Find all polygons in the vector tiles that are located within the
@@ -102,11 +322,47 @@ private:
     friend void* Thread_bresenhamPseudo3D ( void* arg );
     friend void* Thread_precalculate ( void* arg );
     friend void* Thread_getPolygonsInGroundArea ( void* arg );
+    friend void* Thread_prefetchTiles ( void* arg );
+    friend class TilePrefetcher;
 
 
 public:
     Field ();
 
+    /*
+    Load the tiles needed for tracing rays from a start point to a list
+    of end points in the background (See PREFETCH_THREADS)
+    The tiles are loaded in the order the rays will need them
+
+    Args:
+     - start_point     : Start point as UTM coordinates and altitude
+     - end_points      : List of end points as UTM coordinates and altitude
+                         (in the order they will be traced)
+     - with_reflection : The rays are traced with reflection (loads the
+                         LOD2 tiles and the grid tiles in the Fresnel zone)
+     - fresnel_zone    : Number of the Fresnel zone (Default: 2)
+     - freq            : Frequency of the signal in Hz
+    */
+    void prefetchRays (
+        Vector& start_point,
+        std::vector<Vector>& end_points,
+        bool with_reflection,
+        int fresnel_zone = 2,
+        double freq = 868.0e6
+    );
+
+    /*
+    Load all tiles in a bounding box in the background (See PREFETCH_THREADS)
+
+    Args:
+     - min_x     : Minimum UTM x coordinate (easting)
+     - min_y     : Minimum UTM y coordinate (northing)
+     - max_x     : Maximum UTM x coordinate (easting)
+     - max_y     : Maximum UTM y coordinate (northing)
+     - with_lod2 : Load the LOD2 tiles too
+    */
+    void prefetchArea ( double min_x, double min_y, double max_x, double max_y, bool with_lod2 );
+
     /*
     Perform the Bresenham algorithm in pseudo 3D space
 
@@ -120,6 +376,11 @@ public:
                                 in whether the ray was below the terrain at a point
      - tile_type              : Tile type (DGM, DOM)
      - cancel_on_ground       : Stop the algorithm when the ray has hit the ground
+     - min_clearance          : Pointer to a double to store the smallest distance in meters
+                                between the ray and the surface in (negative if the ray was
+                                below the surface) (Optional)
+     - building_ids_united    : Pointer to a std::vector<uint32_t> to store the building ID
+                                at every point of the ray in (only DOM_MASKED) (Optional)
 
     Returns:
      - Status code
@@ -134,9 +395,19 @@ public:
         float ground_level_threshold,
         std::vector<bool>* decision_arrays_united,
         int tile_type,
-        bool cancel_on_ground = false
+        bool cancel_on_ground = false,
+        double* min_clearance = NULL,
+        std::vector<uint32_t>* building_ids_united = NULL
     );
 
+    /*
+    Return the name (ID of the LOD2 GROUND polygon) of a building
+
+    Args:
+     - building_id : Run-wide building ID (See bresenhamPseudo3D)
+    */
+    std::string getBuildingName ( uint32_t building_id );
+
 
     /*
     Find all polygons in the Fresnel zone between the start and the end point
@@ -195,7 +466,10 @@ struct Bresenham_Thread_Data {
 
     double h_curve_correction;
 
+    double min_clearance;
+
     std::vector<bool>* decision_array;
+    std::vector<uint32_t>* building_id_array;
 
     Field* field;
 };
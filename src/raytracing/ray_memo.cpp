@@ -0,0 +1,75 @@
+#include "ray_memo.h"
+
+#include "../shared.h"
+#include "../utils.h"
+
+/*---------------------------------------------------------------*/
+
+bool Ray_Key::operator == ( const Ray_Key& other ) const {
+    return
+        x_start == other.x_start && y_start == other.y_start && z_start == other.z_start &&
+        x_end   == other.x_end   && y_end   == other.y_end   && z_end   == other.z_end   &&
+        tile_type == other.tile_type &&
+        ground_level_threshold == other.ground_level_threshold &&
+        cancel_on_ground == other.cancel_on_ground &&
+        with_building_ids == other.with_building_ids;
+} /* operator == () */
+
+size_t Ray_Key_Hash::operator () ( const Ray_Key& key ) const {
+    int values [] = {
+        key.x_start, key.y_start, key.z_start,
+        key.x_end, key.y_end, key.z_end,
+        key.tile_type, (int)( key.ground_level_threshold * 1000.0 ), key.cancel_on_ground,
+        key.with_building_ids
+    };
+
+    // Hash of the quantised values
+    return hashBytes( HASH_START, values, sizeof(values) );
+} /* operator () () */
+
+/*---------------------------------------------------------------*/
+
+RayMemo::RayMemo () {
+    for ( int i = 0; i < RAY_MEMO_SHARDS; i++ ) {
+        pthread_mutex_init( &shard_mutexes[i], NULL );
+    }
+} /* RayMemo() */
+
+RayMemo::~RayMemo () {
+    for ( int i = 0; i < RAY_MEMO_SHARDS; i++ ) {
+        pthread_mutex_destroy( &shard_mutexes[i] );
+    }
+} /* ~RayMemo() */
+
+/*---------------------------------------------------------------*/
+
+bool RayMemo::lookup ( const Ray_Key& key, Ray_Memo_Entry& entry ) {
+    uint shard = Ray_Key_Hash()( key ) % RAY_MEMO_SHARDS;
+
+    pthread_mutex_lock( &shard_mutexes[shard] );
+
+    auto it = shards[shard].find( key );
+    bool found = it != shards[shard].end();
+    if ( found ) {
+        entry = it->second;
+    }
+
+    pthread_mutex_unlock( &shard_mutexes[shard] );
+
+    return found;
+} /* lookup() */
+
+/*---------------------------------------------------------------*/
+
+void RayMemo::insert ( const Ray_Key& key, const Ray_Memo_Entry& entry ) {
+    uint shard = Ray_Key_Hash()( key ) % RAY_MEMO_SHARDS;
+
+    pthread_mutex_lock( &shard_mutexes[shard] );
+
+    if ( (int) shards[shard].size() >= MEMO_CAPACITY / RAY_MEMO_SHARDS ) {
+        shards[shard].clear();
+    }
+    shards[shard].insert( {key, entry} );
+
+    pthread_mutex_unlock( &shard_mutexes[shard] );
+} /* insert() */
@@ -0,0 +1,82 @@
+#ifndef RAY_MEMO_H
+#define RAY_MEMO_H
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <pthread.h>
+
+#define RAY_MEMO_SHARDS 64
+
+/*
+Quantised description of a Bresenham trace
+Two traces with the same key visit the same grid cells and
+therefore produce the same result
+*/
+struct Ray_Key {
+    int
+        x_start, y_start, z_start,
+        x_end, y_end, z_end;
+
+    int tile_type;
+    float ground_level_threshold;
+    bool cancel_on_ground;
+    bool with_building_ids;
+
+    bool operator == ( const Ray_Key& other ) const;
+};
+
+struct Ray_Key_Hash {
+    size_t operator () ( const Ray_Key& key ) const;
+};
+
+/*
+Result of a memoised Bresenham trace
+*/
+struct Ray_Memo_Entry {
+    std::vector<bool> decision_array;
+    std::vector<uint32_t> building_ids;
+    bool intersection_found;
+    double min_clearance;
+};
+
+/*
+Thread-safe table of Bresenham traces already performed in a run
+
+The table is split into shards with a mutex each so that concurrent
+lookups of different rays don't block each other
+*/
+class RayMemo {
+public:
+    RayMemo ();
+    ~RayMemo ();
+
+    /*
+    Look up a trace in the table
+
+    Args:
+     - key   : Quantised ray
+     - entry : Reference to the entry to copy the result into
+
+    Returns:
+     - Trace found in the table?
+    */
+    bool lookup ( const Ray_Key& key, Ray_Memo_Entry& entry );
+
+    /*
+    Add the result of a trace to the table
+    A shard is emptied when it has reached its share of
+    MEMO_CAPACITY
+
+    Args:
+     - key   : Quantised ray
+     - entry : Result of the trace
+    */
+    void insert ( const Ray_Key& key, const Ray_Memo_Entry& entry );
+
+private:
+    std::unordered_map<Ray_Key, Ray_Memo_Entry, Ray_Key_Hash> shards [RAY_MEMO_SHARDS];
+    pthread_mutex_t shard_mutexes [RAY_MEMO_SHARDS];
+};
+
+#endif
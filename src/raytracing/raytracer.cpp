@@ -5,6 +5,7 @@
 #include "../tile/tile_types.h"
 #include "../shared.h"
 #include "../status_codes.h"
+#include "../statistics.h"
 #include "selection_methods.h"
 
 #include <time.h>
@@ -72,6 +73,14 @@ Raytracer::Raytracer (
 
     createEnvironment();
 
+    resetStatistics();
+
+    if ( RESULT_CACHE != "" ) {
+        if ( result_cache.open(RESULT_CACHE) != SUCCESS ) {
+            printf( "WARNING: Unable to open the result cache \"%s\"\n", RESULT_CACHE.data() );
+        }
+    }
+
     createResultFileName( result_file_name );
     result_file = fopen( result_file_name, "w" );
 
@@ -81,18 +90,13 @@ Raytracer::Raytracer (
     CHOSEN_URL_DOM20 = url_dom20;
     CHOSEN_URL_LOD2 = url_lod2;
 
-    bresenham_threads = new pthread_t [MAX_THREADS];
     bresenham_data = new Bresenham_Thread_Data [MAX_THREADS];
     decision_arrays = new std::vector<bool> [MAX_THREADS];
+    building_id_arrays = new std::vector<uint32_t> [MAX_THREADS];
 
     pthread_mutex_init( &selected_polygons_mutex, NULL );
 
-    precalc_threads = new pthread_t [MAX_THREADS];
     precalc_data = new struct Precalculate_Thread_Data [MAX_THREADS];
-
-    ground_area_threads = new pthread_t [MAX_THREADS];
-    ground_area_data = new struct PolygonsInGroundArea_Thread_Data [MAX_THREADS];
-    ground_area_polygons = new std::vector<Polygon> [MAX_THREADS];
 } /* Raytracer() */
 
 /*---------------------------------------------------------------*/
@@ -130,18 +134,16 @@ Raytracer::~Raytracer () {
 
     fclose( result_file );
 
+    printStatistics();
+
     delete field;
 
     pthread_mutex_destroy( &selected_polygons_mutex );
 
     delete[] bresenham_data;
-    delete[] bresenham_threads;
     delete[] decision_arrays;
-    delete[] ground_area_data;
-    delete[] ground_area_threads;
-    delete[] ground_area_polygons;
+    delete[] building_id_arrays;
     delete[] precalc_data;
-    delete[] precalc_threads;
 } /* ~Raytracer() */
 
 /*---------------------------------------------------------------*/
@@ -180,6 +182,44 @@ void Raytracer::calculateCounterValues (
 } /* calculateCounterValues() */
 
 
+void Raytracer::attributeBuildings (
+    std::vector<bool>& dgm_decision_array,
+    std::vector<bool>& dom_decision_array,
+    std::vector<bool>& dom_masked_decision_array,
+    std::vector<uint32_t>& building_ids,
+
+    std::map<std::string, int>& blocking_buildings
+) {
+    std::map<uint32_t, int> counts;
+
+    uint len_decision_array = building_ids.size();
+    for ( uint i = 0; i < len_decision_array; i++ ) {
+        if (
+            building_ids[i] != 0 &&
+            dom_decision_array[i] && !dom_masked_decision_array[i] && !dgm_decision_array[i]
+        ) {
+            counts[building_ids[i]]++;
+        }
+    }
+
+    for ( auto& [building_id, count] : counts ) {
+        blocking_buildings[field->getBuildingName(building_id)] += count;
+    }
+} /* attributeBuildings() */
+
+/*---------------------------------------------------------------*/
+
+void Raytracer::prefetch ( std::vector<Vector>& end_points, bool with_reflection ) {
+    field->prefetchRays( start_point, end_points, with_reflection, fresnel_zone, freq );
+} /* prefetch() */
+
+
+void Raytracer::prefetchArea ( double min_x, double min_y, double max_x, double max_y, bool with_reflection ) {
+    field->prefetchArea( min_x, min_y, max_x, max_y, with_reflection );
+} /* prefetchArea() */
+
+/*---------------------------------------------------------------*/
+
 void Raytracer::raytracingWithReflection ( Vector& end_point ) {
     int status;
 
@@ -203,50 +243,34 @@ void Raytracer::raytracingWithReflection ( Vector& end_point ) {
     for ( uint i = 0; i < n_polygons; i++ ) {
         Vector reflect_point = selected_polygons[i].getCentroid();
 
-        std::vector<bool>
-            dgm_decision_array_1, dgm_decision_array_2,
-            dom_decision_array_1, dom_decision_array_2,
-            dom_masked_decision_array_1, dom_masked_decision_array_2;
-
-        int
-            ground_count = 0,
-            vegetation_count = 0,
-            infrastructure_count = 0;
-
-        Vector intersection;
+        Trace_Result result_1, result_2;
 
-        status = field->bresenhamPseudo3D( start_point, reflect_point, 1.0, &dgm_decision_array_1, DGM, CANCEL_ON_GROUND );
-        if ( !(CANCEL_ON_GROUND && status == INTERSECTION_FOUND) ) {
-            field->bresenhamPseudo3D( start_point, reflect_point, 1.0, &dom_decision_array_1, DOM );
-            field->bresenhamPseudo3D( start_point, reflect_point, 1.0, &dom_masked_decision_array_1, DOM_MASKED );
-        }
-        else {
+        status = traceSegment( start_point, reflect_point, result_1 );
+        if ( CANCEL_ON_GROUND && status == INTERSECTION_FOUND ) {
             continue;
         }
 
-        field->bresenhamPseudo3D( reflect_point, end_point, 1.0, &dgm_decision_array_2, DGM, CANCEL_ON_GROUND );
-        if ( !(CANCEL_ON_GROUND && status == INTERSECTION_FOUND) ) {
-            field->bresenhamPseudo3D( reflect_point, end_point, 1.0, &dom_decision_array_2, DOM );
-            field->bresenhamPseudo3D( reflect_point, end_point, 1.0, &dom_masked_decision_array_2, DOM_MASKED );
-        }
-        else {
+        status = traceSegment( reflect_point, end_point, result_2 );
+        if ( CANCEL_ON_GROUND && status == INTERSECTION_FOUND ) {
             continue;
         }
 
-        calculateCounterValues(
-            dgm_decision_array_1, dom_decision_array_1, dom_masked_decision_array_1,
-            ground_count, vegetation_count, infrastructure_count
-        );
-        calculateCounterValues(
-            dgm_decision_array_2, dom_decision_array_2, dom_masked_decision_array_2,
-            ground_count, vegetation_count, infrastructure_count
-        );
+        int
+            ground_count = result_1.ground_count + result_2.ground_count,
+            vegetation_count = result_1.vegetation_count + result_2.vegetation_count,
+            infrastructure_count = result_1.infrastructure_count + result_2.infrastructure_count;
+
+        std::map<std::string, int> blocking_buildings = result_1.blocking_buildings;
+        for ( auto& [building, count] : result_2.blocking_buildings ) {
+            blocking_buildings[building] += count;
+        }
 
         writeResultObject_WithReflection(
             end_point, reflect_point,
             selected_polygons[i],
             ( reflect_point - start_point ).length(),
-            ground_count, vegetation_count, infrastructure_count
+            ground_count, vegetation_count, infrastructure_count,
+            &blocking_buildings
         );
 
         return;
@@ -255,45 +279,197 @@ void Raytracer::raytracingWithReflection ( Vector& end_point ) {
 
 /*---------------------------------------------------------------*/
 
-void Raytracer::raytracingDirect ( Vector& end_point ) {
+int Raytracer::traceSegment ( Vector& start, Vector& end, Trace_Result& result ) {
 
     std::vector<bool>
         dgm_decision_array,
         dom_decision_array,
         dom_masked_decision_array;
 
-    int status = field->bresenhamPseudo3D( start_point, end_point, 1.0, &dgm_decision_array, DGM, CANCEL_ON_GROUND );
+    std::vector<uint32_t> building_ids;
 
-    if ( !(CANCEL_ON_GROUND && status == INTERSECTION_FOUND) ) {
-        field->bresenhamPseudo3D( start_point, end_point, 1.0, &dom_decision_array, DOM );
-        field->bresenhamPseudo3D( start_point, end_point, 1.0, &dom_masked_decision_array, DOM_MASKED );
+    double clearance;
 
-        int
-            ground_count = 0,
-            vegetation_count = 0,
-            infrastructure_count = 0;
+    Result_Cache_Key cache_key;
+
+    // The cached results don't contain the blocking buildings
+    bool use_result_cache = result_cache.isOpen() && !BUILDING_ATTRIBUTION;
+
+    if ( use_result_cache ) {
+        result_cache.createKey( start, end, cache_key );
+
+        if ( result_cache.lookup(cache_key, result) ) {
+            RUN_STATISTICS.result_cache_hits++;
+
+            result.inferred = false;
+            return result.blocked ? INTERSECTION_FOUND : NO_INTERSECTION_FOUND;
+        }
+
+        RUN_STATISTICS.result_cache_misses++;
+    }
+
+    result.ground_count = 0;
+    result.vegetation_count = 0;
+    result.infrastructure_count = 0;
+    result.blocked = false;
+    result.inferred = false;
+    result.traced = true;
+    result.blocking_buildings.clear();
+
+    int status = field->bresenhamPseudo3D(
+        start, end, 1.0, &dgm_decision_array, DGM, CANCEL_ON_GROUND, &clearance );
+    result.min_clearance = clearance;
+
+    if ( CANCEL_ON_GROUND && status == INTERSECTION_FOUND ) {
+        result.blocked = true;
+    }
+    else {
+        field->bresenhamPseudo3D( start, end, 1.0, &dom_decision_array, DOM, false, &clearance );
+        if ( clearance < result.min_clearance ) {
+            result.min_clearance = clearance;
+        }
+
+        field->bresenhamPseudo3D(
+            start, end, 1.0, &dom_masked_decision_array, DOM_MASKED, false, NULL,
+            BUILDING_ATTRIBUTION ? &building_ids : NULL );
 
         calculateCounterValues(
             dgm_decision_array, dom_decision_array, dom_masked_decision_array,
-            ground_count, vegetation_count, infrastructure_count
+            result.ground_count, result.vegetation_count, result.infrastructure_count
         );
 
+        if ( BUILDING_ATTRIBUTION ) {
+            attributeBuildings(
+                dgm_decision_array, dom_decision_array, dom_masked_decision_array,
+                building_ids, result.blocking_buildings
+            );
+        }
+    }
+
+    if ( use_result_cache ) {
+        // Tiles may have been downloaded while tracing
+        result_cache.createKey( start, end, cache_key );
+        result_cache.insert( cache_key, result );
+    }
+
+    return status;
+} /* traceSegment() */
+
+
+int Raytracer::traceDirect ( Vector& end_point, Trace_Result& result ) {
+    return traceSegment( start_point, end_point, result );
+} /* traceDirect() */
+
+
+void Raytracer::raytracingDirect ( Vector& end_point ) {
+    Trace_Result result;
+
+    traceDirect( end_point, result );
+
+    if ( !result.blocked ) {
         writeResultObject_Direct(
             end_point,
             ( end_point - start_point ).length(),
-            ground_count, vegetation_count, infrastructure_count
+            result.ground_count, result.vegetation_count, result.infrastructure_count,
+            NULL, &result.blocking_buildings
         );
     }
 } /* raytracingDirect() */
 
 /*---------------------------------------------------------------*/
 
+bool resultsDiffer ( Trace_Result& result1, Trace_Result& result2 ) {
+    return
+        result1.blocked              != result2.blocked          ||
+        result1.ground_count         != result2.ground_count     ||
+        result1.vegetation_count     != result2.vegetation_count ||
+        result1.infrastructure_count != result2.infrastructure_count;
+} /* resultsDiffer() */
+
+
+void Raytracer::refineTrajectory (
+    std::vector<Vector>& end_points,
+    std::vector<Trace_Result>& results,
+    uint first, uint last,
+    double clearance_threshold
+) {
+    if ( last - first <= 1 ) {
+        return;
+    }
+
+    // Bisect the section if the results of its borders differ or if one of
+    // the rays passes the surface closely
+    if (
+        resultsDiffer( results[first], results[last] ) ||
+        results[first].min_clearance < clearance_threshold ||
+        results[last].min_clearance < clearance_threshold
+    ) {
+        uint center = first + ( last - first ) / 2;
+
+        traceDirect( end_points[center], results[center] );
+
+        refineTrajectory( end_points, results, first, center, clearance_threshold );
+        refineTrajectory( end_points, results, center, last, clearance_threshold );
+
+        return;
+    }
+
+    // Propagate the results of the borders into the section
+    // Every end point takes over the result of the closer border
+    for ( uint i = first + 1; i < last; i++ ) {
+        if ( i - first <= last - i ) {
+            results[i] = results[first];
+        }
+        else {
+            results[i] = results[last];
+        }
+        results[i].inferred = true;
+    }
+} /* refineTrajectory() */
+
+
+void Raytracer::raytracingTrajectory (
+    std::vector<Vector>& end_points,
+    std::vector<Trace_Result>& results,
+    uint first, uint last,
+    double clearance_threshold
+) {
+    if ( !results[first].traced ) {
+        traceDirect( end_points[first], results[first] );
+    }
+    if ( !results[last].traced ) {
+        traceDirect( end_points[last], results[last] );
+    }
+
+    refineTrajectory( end_points, results, first, last, clearance_threshold );
+
+    if ( last == end_points.size() - 1 ) {
+        last++;
+    }
+
+    for ( uint i = first; i < last; i++ ) {
+        if ( results[i].blocked ) {
+            continue;
+        }
+
+        writeResultObject_Direct(
+            end_points[i],
+            ( end_points[i] - start_point ).length(),
+            results[i].ground_count, results[i].vegetation_count, results[i].infrastructure_count,
+            &results[i].inferred, &results[i].blocking_buildings
+        );
+    }
+} /* raytracingTrajectory() */
+
+/*---------------------------------------------------------------*/
+
 void Raytracer::writeResultObject_WithReflection (
     Vector& end_point,
     Vector& reflection_point,
     Polygon& reflecting_polygon,
     float distance,
-    int ground_count, int vegetation_count, int infrastructure_count
+    int ground_count, int vegetation_count, int infrastructure_count,
+    std::map<std::string, int>* blocking_buildings
 ) {
     fprintf( result_file, "\t{\n" );
 
@@ -333,7 +509,14 @@ void Raytracer::writeResultObject_WithReflection (
     fprintf( result_file, "\t\t\t\"ground\": %d,\n", ground_count );
     fprintf( result_file, "\t\t\t\"vegetation\": %d,\n", vegetation_count );
     fprintf( result_file, "\t\t\t\"infrastructure\" : %d\n", infrastructure_count );
-    fprintf( result_file, "\t\t}\n" );
+
+    if ( BUILDING_ATTRIBUTION && blocking_buildings != NULL ) {
+        fprintf( result_file, "\t\t},\n" );
+        writeBlockingBuildings( *blocking_buildings );
+    }
+    else {
+        fprintf( result_file, "\t\t}\n" );
+    }
 
     fprintf( result_file, "\t},\n" );
 } /* writeResultObject_WithReflection() */
@@ -343,7 +526,9 @@ void Raytracer::writeResultObject_WithReflection (
 void Raytracer::writeResultObject_Direct (
     Vector& end_point,
     float distance,
-    int ground_count, int vegetation_count, int infrastructure_count
+    int ground_count, int vegetation_count, int infrastructure_count,
+    bool* inferred,
+    std::map<std::string, int>* blocking_buildings
 ) {
     fprintf( result_file, "\t{\n" );
 
@@ -360,15 +545,72 @@ void Raytracer::writeResultObject_Direct (
 
     fprintf( result_file, "\t\t\"grid_resolution\": %.2f,\n", GRID_RESOLUTION );
 
+    if ( inferred != NULL ) {
+        fprintf( result_file, "\t\t\"inferred\": %s,\n", *inferred ? "true" : "false" );
+    }
+
     fprintf( result_file, "\t\t\"counters\": {\n" );
     fprintf( result_file, "\t\t\t\"ground\": %d,\n", ground_count );
     fprintf( result_file, "\t\t\t\"vegetation\": %d,\n", vegetation_count );
     fprintf( result_file, "\t\t\t\"infrastructure\": %d\n", infrastructure_count );
-    fprintf( result_file, "\t\t}\n" );
+
+    if ( BUILDING_ATTRIBUTION && blocking_buildings != NULL ) {
+        fprintf( result_file, "\t\t},\n" );
+        writeBlockingBuildings( *blocking_buildings );
+    }
+    else {
+        fprintf( result_file, "\t\t}\n" );
+    }
 
     fprintf( result_file, "\t},\n" );
 } /* writeResultObject_Direct() */
 
+/*---------------------------------------------------------------*/
+
+/*
+Write a string as a quoted JSON string, escaping quotes, backslashes
+and control characters (building names come from the GML files)
+*/
+static void writeJSONString ( FILE* file, const std::string& string ) {
+    fputc( '"', file );
+    for ( unsigned char c : string ) {
+        switch ( c ) {
+            case '"':  fputs( "\\\"", file ); break;
+            case '\\': fputs( "\\\\", file ); break;
+            case '\n': fputs( "\\n", file ); break;
+            case '\r': fputs( "\\r", file ); break;
+            case '\t': fputs( "\\t", file ); break;
+            default:
+                if ( c < 0x20 ) {
+                    fprintf( file, "\\u%04x", c );
+                }
+                else {
+                    fputc( c, file );
+                }
+        }
+    }
+    fputc( '"', file );
+} /* writeJSONString() */
+
+void Raytracer::writeBlockingBuildings ( std::map<std::string, int>& blocking_buildings ) {
+    fprintf( result_file, "\t\t\"blocking_buildings\": {" );
+
+    uint i = 0;
+    for ( auto& [building, count] : blocking_buildings ) {
+        fprintf( result_file, "%s\n\t\t\t", i > 0 ? "," : "" );
+        writeJSONString( result_file, building );
+        fprintf( result_file, ": %d", count );
+        i++;
+    }
+
+    if ( i > 0 ) {
+        fprintf( result_file, "\n\t\t}\n" );
+    }
+    else {
+        fprintf( result_file, "}\n" );
+    }
+} /* writeBlockingBuildings() */
+
 
 /*---------------------------------------------------------------*/
 
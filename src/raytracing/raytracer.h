@@ -4,12 +4,15 @@
 #include "../geometry/vector.h"
 #include "../geometry/polygon.h"
 #include "field.h"
+#include "trace_result.h"
+#include "result_cache.h"
 #include "../web/urls.h"
 #include "../utils.h"
 
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <map>
 
 class Raytracer {
 public:
@@ -58,6 +61,29 @@ public:
 
     ~Raytracer();
 
+    /*
+    Load the tiles for tracing the rays to the end points in the background
+    before the raytracing reaches them (See Field::prefetchRays)
+
+    Args:
+     - end_points      : List of end points in the order they will be traced
+     - with_reflection : The end points will be traced with reflection
+    */
+    void prefetch ( std::vector<Vector>& end_points, bool with_reflection );
+
+    /*
+    Load all tiles in a bounding box in the background (See Field::prefetchArea)
+
+    Args:
+     - min_x           : Minimum UTM x coordinate (easting)
+     - min_y           : Minimum UTM y coordinate (northing)
+     - max_x           : Maximum UTM x coordinate (easting)
+     - max_y           : Maximum UTM y coordinate (northing)
+     - with_reflection : The end points will be traced with reflection
+                         (loads the LOD2 tiles too)
+    */
+    void prefetchArea ( double min_x, double min_y, double max_x, double max_y, bool with_reflection );
+
     /*
     Perform raytracing with reflection
      1. Get all surfaces in the Fresnel zone around the start and end point
@@ -79,6 +105,68 @@ public:
     */
     void raytracingDirect( Vector& end_point );
 
+    /*
+    Perform direct raytracing on a section of a trajectory (e.g. a flight log)
+    between the end points with the indices first and last
+
+    The end points first and last are traced. Between them, the section is
+    bisected only where the neighbouring results differ or where the clearance
+    of one of the rays is below clearance_threshold. All other end points
+    take over the result of the closest traced neighbour and are marked
+    as inferred in the result file.
+    The results of the end points first to last-1 are written to the result
+    file (and last too if it is the last end point of the trajectory).
+
+    Args:
+     - end_points          : List of all end points of the trajectory
+     - results             : List of results with the same length as end_points
+     - first               : Index of the first end point of the section
+     - last                : Index of the last end point of the section
+     - clearance_threshold : Rays closer to the surface than this distance in
+                             meters are always refined by bisection
+    */
+    void raytracingTrajectory (
+        std::vector<Vector>& end_points,
+        std::vector<Trace_Result>& results,
+        uint first, uint last,
+        double clearance_threshold
+    );
+
+    /*
+    Trace the direct line between the start point and the end point
+    without writing a result
+
+    Args:
+     - end_point : End point of the raytracing
+     - result    : Reference to the Trace_Result to store the counters in
+
+    Returns:
+     - Status code
+        - INTERSECTION_FOUND
+
+        - NO_INTERSECTION_FOUND
+    */
+    int traceDirect ( Vector& end_point, Trace_Result& result );
+
+    /*
+    Trace the line between two points in the DGM, DOM and DOM_MASKED layer
+    and calculate the counters
+    If a result cache file is set (RESULT_CACHE), the result is looked up
+    in the cache first and added to it after tracing
+
+    Args:
+     - start  : Start point of the segment
+     - end    : End point of the segment
+     - result : Reference to the Trace_Result to store the counters in
+
+    Returns:
+     - Status code
+        - INTERSECTION_FOUND
+
+        - NO_INTERSECTION_FOUND
+    */
+    int traceSegment ( Vector& start, Vector& end, Trace_Result& result );
+
 
     /*
     Write a JSON object in the result file with the current result
@@ -91,13 +179,15 @@ public:
      - ground_count         : Counter of how often the ray was below ground level
      - vegetation_count     : Counter of how often the ray passes through vegetation
      - infrastructure_count : Counter of how often the ray passes through infrastructure
+     - blocking_buildings   : Number of infrastructure cells per building (Optional)
     */
     void writeResultObject_WithReflection (
         Vector& end_point,
         Vector& reflection_point,
         Polygon& reflecting_polygon,
         float distance,
-        int ground_count, int vegetation_count, int infrastructure_count
+        int ground_count, int vegetation_count, int infrastructure_count,
+        std::map<std::string, int>* blocking_buildings = NULL
     );
 
     /*
@@ -109,11 +199,17 @@ public:
      - ground_count         : Counter of how often the ray was below ground level
      - vegetation_count     : Counter of how often the ray passes through vegetation
      - infrastructure_count : Counter of how often the ray passes through infrastructure
+     - inferred             : Whether the counters were inferred from a neighbouring
+                              end point instead of being traced (Optional, only
+                              written for trajectories)
+     - blocking_buildings   : Number of infrastructure cells per building (Optional)
     */
     void writeResultObject_Direct (
         Vector& end_point,
         float distance,
-        int ground_count, int vegetation_count, int infrastructure_count
+        int ground_count, int vegetation_count, int infrastructure_count,
+        bool* inferred = NULL,
+        std::map<std::string, int>* blocking_buildings = NULL
     );
 
 Field* field;
@@ -129,6 +225,20 @@ private:
     char result_file_name [256];
     FILE* result_file;
 
+    // Persistent results of earlier runs
+    ResultCache result_cache;
+
+
+    /*
+    Bisect the trajectory section between the already traced end points
+    first and last until neighbouring results are equal (See raytracingTrajectory)
+    */
+    void refineTrajectory (
+        std::vector<Vector>& end_points,
+        std::vector<Trace_Result>& results,
+        uint first, uint last,
+        double clearance_threshold
+    );
 
     void calculateCounterValues (
         std::vector<bool>& dgm_decision_array,
@@ -140,6 +250,31 @@ private:
         int& infrastructure_count
     );
 
+    /*
+    Count the infrastructure cells (DOM hit, DOM_MASKED and DGM not hit)
+    per building
+
+    Args:
+     - dgm_decision_array        : Decisions of the DGM trace
+     - dom_decision_array        : Decisions of the DOM trace
+     - dom_masked_decision_array : Decisions of the DOM_MASKED trace
+     - building_ids              : Building ID at every point of the DOM_MASKED trace
+     - blocking_buildings        : Reference to the map to add the counters to
+    */
+    void attributeBuildings (
+        std::vector<bool>& dgm_decision_array,
+        std::vector<bool>& dom_decision_array,
+        std::vector<bool>& dom_masked_decision_array,
+        std::vector<uint32_t>& building_ids,
+
+        std::map<std::string, int>& blocking_buildings
+    );
+
+    /*
+    Write the blocking buildings as a JSON object into the result file
+    */
+    void writeBlockingBuildings ( std::map<std::string, int>& blocking_buildings );
+
     /*
     Sort the polygons by their area or distance to the starting point
     depending on select_method using the Quicksort algorithm
@@ -2,8 +2,14 @@
 #include "raytracer.h"
 #include "selection_methods.h"
 #include "../utils.h"
+#include "../config.h"
+#include "../statistics.h"
+#include "../status_codes.h"
+#include "../tile/region_archive.h"
 
 #include <tuple>
+#include <variant>
+#include <optional>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <time.h>
@@ -14,6 +20,71 @@ namespace py = pybind11;
 PYBIND11_MODULE( raytracing, m ) {
     m.doc() = "Raytracing with reflection";
 
+    m.def(
+        "set_option",
+        [](
+            std::string option,
+            std::variant<bool, long, double, std::string> value
+        ) {
+            std::string value_str;
+            if ( std::holds_alternative<bool>(value) ) {
+                value_str = std::get<bool>(value) ? "true" : "false";
+            }
+            else if ( std::holds_alternative<long>(value) ) {
+                value_str = std::to_string( std::get<long>(value) );
+            }
+            else if ( std::holds_alternative<double>(value) ) {
+                value_str = std::to_string( std::get<double>(value) );
+            }
+            else {
+                value_str = std::get<std::string>(value);
+            }
+
+            int status = setConfigOption( option, value_str );
+            if ( status == UNKNOWN_CONFIG_OPTION ) {
+                printf( "ERROR: Unknown option '%s'\n", option.data() );
+            }
+            else if ( status == INVALID_TYPE_FOR_OPTION ) {
+                printf( "ERROR: Invalid value '%s' for option '%s'\n", value_str.data(), option.data() );
+            }
+
+            return status == SUCCESS ? 0 : 1;
+        },
+        py::arg( "option" ),
+        py::arg( "value" )
+    );
+
+    m.def(
+        "get_option",
+        []( std::string option ) {
+            std::string value;
+            if ( getConfigOption(option, value) != SUCCESS ) {
+                printf( "ERROR: Unknown option '%s'\n", option.data() );
+            }
+            return value;
+        },
+        py::arg( "option" )
+    );
+
+    m.def(
+        "get_statistics",
+        []() {
+            return getStatistics();
+        }
+    );
+
+    m.def(
+        "build_region_archive",
+        []( std::string archive_path ) {
+            int status = buildRegionArchive( archive_path );
+            if ( status != SUCCESS ) {
+                printf( "ERROR: Unable to create the region archive '%s'\n", archive_path.data() );
+            }
+            return status == SUCCESS ? 0 : 1;
+        },
+        py::arg( "archive_path" )
+    );
+
     m.def(
         "raytracing_with_reflection",
         [](
@@ -32,7 +103,9 @@ PYBIND11_MODULE( raytracing, m ) {
 
             std::string url_dgm1  = std::string( URL_DGM1_BAVARIA ),
             std::string url_dom20 = std::string( URL_DOM20_BAVARIA ),
-            std::string url_lod2  = std::string( URL_LOD2_BAVARIA )
+            std::string url_lod2  = std::string( URL_LOD2_BAVARIA ),
+
+            std::optional<std::tuple<double, double, double, double>> prefetch_area = std::nullopt
         ) {
             Vector _start_point(
                 std::get<0>(start_point),
@@ -72,13 +145,26 @@ PYBIND11_MODULE( raytracing, m ) {
             );
 
             uint len_end_points = end_points.size();
+
+            std::vector<Vector> _end_points;
             for ( uint i = 0; i < len_end_points; i++ ) {
-                Vector end_point(
-                    std::get<0>(end_points[i]),
-                    std::get<1>(end_points[i]),
-                    std::get<2>(end_points[i])
+                _end_points.push_back(
+                    Vector(
+                        std::get<0>(end_points[i]),
+                        std::get<1>(end_points[i]),
+                        std::get<2>(end_points[i])
+                    )
                 );
-                raytracer.raytracingWithReflection( end_point );
+            }
+
+            if ( prefetch_area ) {
+                auto [min_x, min_y, max_x, max_y] = *prefetch_area;
+                raytracer.prefetchArea( min_x, min_y, max_x, max_y, true );
+            }
+            raytracer.prefetch( _end_points, true );
+
+            for ( uint i = 0; i < len_end_points; i++ ) {
+                raytracer.raytracingWithReflection( _end_points[i] );
 
                 updateProgressBar( i+1, len_end_points );
 
@@ -103,7 +189,8 @@ PYBIND11_MODULE( raytracing, m ) {
         py::arg( "max_threads" ) = 0,
         py::arg( "url_dgm1" ) = std::string( URL_DGM1_BAVARIA ),
         py::arg( "url_dom20" ) = std::string( URL_DOM20_BAVARIA ),
-        py::arg( "url_lod2" ) = std::string( URL_LOD2_BAVARIA )
+        py::arg( "url_lod2" ) = std::string( URL_LOD2_BAVARIA ),
+        py::arg( "prefetch_area" ) = py::none()
     );
 
 
@@ -118,7 +205,9 @@ PYBIND11_MODULE( raytracing, m ) {
             int max_threads,
 
             std::string url_dgm1  = std::string( URL_DGM1_BAVARIA ),
-            std::string url_dom20 = std::string( URL_DOM20_BAVARIA )
+            std::string url_dom20 = std::string( URL_DOM20_BAVARIA ),
+
+            std::optional<std::tuple<double, double, double, double>> prefetch_area = std::nullopt
         ) {
             Vector _start_point(
                 std::get<0>(start_point),
@@ -139,14 +228,26 @@ PYBIND11_MODULE( raytracing, m ) {
             );
 
             uint len_end_points = end_points.size();
+
+            std::vector<Vector> _end_points;
             for ( uint i = 0; i < len_end_points; i++ ) {
-                Vector _end_point(
-                    std::get<0>(end_points[i]),
-                    std::get<1>(end_points[i]),
-                    std::get<2>(end_points[i])
+                _end_points.push_back(
+                    Vector(
+                        std::get<0>(end_points[i]),
+                        std::get<1>(end_points[i]),
+                        std::get<2>(end_points[i])
+                    )
                 );
+            }
 
-                raytracer.raytracingDirect( _end_point );
+            if ( prefetch_area ) {
+                auto [min_x, min_y, max_x, max_y] = *prefetch_area;
+                raytracer.prefetchArea( min_x, min_y, max_x, max_y, false );
+            }
+            raytracer.prefetch( _end_points, false );
+
+            for ( uint i = 0; i < len_end_points; i++ ) {
+                raytracer.raytracingDirect( _end_points[i] );
 
                 updateProgressBar( i+1, len_end_points );
 
@@ -164,7 +265,119 @@ PYBIND11_MODULE( raytracing, m ) {
         py::arg( "cancel_on_ground" ) = false,
         py::arg( "max_threads" ) = 0,
         py::arg( "url_dgm1" ) = std::string( URL_DGM1_BAVARIA ),
-        py::arg( "url_dom20" ) = std::string( URL_DOM20_BAVARIA )
+        py::arg( "url_dom20" ) = std::string( URL_DOM20_BAVARIA ),
+        py::arg( "prefetch_area" ) = py::none()
+    );
+
+
+    m.def(
+        "raytracing_trajectory",
+        [](
+            const std::tuple<double, double, double>& start_point,
+            const std::vector<std::tuple<double, double, double>>& end_points,
+            uint max_gap,
+            double clearance_threshold,
+            double grid_resolution,
+            double k_value,
+            bool cancel_on_ground,
+            int max_threads,
+
+            std::string url_dgm1  = std::string( URL_DGM1_BAVARIA ),
+            std::string url_dom20 = std::string( URL_DOM20_BAVARIA ),
+
+            std::optional<std::tuple<double, double, double, double>> prefetch_area = std::nullopt
+        ) {
+            Vector _start_point(
+                std::get<0>(start_point),
+                std::get<1>(start_point),
+                std::get<2>(start_point)
+            );
+
+            uint len_end_points = end_points.size();
+            if ( len_end_points == 0 ) {
+                return 0;
+            }
+            if ( max_gap < 1 ) {
+                max_gap = 1;
+            }
+
+            Raytracer raytracer (
+                _start_point,
+                BY_MAX_AREA,
+                0.1,
+                1.0,
+                2, 0.0, 868.0e6,
+                grid_resolution,
+                k_value,
+                cancel_on_ground,
+                max_threads,
+
+                url_dgm1,
+                url_dom20
+            );
+
+            std::vector<Vector> _end_points;
+            for ( uint i = 0; i < len_end_points; i++ ) {
+                _end_points.push_back(
+                    Vector(
+                        std::get<0>(end_points[i]),
+                        std::get<1>(end_points[i]),
+                        std::get<2>(end_points[i])
+                    )
+                );
+            }
+
+            if ( prefetch_area ) {
+                auto [min_x, min_y, max_x, max_y] = *prefetch_area;
+                raytracer.prefetchArea( min_x, min_y, max_x, max_y, false );
+            }
+            raytracer.prefetch( _end_points, false );
+
+            std::vector<Trace_Result> results( len_end_points );
+
+            // Trace the trajectory in sections of max_gap end points
+            for ( uint first = 0; first < len_end_points; first += max_gap ) {
+                uint last = first + max_gap;
+                if ( last > len_end_points - 1 ) {
+                    last = len_end_points - 1;
+                }
+
+                raytracer.raytracingTrajectory(
+                    _end_points, results, first, last, clearance_threshold );
+
+                updateProgressBar( last+1, len_end_points );
+
+                if ( PyErr_CheckSignals() != 0 ) {
+                    throw pybind11::error_already_set();
+                }
+
+                if ( last == len_end_points - 1 ) {
+                    break;
+                }
+            }
+
+            uint n_inferred = 0;
+            for ( uint i = 0; i < len_end_points; i++ ) {
+                if ( results[i].inferred ) {
+                    n_inferred++;
+                }
+            }
+            printf( "\nTraced %u of %u end points (%u inferred)\n",
+                    len_end_points - n_inferred, len_end_points, n_inferred );
+
+            return 0;
+        },
+        py::arg( "start_point" ),
+        py::arg( "end_points" ),
+        py::arg( "max_gap" ) = 16,
+        py::arg( "clearance_threshold" ) = 5.0,
+        py::arg( "grid_resolution" ) = 1.0,
+        py::arg( "k_value" ) = 4.0 / 3.0,
+        py::arg( "cancel_on_ground" ) = false,
+        py::arg( "max_threads" ) = 0,
+        py::arg( "url_dgm1" ) = std::string( URL_DGM1_BAVARIA ),
+        py::arg( "url_dom20" ) = std::string( URL_DOM20_BAVARIA ),
+        py::arg( "prefetch_area" ) = py::none()
     );
 
 }
@@ -0,0 +1,345 @@
+#include "result_cache.h"
+
+#include "../shared.h"
+#include "../utils.h"
+#include "../status_codes.h"
+#include "../tile/load_tile.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#define RESULT_CACHE_VERSION 1
+
+/*---------------------------------------------------------------*/
+
+/*
+Combine a hash value with an integer value (See hashBytes)
+*/
+static uint64_t hashCombine ( uint64_t hash, uint64_t value ) {
+    return hashBytes( hash, &value, sizeof(value) );
+} /* hashCombine() */
+
+/*---------------------------------------------------------------*/
+
+bool Result_Cache_Key::operator == ( const Result_Cache_Key& other ) const {
+    return
+        x_start == other.x_start && y_start == other.y_start && z_start == other.z_start &&
+        x_end   == other.x_end   && y_end   == other.y_end   && z_end   == other.z_end   &&
+        parameters_hash == other.parameters_hash &&
+        tiles_hash == other.tiles_hash;
+} /* operator == () */
+
+size_t Result_Cache_Key_Hash::operator () ( const Result_Cache_Key& key ) const {
+    uint64_t hash = HASH_START;
+    hash = hashCombine( hash, (uint32_t) key.x_start );
+    hash = hashCombine( hash, (uint32_t) key.y_start );
+    hash = hashCombine( hash, (uint32_t) key.z_start );
+    hash = hashCombine( hash, (uint32_t) key.x_end );
+    hash = hashCombine( hash, (uint32_t) key.y_end );
+    hash = hashCombine( hash, (uint32_t) key.z_end );
+    hash = hashCombine( hash, key.parameters_hash );
+    hash = hashCombine( hash, key.tiles_hash );
+    return hash;
+} /* operator () () */
+
+/*---------------------------------------------------------------*/
+
+ResultCache::ResultCache () {
+    pthread_mutex_init( &cache_mutex, NULL );
+} /* ResultCache() */
+
+ResultCache::~ResultCache () {
+    close();
+    pthread_mutex_destroy( &cache_mutex );
+} /* ~ResultCache() */
+
+/*---------------------------------------------------------------*/
+
+union cache_block {
+    uint8_t u8;
+    int32_t i32;
+    uint32_t u32;
+    uint64_t u64;
+    double f64;
+
+    char bytes [8];
+};
+
+int ResultCache::open ( std::string file_path ) {
+    union cache_block data;
+
+    file = fopen( file_path.data(), "rb" );
+
+    if ( file ) {
+        if (
+            fread( data.bytes, 1, 4, file ) != 4 ||
+            !STRNEQUAL(data.bytes, "RCCH", 4)
+        ) {
+            fclose( file );
+            file = NULL;
+            return FILE_CORRUPT;
+        }
+
+        if (
+            fread( data.bytes, 1, 4, file ) != 4 ||
+            data.u32 != RESULT_CACHE_VERSION
+        ) {
+            fclose( file );
+            file = NULL;
+            return FILE_CORRUPT;
+        }
+
+        // Read the records until the end of the file
+        // An incomplete last record (e.g. after a crash) is ignored
+        while ( fread(data.bytes, 1, 4, file) == 4 ) {
+            if ( !STRNEQUAL(data.bytes, "RSLT", 4) ) {
+                break;
+            }
+
+            Result_Cache_Key key;
+            Trace_Result result;
+
+            int32_t* cells [6] = {
+                &key.x_start, &key.y_start, &key.z_start,
+                &key.x_end, &key.y_end, &key.z_end
+            };
+            bool complete = true;
+
+            for ( int i = 0; i < 6; i++ ) {
+                complete &= fread( data.bytes, 1, 4, file ) == 4;
+                *cells[i] = data.i32;
+            }
+
+            complete &= fread( data.bytes, 1, 8, file ) == 8;
+            key.parameters_hash = data.u64;
+            complete &= fread( data.bytes, 1, 8, file ) == 8;
+            key.tiles_hash = data.u64;
+
+            complete &= fread( data.bytes, 1, 4, file ) == 4;
+            result.ground_count = data.i32;
+            complete &= fread( data.bytes, 1, 4, file ) == 4;
+            result.vegetation_count = data.i32;
+            complete &= fread( data.bytes, 1, 4, file ) == 4;
+            result.infrastructure_count = data.i32;
+
+            complete &= fread( data.bytes, 1, 8, file ) == 8;
+            result.min_clearance = data.f64;
+
+            complete &= fread( data.bytes, 1, 1, file ) == 1;
+            result.blocked = data.u8;
+
+            if ( !complete ) {
+                break;
+            }
+
+            result.traced = true;
+            results[key] = result;
+        }
+
+        fclose( file );
+
+        file = fopen( file_path.data(), "ab" );
+        if ( !file ) {
+            return FILE_NOT_CREATABLE;
+        }
+    }
+    else {
+        file = fopen( file_path.data(), "wb" );
+        if ( !file ) {
+            return FILE_NOT_CREATABLE;
+        }
+
+        fprintf( file, "RCCH" );
+        data.u32 = RESULT_CACHE_VERSION;
+        fwrite( data.bytes, 1, 4, file );
+    }
+
+    return SUCCESS;
+} /* open() */
+
+/*---------------------------------------------------------------*/
+
+void ResultCache::close () {
+    if ( file ) {
+        fclose( file );
+        file = NULL;
+    }
+    results.clear();
+    file_signatures.clear();
+} /* close() */
+
+bool ResultCache::isOpen () const {
+    return file != NULL;
+} /* isOpen() */
+
+/*---------------------------------------------------------------*/
+
+uint64_t ResultCache::fileSignature ( std::string file_path ) {
+    auto it = file_signatures.find( file_path );
+    if ( it != file_signatures.end() ) {
+        return it->second;
+    }
+
+    // (Files downloaded into memory have a signature without being on disk)
+    uint64_t signature = getSourceFileSignature( file_path );
+    if ( signature == 0 ) {
+        // Missing files may still be downloaded in this run and
+        // are therefore not remembered
+        return 0;
+    }
+
+    file_signatures[file_path] = signature;
+
+    return signature;
+} /* fileSignature() */
+
+
+uint64_t ResultCache::hashTileInputs ( Vector& start, Vector& end ) {
+    uint64_t hash = HASH_START;
+
+    // Walk along the 2D line through all 1 km tiles it touches
+    double
+        x = start.getX() / 1000.0,
+        y = start.getY() / 1000.0,
+        dx = end.getX() / 1000.0 - x,
+        dy = end.getY() / 1000.0 - y;
+
+    int
+        tile_x = (int) floor( x ),
+        tile_y = (int) floor( y ),
+        step_x = dx > 0 ? 1 : -1,
+        step_y = dy > 0 ? 1 : -1,
+        n_steps =
+            abs( (int) floor( x + dx ) - tile_x ) +
+            abs( (int) floor( y + dy ) - tile_y );
+
+    double
+        t_delta_x = dx != 0.0 ? fabs( 1.0 / dx ) : INFINITY,
+        t_delta_y = dy != 0.0 ? fabs( 1.0 / dy ) : INFINITY,
+        t_max_x = dx > 0 ? ( tile_x + 1 - x ) * t_delta_x : ( x - tile_x ) * t_delta_x,
+        t_max_y = dy > 0 ? ( tile_y + 1 - y ) * t_delta_y : ( y - tile_y ) * t_delta_y;
+
+    for ( int i = 0; i <= n_steps; i++ ) {
+        std::string
+            tile_name = buildTileName( tile_x, tile_y ),
+            lod2_tile_name = buildTileName( tile_x - tile_x % 2, tile_y - tile_y % 2 );
+
+        hash = hashBytes( hash, tile_name.data(), tile_name.size() );
+        hash = hashCombine( hash, fileSignature(DATA_DIR + "/DGM1/" + tile_name + ".tif") );
+        hash = hashCombine( hash, fileSignature(DATA_DIR + "/DOM20/32" + tile_name + "_20_DOM.tif") );
+        hash = hashCombine( hash, fileSignature(DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_FOOTPRINT.data") );
+
+        // Without PERSIST_DOWNLOADS only the binary file of a downloaded
+        // Gml file is kept
+        uint64_t lod2_signature = fileSignature( DATA_DIR + "/LOD2/" + lod2_tile_name + ".gml" );
+        if ( lod2_signature == 0 ) {
+            lod2_signature = fileSignature( DATA_DIR + "/LOD2/" + lod2_tile_name + "_LOD2.data" );
+        }
+        hash = hashCombine( hash, lod2_signature );
+
+        // Step into the next tile along the axis whose tile border is
+        // crossed first
+        if ( t_max_x < t_max_y ) {
+            tile_x += step_x;
+            t_max_x += t_delta_x;
+        }
+        else {
+            tile_y += step_y;
+            t_max_y += t_delta_y;
+        }
+    }
+
+    return hash;
+} /* hashTileInputs() */
+
+/*---------------------------------------------------------------*/
+
+void ResultCache::createKey ( Vector& start, Vector& end, Result_Cache_Key& key ) {
+    key.x_start = (int) ( start.getX() / GRID_RESOLUTION );
+    key.y_start = (int) ( start.getY() / GRID_RESOLUTION );
+    key.z_start = (int) ( round( start.getZ() ) / GRID_RESOLUTION );
+    key.x_end   = (int) ( end.getX() / GRID_RESOLUTION );
+    key.y_end   = (int) ( end.getY() / GRID_RESOLUTION );
+    key.z_end   = (int) ( round( end.getZ() ) / GRID_RESOLUTION );
+
+    // Only the parameters changing the results, how the tiles are
+    // stored and loaded is covered by the tile signatures
+    uint64_t hash = HASH_START;
+    hash = hashBytes( hash, &GRID_RESOLUTION, sizeof(GRID_RESOLUTION) );
+    hash = hashBytes( hash, &EARTH_RADIUS_EFFECTIVE, sizeof(EARTH_RADIUS_EFFECTIVE) );
+    hash = hashBytes( hash, &PLANE_DISTANCE_THRESHOLD, sizeof(PLANE_DISTANCE_THRESHOLD) );
+    hash = hashBytes( hash, &MIN_AREA, sizeof(MIN_AREA) );
+    hash = hashCombine( hash, CANCEL_ON_GROUND );
+    hash = hashCombine( hash, HEIGHT_QUANTISATION );
+    if ( HEIGHT_QUANTISATION ) {
+        hash = hashBytes( hash, &HEIGHT_QUANTISATION_STEP, sizeof(HEIGHT_QUANTISATION_STEP) );
+    }
+    key.parameters_hash = hash;
+
+    pthread_mutex_lock( &cache_mutex );
+    key.tiles_hash = hashTileInputs( start, end );
+    pthread_mutex_unlock( &cache_mutex );
+} /* createKey() */
+
+/*---------------------------------------------------------------*/
+
+bool ResultCache::lookup ( const Result_Cache_Key& key, Trace_Result& result ) {
+    pthread_mutex_lock( &cache_mutex );
+
+    auto it = results.find( key );
+    bool found = it != results.end();
+    if ( found ) {
+        result = it->second;
+    }
+
+    pthread_mutex_unlock( &cache_mutex );
+
+    return found;
+} /* lookup() */
+
+/*---------------------------------------------------------------*/
+
+void ResultCache::insert ( const Result_Cache_Key& key, const Trace_Result& result ) {
+    union cache_block data;
+
+    pthread_mutex_lock( &cache_mutex );
+
+    if ( file == NULL || results.contains(key) ) {
+        pthread_mutex_unlock( &cache_mutex );
+        return;
+    }
+
+    results[key] = result;
+
+    fprintf( file, "RSLT" );
+
+    int32_t cells [6] = {
+        key.x_start, key.y_start, key.z_start,
+        key.x_end, key.y_end, key.z_end
+    };
+    for ( int i = 0; i < 6; i++ ) {
+        data.i32 = cells[i];
+        fwrite( data.bytes, 1, 4, file );
+    }
+
+    data.u64 = key.parameters_hash;
+    fwrite( data.bytes, 1, 8, file );
+    data.u64 = key.tiles_hash;
+    fwrite( data.bytes, 1, 8, file );
+
+    data.i32 = result.ground_count;
+    fwrite( data.bytes, 1, 4, file );
+    data.i32 = result.vegetation_count;
+    fwrite( data.bytes, 1, 4, file );
+    data.i32 = result.infrastructure_count;
+    fwrite( data.bytes, 1, 4, file );
+
+    data.f64 = result.min_clearance;
+    fwrite( data.bytes, 1, 8, file );
+
+    data.u8 = result.blocked;
+    fwrite( data.bytes, 1, 1, file );
+
+    pthread_mutex_unlock( &cache_mutex );
+} /* insert() */
@@ -0,0 +1,131 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "trace_result.h"
+#include "../geometry/vector.h"
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+#include <pthread.h>
+
+/*
+Key of a traced segment in the result cache
+*/
+struct Result_Cache_Key {
+    // Start and end grid cells of the segment (as in Field::bresenhamPseudo3D)
+    int32_t
+        x_start, y_start, z_start,
+        x_end, y_end, z_end;
+
+    // Hash of all parameters that influence the result
+    uint64_t parameters_hash;
+
+    // Hash of the tile files the segment passes through
+    uint64_t tiles_hash;
+
+    bool operator == ( const Result_Cache_Key& other ) const;
+};
+
+struct Result_Cache_Key_Hash {
+    size_t operator () ( const Result_Cache_Key& key ) const;
+};
+
+/*
+Persistent key-value store for the results of traced segments
+
+The results are kept in a binary file that is read completely when
+the cache is opened. New results are appended to the end of the file
+so that the results of earlier runs are never rewritten.
+
+File layout:
+ - "RCCH" + version (uint32)
+ - Records: "RSLT" + key + ground, vegetation, infrastructure count (int32)
+            + min_clearance (double) + blocked (uint8)
+*/
+class ResultCache {
+public:
+    ResultCache ();
+    ~ResultCache ();
+
+    /*
+    Open (or create) the cache file and read all records
+
+    Args:
+     - file_path : Path to the cache file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_CREATABLE
+        - FILE_CORRUPT
+    */
+    int open ( std::string file_path );
+
+    /*
+    Close the cache file
+    */
+    void close ();
+
+    /*
+    Return whether the cache file is open
+    */
+    bool isOpen () const;
+
+    /*
+    Create the cache key for the segment between start and end with the
+    current global parameters and the current tile files
+
+    Args:
+     - start : Start point of the segment
+     - end   : End point of the segment
+     - key   : Reference to the key to fill
+    */
+    void createKey ( Vector& start, Vector& end, Result_Cache_Key& key );
+
+    /*
+    Look up the result of a segment
+
+    Args:
+     - key    : Key of the segment
+     - result : Reference to the Trace_Result to copy the result into
+
+    Returns:
+     - Result found?
+    */
+    bool lookup ( const Result_Cache_Key& key, Trace_Result& result );
+
+    /*
+    Add the result of a segment to the cache and append it to the file
+
+    Args:
+     - key    : Key of the segment
+     - result : Result of the segment
+    */
+    void insert ( const Result_Cache_Key& key, const Trace_Result& result );
+
+private:
+    FILE* file = NULL;
+
+    std::unordered_map<Result_Cache_Key, Trace_Result, Result_Cache_Key_Hash> results;
+
+    // Signatures of tile files already seen (See getSourceFileSignature)
+    std::unordered_map<std::string, uint64_t> file_signatures;
+
+    pthread_mutex_t cache_mutex;
+
+    /*
+    Return the signature of a tile file (0 if the file is unknown)
+    */
+    uint64_t fileSignature ( std::string file_path );
+
+    /*
+    Hash the signatures of all tile files that the 2D line between start
+    and end passes through
+    */
+    uint64_t hashTileInputs ( Vector& start, Vector& end );
+};
+
+#endif
@@ -0,0 +1,516 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include "../statistics.h"
+#include "../status_codes.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <pthread.h>
+
+/*
+Tile stored in a TileCache
+*/
+template <typename T>
+struct Tile_Cache_Entry {
+    Tile_Cache_Entry ( const std::string& tile_name ) : tile_name( tile_name ) {}
+
+    Tile_Cache_Entry ( const std::string& tile_name, T&& tile, size_t size ) :
+        tile_name( tile_name ), tile( std::move(tile) ), size( size ) {}
+
+    std::string tile_name;
+    T tile;
+
+    // Memory of the tile in bytes
+    size_t size = 0;
+
+    // Number of users of the tile (a pinned tile is never evicted,
+    // -1 once the tile is evicted, so it can't be pinned anymore)
+    std::atomic<int> pins { 0 };
+
+    // Tick of the cache clock at the last access (See TileCache::evict)
+    std::atomic<unsigned long> last_use { 0 };
+
+    // Loaded by the prefetcher and not used by the raytracing yet
+    std::atomic<bool> prefetched { false };
+
+    /*
+    Pin the tile unless it is evicted
+
+    Returns:
+     - Pinned?
+    */
+    bool pin () {
+        int n_pins = pins;
+        do {
+            if ( n_pins < 0 ) {
+                return false;
+            }
+        } while ( !pins.compare_exchange_weak( n_pins, n_pins + 1 ) );
+
+        return true;
+    } /* pin() */
+};
+
+/*
+Tile being loaded by a thread (See TileCache::load)
+*/
+struct Tile_Load_Slot {
+    bool done = false;
+    int status = SUCCESS;
+};
+
+/*
+Cache for the tiles of one layer with a memory budget
+
+When the tiles exceed the budget, the least recently used tiles that
+are not pinned are evicted. Every user of a tile pins it with acquire
+(or insert, load) and unpins it with release, so a tile in use by an
+in-flight ray stays in memory.
+
+Lookups of loaded tiles are lock-free: the index of the tiles is never
+changed in place. Changes (under a mutex) publish a new copy of the
+index, and the replaced indices and evicted entries are freed once no
+lookup is running anymore. An evicted tile frees its data right away,
+lookups still holding the entry fail to pin it (See
+Tile_Cache_Entry::pin). Every tile is loaded exactly once by the first
+thread needing it (See load) while other tiles of the layer are loaded
+in parallel.
+*/
+template <typename T>
+class TileCache {
+public:
+    /*
+    Args:
+     - statistics : Counters of the layer in RUN_STATISTICS
+    */
+    TileCache ( Tile_Cache_Statistics* statistics ) : statistics( statistics ) {
+        pthread_mutex_init( &lock, NULL );
+        pthread_mutex_init( &loading_mutex, NULL );
+        pthread_cond_init( &loading_cond, NULL );
+    } /* TileCache() */
+
+    ~TileCache () {
+        const Tile_Index* index = entries.load();
+        for ( auto& [tile_name, entry] : *index ) {
+            statistics->bytes -= entry->size;
+            delete entry;
+        }
+        delete index;
+
+        reclaim( true );
+
+        pthread_cond_destroy( &loading_cond );
+        pthread_mutex_destroy( &loading_mutex );
+        pthread_mutex_destroy( &lock );
+    } /* ~TileCache() */
+
+    /*
+    Set the memory budget of the cache
+
+    Args:
+     - budget : Budget in bytes (0 = unlimited)
+    */
+    void setBudget ( size_t budget ) {
+        pthread_mutex_lock( &lock );
+        this->budget = budget;
+        evictOverBudget();
+        pthread_mutex_unlock( &lock );
+    } /* setBudget() */
+
+    /*
+    Pin a tile of the cache
+
+    Args:
+     - tile_name    : Name of the tile (easting_northing)
+     - count_access : Count the access as a hit or a miss (Default: true)
+
+    Returns:
+     - Pointer to the pinned entry (NULL if the tile is not in the cache)
+    */
+    Tile_Cache_Entry<T>* acquire ( const std::string& tile_name, bool count_access = true ) {
+        n_lookups++;
+
+        const Tile_Index* index = entries.load();
+
+        Tile_Cache_Entry<T>* entry = NULL;
+
+        auto it = index->find( tile_name );
+        if ( it != index->end() && it->second->pin() ) {
+            entry = it->second;
+        }
+
+        n_lookups--;
+
+        if ( entry != NULL ) {
+            entry->last_use = ++clock;
+
+            if ( count_access ) {
+                statistics->hits++;
+
+                if ( entry->prefetched.exchange(false) ) {
+                    statistics->prefetch_hits++;
+                }
+            }
+        }
+        else if ( count_access ) {
+            statistics->misses++;
+        }
+
+        return entry;
+    } /* acquire() */
+
+    /*
+    Add a tile to the cache and pin it
+    If the tile is already in the cache, the existing tile is pinned
+
+    Args:
+     - tile_name  : Name of the tile (easting_northing)
+     - tile       : Tile (moved into the cache)
+     - size       : Memory of the tile in bytes
+     - prefetched : The tile is loaded by the prefetcher (Default: false)
+
+    Returns:
+     - Pointer to the pinned entry
+    */
+    Tile_Cache_Entry<T>* insert ( const std::string& tile_name, T&& tile, size_t size, bool prefetched = false ) {
+        return insertEntry(
+            new Tile_Cache_Entry<T>( tile_name, std::move(tile), size ),
+            prefetched
+        );
+    } /* insert() */
+
+    /*
+    Pin a tile of the cache and load it if it is not in the cache
+    Only the first thread needing a tile loads it. The other threads
+    needing the same tile wait for it, threads needing other tiles
+    are not blocked. The tile is loaded in place into its entry, so
+    it is never copied.
+
+    Args:
+     - tile_name  : Name of the tile (easting_northing)
+     - load_tile  : Function int(T& tile) loading the tile and returning
+                    a status code
+     - entry      : Reference to store the pinned entry in
+     - prefetched : The tile is loaded by the prefetcher (Default: false)
+
+    Returns:
+     - Status code of load_tile
+    */
+    template <typename Loader>
+    int load (
+        const std::string& tile_name,
+        Loader load_tile,
+        Tile_Cache_Entry<T>*& entry,
+        bool prefetched = false
+    ) {
+        std::shared_ptr<Tile_Load_Slot> slot;
+
+        while ( true ) {
+            pthread_mutex_lock( &loading_mutex );
+
+            entry = acquire( tile_name, false );
+            if ( entry != NULL ) {
+                pthread_mutex_unlock( &loading_mutex );
+                return SUCCESS;
+            }
+
+            auto it = loading.find( tile_name );
+            if ( it == loading.end() ) {
+                break;
+            }
+
+            // Wait for the thread loading the tile
+            slot = it->second;
+            while ( !slot->done ) {
+                pthread_cond_wait( &loading_cond, &loading_mutex );
+            }
+
+            pthread_mutex_unlock( &loading_mutex );
+
+            if ( slot->status != SUCCESS ) {
+                return slot->status;
+            }
+
+            // The tile might have been evicted again before it could
+            // be pinned
+        }
+
+        slot = std::make_shared<Tile_Load_Slot>();
+        loading[tile_name] = slot;
+
+        pthread_mutex_unlock( &loading_mutex );
+
+        Tile_Cache_Entry<T>* new_entry = new Tile_Cache_Entry<T>( tile_name );
+
+        int status = load_tile( new_entry->tile );
+        if ( status == SUCCESS ) {
+            new_entry->size = new_entry->tile.getMemorySize();
+            entry = insertEntry( new_entry, prefetched );
+        }
+        else {
+            delete new_entry;
+        }
+
+        pthread_mutex_lock( &loading_mutex );
+
+        slot->done = true;
+        slot->status = status;
+        loading.erase( tile_name );
+
+        pthread_cond_broadcast( &loading_cond );
+        pthread_mutex_unlock( &loading_mutex );
+
+        return status;
+    } /* load() */
+
+    /*
+    Unpin a tile pinned by acquire, insert or load
+
+    Args:
+     - entry : Pointer to the entry (NULL is ignored)
+    */
+    void release ( Tile_Cache_Entry<T>* entry ) {
+        if ( entry == NULL ) {
+            return;
+        }
+
+        // The entry may be evicted as soon as it is unpinned
+        if ( --entry->pins == 0 && budget != 0 && size > budget ) {
+            pthread_mutex_lock( &lock );
+            evictOverBudget();
+            pthread_mutex_unlock( &lock );
+        }
+    } /* release() */
+
+    /*
+    Update the memory of a pinned tile whose data changed after it was
+    loaded (e.g. data added on demand)
+
+    Args:
+     - entry    : Pointer to the pinned entry
+     - new_size : Memory of the tile in bytes
+    */
+    void resize ( Tile_Cache_Entry<T>* entry, size_t new_size ) {
+        pthread_mutex_lock( &lock );
+
+        size -= entry->size;
+        statistics->bytes -= entry->size;
+
+        entry->size = new_size;
+
+        size += entry->size;
+        statistics->bytes += entry->size;
+
+        evictOverBudget();
+
+        pthread_mutex_unlock( &lock );
+    } /* resize() */
+
+    /*
+    Check if a tile is in the cache
+    */
+    bool contains ( const std::string& tile_name ) {
+        n_lookups++;
+        bool found = entries.load()->contains( tile_name );
+        n_lookups--;
+
+        return found;
+    } /* contains() */
+
+    /*
+    Remove all tiles that are not pinned
+    */
+    void clear () {
+        pthread_mutex_lock( &lock );
+        evict( 0 );
+        pthread_mutex_unlock( &lock );
+    } /* clear() */
+
+private:
+    typedef std::unordered_map<std::string, Tile_Cache_Entry<T>*> Tile_Index;
+
+    // Current index of the tiles (replaced as a whole, See publish)
+    std::atomic<const Tile_Index*> entries { new Tile_Index() };
+
+    // Number of lookups running in the index
+    std::atomic<int> n_lookups { 0 };
+
+    // Replaced indices and evicted entries that lookups may still read
+    // (freed by reclaim)
+    std::vector<const Tile_Index*> retired_indices;
+    std::vector<Tile_Cache_Entry<T>*> retired_entries;
+
+    // Incremented on every access (See Tile_Cache_Entry::last_use)
+    std::atomic<unsigned long> clock { 0 };
+
+    std::atomic<size_t> budget { 0 }, size { 0 };
+
+    Tile_Cache_Statistics* statistics;
+
+    // Held for changes of the entries (not for lookups)
+    pthread_mutex_t lock;
+
+    /*
+    Replace the index by a changed copy and retire the old one
+    (lock must be held)
+    */
+    void publish ( const Tile_Index* index ) {
+        retired_indices.push_back( entries.exchange( index ) );
+        reclaim( false );
+    } /* publish() */
+
+    /*
+    Free the retired indices and entries if no lookup is running
+    (lock must be held)
+    Lookups starting after the check read the new index, which doesn't
+    reference the retired entries anymore.
+
+    Args:
+     - force : Free them without the check (See ~TileCache)
+    */
+    void reclaim ( bool force ) {
+        if ( !force && n_lookups != 0 ) {
+            return;
+        }
+
+        for ( const Tile_Index* index : retired_indices ) {
+            delete index;
+        }
+        for ( Tile_Cache_Entry<T>* entry : retired_entries ) {
+            delete entry;
+        }
+        retired_indices.clear();
+        retired_entries.clear();
+    } /* reclaim() */
+
+    /*
+    Add a new entry to the cache and pin it
+    If the tile is already in the cache, the new entry is deleted and the
+    existing entry is pinned
+
+    Args:
+     - new_entry  : Pointer to the new entry (owned by the cache afterwards)
+     - prefetched : The tile is loaded by the prefetcher
+
+    Returns:
+     - Pointer to the pinned entry
+    */
+    Tile_Cache_Entry<T>* insertEntry ( Tile_Cache_Entry<T>* new_entry, bool prefetched ) {
+        pthread_mutex_lock( &lock );
+
+        Tile_Cache_Entry<T>* entry;
+
+        // (The entries of the index are only evicted with lock held)
+        const Tile_Index* index = entries.load();
+
+        auto it = index->find( new_entry->tile_name );
+        if ( it != index->end() ) {
+            entry = it->second;
+            entry->pin();
+            entry->last_use = ++clock;
+
+            delete new_entry;
+        }
+        else {
+            entry = new_entry;
+            entry->pins = 1;
+            entry->last_use = ++clock;
+            entry->prefetched = prefetched;
+
+            Tile_Index* new_index = new Tile_Index( *index );
+            (*new_index)[entry->tile_name] = entry;
+            publish( new_index );
+
+            size += entry->size;
+            statistics->bytes += entry->size;
+
+            evictOverBudget();
+        }
+
+        pthread_mutex_unlock( &lock );
+
+        return entry;
+    } /* insertEntry() */
+
+    // Tiles being loaded (See load)
+    std::unordered_map<std::string, std::shared_ptr<Tile_Load_Slot>> loading;
+    pthread_mutex_t loading_mutex;
+    pthread_cond_t loading_cond;
+
+    /*
+    Evict tiles until the tiles fit into the budget of the cache
+    (lock must be held)
+    */
+    void evictOverBudget () {
+        if ( budget != 0 ) {
+            evict( budget );
+        }
+    } /* evictOverBudget() */
+
+    /*
+    Evict the least recently used tiles that are not pinned until the
+    tiles fit into a budget (lock must be held)
+    A tile pinned by a lookup meanwhile is skipped.
+
+    Args:
+     - target : Budget in bytes
+    */
+    void evict ( size_t target ) {
+        if ( size <= target ) {
+            return;
+        }
+
+        const Tile_Index* index = entries.load();
+
+        // Lookups may update last_use meanwhile, so the candidates are
+        // sorted by a copy of it
+        std::vector<std::pair<unsigned long, Tile_Cache_Entry<T>*>> candidates;
+        for ( auto& [tile_name, entry] : *index ) {
+            if ( entry->pins == 0 ) {
+                candidates.push_back( { entry->last_use, entry } );
+            }
+        }
+
+        std::sort( candidates.begin(), candidates.end() );
+
+        Tile_Index* new_index = NULL;
+
+        for ( auto& [last_use, entry] : candidates ) {
+            if ( size <= target ) {
+                break;
+            }
+
+            // Mark the entry as evicted unless it was pinned meanwhile
+            int n_pins = 0;
+            if ( !entry->pins.compare_exchange_strong( n_pins, -1 ) ) {
+                continue;
+            }
+
+            if ( new_index == NULL ) {
+                new_index = new Tile_Index( *index );
+            }
+            new_index->erase( entry->tile_name );
+
+            size -= entry->size;
+            statistics->bytes -= entry->size;
+            statistics->evictions++;
+
+            // The data of the tile is freed now, the entry only once no
+            // lookup can read it anymore
+            entry->tile = T();
+            retired_entries.push_back( entry );
+        }
+
+        if ( new_index != NULL ) {
+            publish( new_index );
+        }
+    } /* evict() */
+};
+
+#endif
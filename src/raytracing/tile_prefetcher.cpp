@@ -0,0 +1,162 @@
+#include "tile_prefetcher.h"
+
+#include "field.h"
+#include "../shared.h"
+
+/*---------------------------------------------------------------*/
+
+/*
+Key of a tile in the set of requested tiles
+*/
+static uint64_t jobKey ( uint tile_x, uint tile_y, int tile_type ) {
+    return
+        ( (uint64_t) tile_type << 48 ) |
+        ( (uint64_t)( tile_x & 0xffffff ) << 24 ) |
+        (uint64_t)( tile_y & 0xffffff );
+} /* jobKey() */
+
+/*---------------------------------------------------------------*/
+
+TilePrefetcher::TilePrefetcher ( Field* field ) {
+    this->field = field;
+
+    pthread_mutex_init( &mutex, NULL );
+    pthread_cond_init( &queue_cond, NULL );
+    pthread_cond_init( &requesting_cond, NULL );
+} /* TilePrefetcher() */
+
+/*---------------------------------------------------------------*/
+
+TilePrefetcher::~TilePrefetcher () {
+    stop();
+
+    pthread_cond_destroy( &requesting_cond );
+    pthread_cond_destroy( &queue_cond );
+    pthread_mutex_destroy( &mutex );
+} /* ~TilePrefetcher() */
+
+/*---------------------------------------------------------------*/
+
+void TilePrefetcher::request ( uint tile_x, uint tile_y, int tile_type ) {
+    if ( PREFETCH_THREADS <= 0 ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex );
+
+    if ( stopping || !requested.insert( jobKey(tile_x, tile_y, tile_type) ).second ) {
+        pthread_mutex_unlock( &mutex );
+        return;
+    }
+
+    if ( threads.empty() ) {
+        for ( int i = 0; i < PREFETCH_THREADS; i++ ) {
+            pthread_t thread;
+            if ( pthread_create( &thread, NULL, Thread_prefetchTiles, (void*)this ) == 0 ) {
+                threads.push_back( thread );
+            }
+        }
+    }
+
+    // Download the raw file of the tile first
+    uint64_t key = jobKey( tile_x, tile_y, tile_type );
+    Prefetch_Download* download = &downloads[key];
+    *download = { this, { tile_x, tile_y, tile_type } };
+
+    n_requesting++;
+    pthread_mutex_unlock( &mutex );
+
+    // (The download may be finished and the tile queued at once)
+    int status = field->requestDownload( download->job, prefetchDownloadFinished, download );
+
+    pthread_mutex_lock( &mutex );
+    n_requesting--;
+
+    if ( status != SUCCESS ) {
+        if ( !stopping ) {
+            queue.push_back( download->job );
+            pthread_cond_signal( &queue_cond );
+        }
+        downloads.erase( key );
+    }
+
+    pthread_cond_broadcast( &requesting_cond );
+    pthread_mutex_unlock( &mutex );
+} /* request() */
+
+/*---------------------------------------------------------------*/
+
+void TilePrefetcher::stop () {
+    pthread_mutex_lock( &mutex );
+    stopping = true;
+    queue.clear();
+    pthread_cond_broadcast( &queue_cond );
+
+    // All downloads are requested after this
+    while ( n_requesting > 0 ) {
+        pthread_cond_wait( &requesting_cond, &mutex );
+    }
+    pthread_mutex_unlock( &mutex );
+
+    // The downloads are finished without queueing their tiles
+    for ( auto& [key, download] : downloads ) {
+        DOWNLOAD_MANAGER.cancel( &download );
+    }
+
+    pthread_mutex_lock( &mutex );
+    downloads.clear();
+    pthread_mutex_unlock( &mutex );
+
+    for ( pthread_t& thread : threads ) {
+        pthread_join( thread, NULL );
+    }
+    threads.clear();
+} /* stop() */
+
+/*---------------------------------------------------------------*/
+
+void* Thread_prefetchTiles ( void* arg ) {
+    TilePrefetcher* prefetcher = (TilePrefetcher*) arg;
+
+    while ( true ) {
+        pthread_mutex_lock( &prefetcher->mutex );
+
+        while ( prefetcher->queue.empty() && !prefetcher->stopping ) {
+            pthread_cond_wait( &prefetcher->queue_cond, &prefetcher->mutex );
+        }
+        if ( prefetcher->stopping ) {
+            pthread_mutex_unlock( &prefetcher->mutex );
+            break;
+        }
+
+        Prefetch_Job job = prefetcher->queue.front();
+        prefetcher->queue.pop_front();
+
+        pthread_mutex_unlock( &prefetcher->mutex );
+
+        prefetcher->field->prefetchTile( job );
+    }
+
+    return NULL;
+} /* Thread_prefetchTiles() */
+
+/*---------------------------------------------------------------*/
+
+void prefetchDownloadFinished ( int status, void* arg ) {
+    Prefetch_Download* download = (Prefetch_Download*) arg;
+    TilePrefetcher* prefetcher = download->prefetcher;
+
+    pthread_mutex_lock( &prefetcher->mutex );
+
+    // Tiles that can't be downloaded are reported by the raytracing
+    if ( !prefetcher->stopping ) {
+        Prefetch_Job job = download->job;
+
+        prefetcher->queue.push_back( job );
+        pthread_cond_signal( &prefetcher->queue_cond );
+
+        prefetcher->downloads.erase( jobKey(job.tile_x, job.tile_y, job.tile_type) );
+    }
+
+    pthread_mutex_unlock( &prefetcher->mutex );
+} /* prefetchDownloadFinished() */
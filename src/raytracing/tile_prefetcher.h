@@ -0,0 +1,108 @@
+#ifndef TILE_PREFETCHER_H
+#define TILE_PREFETCHER_H
+
+#include "../web/download_manager.h"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <unordered_set>
+#include <unordered_map>
+#include <sys/types.h>
+#include <pthread.h>
+
+class Field;
+
+/*
+Tile to be loaded in the background
+*/
+struct Prefetch_Job {
+    uint tile_x, tile_y;
+
+    // Tile type (DGM, DOM, LOD2)
+    int tile_type;
+};
+
+class TilePrefetcher;
+
+/*
+Tile whose raw file is being downloaded before it is loaded
+(Argument of the download callback)
+*/
+struct Prefetch_Download {
+    TilePrefetcher* prefetcher;
+    Prefetch_Job job;
+};
+
+/*
+Loads tiles into the tile caches of a Field on background I/O threads
+before the raytracing needs them
+
+The tiles are loaded in the order they were requested (order of first
+expected use). Every tile is requested only once per prefetcher.
+
+Raw files missing locally are downloaded in parallel first (See
+DownloadManager). Their tiles are queued when the download is finished,
+so the I/O threads don't wait for the downloads.
+*/
+class TilePrefetcher {
+public:
+    /*
+    Args:
+     - field : Field whose caches the tiles are loaded into
+    */
+    TilePrefetcher ( Field* field );
+    ~TilePrefetcher ();
+
+    /*
+    Append a tile to the queue of the tiles to load
+    The I/O threads are started with the first request
+    (No effect if PREFETCH_THREADS is 0 or the tile was already requested)
+
+    Args:
+     - tile_x    : x coordinate of the tile in km (easting)
+     - tile_y    : y coordinate of the tile in km (northing)
+     - tile_type : Tile type (DGM, DOM, LOD2)
+    */
+    void request ( uint tile_x, uint tile_y, int tile_type );
+
+    /*
+    Discard the queued tiles and stop the I/O threads
+    (Tiles being loaded are finished first, the downloads of raw files
+    are finished in the background)
+    */
+    void stop ();
+
+private:
+    Field* field;
+
+    std::deque<Prefetch_Job> queue;
+
+    // Tiles requested so far (See jobKey)
+    std::unordered_set<uint64_t> requested;
+
+    // Tiles whose raw file is being downloaded (See jobKey)
+    std::unordered_map<uint64_t, Prefetch_Download> downloads;
+
+    // Number of calls of request that are requesting a download
+    int n_requesting = 0;
+    pthread_cond_t requesting_cond;
+
+    std::vector<pthread_t> threads;
+    bool stopping = false;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t queue_cond;
+
+    friend void* Thread_prefetchTiles ( void* arg );
+    friend void prefetchDownloadFinished ( int status, void* arg );
+};
+
+void* Thread_prefetchTiles ( void* arg );
+
+/*
+Queue the tile of a finished download (See Download_Callback)
+*/
+void prefetchDownloadFinished ( int status, void* arg );
+
+#endif
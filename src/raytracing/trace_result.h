@@ -0,0 +1,33 @@
+#ifndef TRACE_RESULT_H
+#define TRACE_RESULT_H
+
+#include <map>
+#include <string>
+
+/*
+Result of a raytracing between two points (Counters of the three layers)
+*/
+struct Trace_Result {
+    int
+        ground_count = 0,
+        vegetation_count = 0,
+        infrastructure_count = 0;
+
+    // Number of infrastructure cells per blocking building
+    // (only with BUILDING_ATTRIBUTION)
+    std::map<std::string, int> blocking_buildings;
+
+    // Smallest distance between the ray and the surface in meters
+    double min_clearance = 0.0;
+
+    // The ray hit the ground and the tracing was cancelled (CANCEL_ON_GROUND)
+    bool blocked = false;
+
+    // The result has been calculated (by tracing or by inference)
+    bool traced = false;
+
+    // The result was taken from a neighbouring end point instead of tracing
+    bool inferred = false;
+};
+
+#endif
@@ -25,15 +25,53 @@ double EARTH_RADIUS_EFFECTIVE;
 
 bool CANCEL_ON_GROUND;
 
+bool MEMOIZATION = true;
+
+int MEMO_CAPACITY = 100000;
+
+std::string RESULT_CACHE = "";
+
+bool BUILDING_ATTRIBUTION = false;
+
+int TILE_HUGE_PAGES = 0;
+
+int NUMA_POLICY = 0;
+
+int TILE_LAYOUT = 0;
+
+bool HEIGHT_QUANTISATION = false;
+
+double HEIGHT_QUANTISATION_STEP = 0.01;
+
+bool TILE_COMPRESSION = false;
+
+int BLOCK_CACHE_SIZE = 1024;
+
+std::string REGION_ARCHIVE = "";
+
+bool RESAMPLED_TILE_CACHE = true;
+
+bool LAZY_GEOTIFF_TILES = false;
+
+bool REMOTE_GEOTIFF_TILES = false;
+
+int TILE_BUFFER_POOL_SIZE = 512;
+
+int TILE_CACHE_BUDGET_DGM  = 0;
+int TILE_CACHE_BUDGET_DOM  = 0;
+int TILE_CACHE_BUDGET_LOD2 = 0;
+
+int PREFETCH_THREADS = 2;
+
+int DOWNLOAD_CONNECTIONS = 8;
+
+bool MEMORY_DOWNLOADS = false;
+bool PERSIST_DOWNLOADS = true;
+
 
-pthread_t* bresenham_threads;
 struct Bresenham_Thread_Data* bresenham_data;
 std::vector<bool>* decision_arrays;
+std::vector<uint32_t>* building_id_arrays;
 
 pthread_mutex_t selected_polygons_mutex;
 struct Precalculate_Thread_Data* precalc_data;
-pthread_t* precalc_threads;
-
-pthread_t* ground_area_threads;
-struct PolygonsInGroundArea_Thread_Data* ground_area_data;
-std::vector<Polygon>* ground_area_polygons;
@@ -7,6 +7,7 @@
 #include <pthread.h>
 #include <vector>
 #include <cstdio>
+#include <cstdint>
 
 
 // Directory to save the tile files in and read from
@@ -43,17 +44,91 @@ extern double EARTH_RADIUS_EFFECTIVE;
 
 extern bool CANCEL_ON_GROUND;
 
-// Threads, thread data and mutexes
-extern pthread_t* bresenham_threads;
+// Reuse the results of Bresenham traces with identical grid cells
+// within a run
+extern bool MEMOIZATION;
+
+// Maximum number of memoised Bresenham traces
+extern int MEMO_CAPACITY;
+
+// File path of the persistent result cache (empty: no cache)
+extern std::string RESULT_CACHE;
+
+// Record which buildings (LOD2 GROUND polygons) block a ray
+extern bool BUILDING_ATTRIBUTION;
+
+// Huge pages for the tile buffers (See enum HugePageModes in tile_allocator.h)
+extern int TILE_HUGE_PAGES;
+
+// Placement of the tile buffers on the NUMA nodes
+// (See enum NumaPolicies in tile_allocator.h)
+extern int NUMA_POLICY;
+
+// Memory layout of the loaded tiles (See enum TileLayouts in grid_tile.h)
+extern int TILE_LAYOUT;
+
+// Store the heights of the loaded tiles as 16 bit integers
+// (See GridTile::quantiseTile)
+extern bool HEIGHT_QUANTISATION;
+
+// Height difference in meters between two quantisation levels
+extern double HEIGHT_QUANTISATION_STEP;
+
+// Store the loaded tiles as compressed blocks (See GridTile::compressTile)
+extern bool TILE_COMPRESSION;
+
+// Number of decoded blocks of compressed tiles cached per thread
+extern int BLOCK_CACHE_SIZE;
+
+// Path of the region archive to load the tiles from ("" = none)
+// (See RegionArchive)
+extern std::string REGION_ARCHIVE;
+
+// Map the resampled grid tiles from the resampled tile cache in DATA_DIR
+// (See getResampledGridTile)
+extern bool RESAMPLED_TILE_CACHE;
+
+// Decode the blocks of the GeoTIFF files of grid tiles used in their
+// source resolution only when the raytracing reads them
+// (See GridTile::fromLazyGeoTiffFile)
+extern bool LAZY_GEOTIFF_TILES;
+
+// Fetch only the needed blocks of GeoTIFF files that are not downloaded
+// yet with HTTP range requests instead of downloading the whole files
+// (only with LAZY_GEOTIFF_TILES) (See GeoTiffFile::openRemoteGeoTiffFile)
+extern bool REMOTE_GEOTIFF_TILES;
+
+// Maximum memory in MB of the released tile buffers kept for reuse
+// (See freeTileBuffer)
+extern int TILE_BUFFER_POOL_SIZE;
+
+// Memory budgets of the tile caches of the layers in MB (0 = unlimited)
+// (See TileCache)
+extern int TILE_CACHE_BUDGET_DGM;
+extern int TILE_CACHE_BUDGET_DOM;
+extern int TILE_CACHE_BUDGET_LOD2;
+
+// Number of background I/O threads loading the tiles ahead of the
+// raytracing (0 = no prefetching) (See TilePrefetcher)
+extern int PREFETCH_THREADS;
+
+// Maximum number of files downloaded at once (See DownloadManager)
+extern int DOWNLOAD_CONNECTIONS;
+
+// Decode downloaded tiles directly from memory instead of reading them
+// from disk after the download (See DownloadManager::download)
+extern bool MEMORY_DOWNLOADS;
+
+// Save the raw files downloaded into memory in the background
+// (only with MEMORY_DOWNLOADS) (See DownloadManager::persist)
+extern bool PERSIST_DOWNLOADS;
+
+// Thread data and mutexes (the threads are the ones of WORKER_POOL)
 extern struct Bresenham_Thread_Data* bresenham_data;
 extern std::vector<bool>* decision_arrays;
+extern std::vector<uint32_t>* building_id_arrays;
 
 extern pthread_mutex_t selected_polygons_mutex;
 extern struct Precalculate_Thread_Data* precalc_data;
-extern pthread_t* precalc_threads;
-
-extern pthread_t* ground_area_threads;
-extern struct PolygonsInGroundArea_Thread_Data* ground_area_data;
-extern std::vector<Polygon>* ground_area_polygons;
 
 #endif
@@ -0,0 +1,150 @@
+#include "statistics.h"
+
+#include <cstdio>
+
+Run_Statistics RUN_STATISTICS;
+
+/*---------------------------------------------------------------*/
+
+/*
+Return the ratio n / (n + m) in percent (0 if both are 0)
+*/
+double percentage ( unsigned long n, unsigned long m ) {
+    if ( n + m == 0 ) {
+        return 0.0;
+    }
+    return 100.0 * (double) n / (double)( n + m );
+} /* percentage() */
+
+/*---------------------------------------------------------------*/
+
+void resetStatistics () {
+    RUN_STATISTICS.memo_hits = 0;
+    RUN_STATISTICS.memo_misses = 0;
+    RUN_STATISTICS.result_cache_hits = 0;
+    RUN_STATISTICS.result_cache_misses = 0;
+    RUN_STATISTICS.blocks_decoded = 0;
+    RUN_STATISTICS.lazy_blocks_decoded = 0;
+    RUN_STATISTICS.lazy_blocks_total = 0;
+    RUN_STATISTICS.remote_requests = 0;
+    RUN_STATISTICS.remote_bytes = 0;
+    RUN_STATISTICS.downloads = 0;
+    RUN_STATISTICS.downloads_joined = 0;
+    RUN_STATISTICS.download_bytes = 0;
+    RUN_STATISTICS.buffer_pool_hits = 0;
+    RUN_STATISTICS.buffer_pool_misses = 0;
+    RUN_STATISTICS.prefetch_loads = 0;
+    RUN_STATISTICS.tile_stalls = 0;
+    RUN_STATISTICS.tile_stall_time_us = 0;
+
+    // The memory of the cached tiles is not a counter of the run
+    for ( Tile_Cache_Statistics* cache : {
+        &RUN_STATISTICS.tile_cache_dgm,
+        &RUN_STATISTICS.tile_cache_dom,
+        &RUN_STATISTICS.tile_cache_lod2
+    } ) {
+        cache->hits = 0;
+        cache->misses = 0;
+        cache->evictions = 0;
+        cache->prefetch_hits = 0;
+    }
+} /* resetStatistics() */
+
+/*---------------------------------------------------------------*/
+
+std::map<std::string, double> getStatistics () {
+    std::map<std::string, double> statistics;
+
+    statistics["memo_hits"]     = RUN_STATISTICS.memo_hits;
+    statistics["memo_misses"]   = RUN_STATISTICS.memo_misses;
+    statistics["memo_hit_rate"] =
+        percentage( RUN_STATISTICS.memo_hits, RUN_STATISTICS.memo_misses );
+
+    statistics["result_cache_hits"]     = RUN_STATISTICS.result_cache_hits;
+    statistics["result_cache_misses"]   = RUN_STATISTICS.result_cache_misses;
+    statistics["result_cache_hit_rate"] =
+        percentage( RUN_STATISTICS.result_cache_hits, RUN_STATISTICS.result_cache_misses );
+
+    statistics["blocks_decoded"] = RUN_STATISTICS.blocks_decoded;
+    statistics["lazy_blocks_decoded"] = RUN_STATISTICS.lazy_blocks_decoded;
+    statistics["lazy_blocks_total"] = RUN_STATISTICS.lazy_blocks_total;
+    statistics["remote_requests"] = RUN_STATISTICS.remote_requests;
+    statistics["remote_bytes"] = RUN_STATISTICS.remote_bytes;
+    statistics["downloads"] = RUN_STATISTICS.downloads;
+    statistics["downloads_joined"] = RUN_STATISTICS.downloads_joined;
+    statistics["download_bytes"] = RUN_STATISTICS.download_bytes;
+    statistics["buffer_pool_hits"] = RUN_STATISTICS.buffer_pool_hits;
+    statistics["buffer_pool_misses"] = RUN_STATISTICS.buffer_pool_misses;
+
+    std::pair<std::string, Tile_Cache_Statistics*> caches [] = {
+        { "dgm",  &RUN_STATISTICS.tile_cache_dgm  },
+        { "dom",  &RUN_STATISTICS.tile_cache_dom  },
+        { "lod2", &RUN_STATISTICS.tile_cache_lod2 }
+    };
+    unsigned long prefetch_hits = 0;
+    for ( auto& [layer, cache] : caches ) {
+        statistics["tile_cache_hits_" + layer]      = cache->hits;
+        statistics["tile_cache_misses_" + layer]    = cache->misses;
+        statistics["tile_cache_evictions_" + layer] = cache->evictions;
+        statistics["tile_cache_bytes_" + layer]     = cache->bytes;
+
+        prefetch_hits += cache->prefetch_hits;
+    }
+
+    statistics["prefetch_loads"]    = RUN_STATISTICS.prefetch_loads;
+    statistics["prefetch_hits"]     = prefetch_hits;
+    statistics["prefetch_hit_rate"] = percentage( prefetch_hits, RUN_STATISTICS.tile_stalls );
+    statistics["tile_stalls"]       = RUN_STATISTICS.tile_stalls;
+    statistics["tile_stall_time"]   = RUN_STATISTICS.tile_stall_time_us / 1.0e6;
+
+    return statistics;
+} /* getStatistics() */
+
+/*---------------------------------------------------------------*/
+
+void printStatistics () {
+    printf( "\nRun statistics:\n" );
+
+    printf( " - Memoisation: %lu hits, %lu misses (%.02f %% hit rate)\n",
+            RUN_STATISTICS.memo_hits.load(), RUN_STATISTICS.memo_misses.load(),
+            percentage(RUN_STATISTICS.memo_hits, RUN_STATISTICS.memo_misses) );
+
+    printf( " - Result cache: %lu hits, %lu misses (%.02f %% hit rate)\n",
+            RUN_STATISTICS.result_cache_hits.load(), RUN_STATISTICS.result_cache_misses.load(),
+            percentage(RUN_STATISTICS.result_cache_hits, RUN_STATISTICS.result_cache_misses) );
+
+    printf( " - Compressed tiles: %lu blocks decoded\n", RUN_STATISTICS.blocks_decoded.load() );
+
+    printf( " - Lazy GeoTIFF tiles: %lu of %lu blocks decoded\n",
+            RUN_STATISTICS.lazy_blocks_decoded.load(), RUN_STATISTICS.lazy_blocks_total.load() );
+
+    printf( " - Remote files: %lu requests, %.01f MB downloaded\n",
+            RUN_STATISTICS.remote_requests.load(), RUN_STATISTICS.remote_bytes.load() / 1048576.0 );
+
+    printf( " - Downloads: %lu files (%lu requests joined), %.01f MB downloaded\n",
+            RUN_STATISTICS.downloads.load(), RUN_STATISTICS.downloads_joined.load(),
+            RUN_STATISTICS.download_bytes.load() / 1048576.0 );
+
+    printf( " - Buffer pool: %lu hits, %lu misses (%.02f %% hit rate)\n",
+            RUN_STATISTICS.buffer_pool_hits.load(), RUN_STATISTICS.buffer_pool_misses.load(),
+            percentage(RUN_STATISTICS.buffer_pool_hits, RUN_STATISTICS.buffer_pool_misses) );
+
+    std::pair<const char*, Tile_Cache_Statistics*> caches [] = {
+        { "DGM",  &RUN_STATISTICS.tile_cache_dgm  },
+        { "DOM",  &RUN_STATISTICS.tile_cache_dom  },
+        { "LOD2", &RUN_STATISTICS.tile_cache_lod2 }
+    };
+    unsigned long prefetch_hits = 0;
+    for ( auto& [layer, cache] : caches ) {
+        printf( " - Tile cache %s: %lu hits, %lu misses, %lu evictions, %.01f MB\n",
+                layer, cache->hits.load(), cache->misses.load(), cache->evictions.load(),
+                cache->bytes.load() / 1048576.0 );
+
+        prefetch_hits += cache->prefetch_hits;
+    }
+
+    printf( " - Prefetching: %lu tiles loaded, %lu hits, %lu stalls (%.02f %% hit rate), %.03f s stalled\n",
+            RUN_STATISTICS.prefetch_loads.load(), prefetch_hits, RUN_STATISTICS.tile_stalls.load(),
+            percentage(prefetch_hits, RUN_STATISTICS.tile_stalls),
+            RUN_STATISTICS.tile_stall_time_us / 1.0e6 );
+} /* printStatistics() */
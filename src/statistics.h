@@ -0,0 +1,100 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <atomic>
+#include <map>
+#include <string>
+
+/*
+Counters of the tile cache of one layer (See TileCache)
+*/
+struct Tile_Cache_Statistics {
+    std::atomic<unsigned long>
+        hits      { 0 },
+        misses    { 0 },
+        evictions { 0 };
+
+    // Hits on tiles loaded by the prefetcher (first use only)
+    std::atomic<unsigned long> prefetch_hits { 0 };
+
+    // Memory of the cached tiles in bytes
+    std::atomic<unsigned long> bytes { 0 };
+};
+
+/*
+Counters collected during a raytracing run
+
+The counters are reset when a Raytracer object is created and
+printed when it is destroyed
+*/
+struct Run_Statistics {
+    // Memoisation of the Bresenham traces within a run
+    std::atomic<unsigned long>
+        memo_hits   { 0 },
+        memo_misses { 0 };
+
+    // Persistent result cache across runs
+    std::atomic<unsigned long>
+        result_cache_hits   { 0 },
+        result_cache_misses { 0 };
+
+    // Blocks of compressed tiles decoded into the block caches
+    std::atomic<unsigned long> blocks_decoded { 0 };
+
+    // Blocks of lazily loaded GeoTIFF files decoded / opened
+    // (See GeoTiffFile::openGeoTiffFile)
+    std::atomic<unsigned long>
+        lazy_blocks_decoded { 0 },
+        lazy_blocks_total   { 0 };
+
+    // HTTP requests and bytes downloaded for remote files (See RemoteFile)
+    std::atomic<unsigned long>
+        remote_requests { 0 },
+        remote_bytes    { 0 };
+
+    // Files downloaded, requests joined with a running download and bytes
+    // downloaded (See DownloadManager)
+    std::atomic<unsigned long>
+        downloads        { 0 },
+        downloads_joined { 0 },
+        download_bytes   { 0 };
+
+    // Large tile buffers taken from the buffer pool / newly allocated
+    std::atomic<unsigned long>
+        buffer_pool_hits   { 0 },
+        buffer_pool_misses { 0 };
+
+    // Tiles loaded by the prefetcher (See TilePrefetcher)
+    std::atomic<unsigned long> prefetch_loads { 0 };
+
+    // Tile accesses of the raytracing that had to wait for a tile to be
+    // loaded and the total waiting time in microseconds
+    std::atomic<unsigned long>
+        tile_stalls        { 0 },
+        tile_stall_time_us { 0 };
+
+    // Tile caches of the layers
+    Tile_Cache_Statistics
+        tile_cache_dgm,
+        tile_cache_dom,
+        tile_cache_lod2;
+};
+
+extern Run_Statistics RUN_STATISTICS;
+
+/*
+Set all counters of RUN_STATISTICS to 0
+*/
+void resetStatistics ();
+
+/*
+Return the counters of RUN_STATISTICS as a map (name -> value)
+*/
+std::map<std::string, double> getStatistics ();
+
+/*
+Print the counters of RUN_STATISTICS to the console
+*/
+void printStatistics ();
+
+#endif
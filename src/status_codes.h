@@ -56,7 +56,13 @@ enum Statuscodes {
     CONFIG_WRITE_FAILURE        = 34,
 
     // Raytracing
-    NO_POLYGON_FOUND            = 35
+    NO_POLYGON_FOUND            = 35,
+
+    // Tiles
+    INVALID_QUANTISATION_STEP   = 36,
+    INVALID_BLOCK_WIDTH         = 37,
+    INVALID_LAYOUT              = 38,
+    FILE_OUTDATED               = 40
 };
 
 #endif
@@ -0,0 +1,67 @@
+#include "block_codec.h"
+
+/*---------------------------------------------------------------*/
+
+void encodeBlock (
+    const uint32_t* words,
+    uint block_width, uint block_height, uint stride,
+    std::vector<uint8_t>& out
+)
+{
+    for ( uint y = 0; y < block_height; y++ ) {
+        for ( uint x = 0; x < block_width; x++ ) {
+            uint32_t prediction = 0;
+            if ( x > 0 ) {
+                prediction = words[y*stride+x-1];
+            }
+            else if ( y > 0 ) {
+                prediction = words[(y-1)*stride];
+            }
+
+            // Zigzag encoding of the difference to the prediction
+            int32_t difference = (int32_t)( words[y*stride+x] - prediction );
+            uint32_t zigzag = ( (uint32_t)difference << 1 ) ^ (uint32_t)( difference >> 31 );
+
+            while ( zigzag >= 0x80 ) {
+                out.push_back( (uint8_t)( zigzag | 0x80 ) );
+                zigzag >>= 7;
+            }
+            out.push_back( (uint8_t) zigzag );
+        }
+    }
+} /* encodeBlock() */
+
+/*---------------------------------------------------------------*/
+
+void decodeBlock (
+    const uint8_t* data,
+    uint block_width, uint block_height, uint stride,
+    uint32_t* words
+)
+{
+    for ( uint y = 0; y < block_height; y++ ) {
+        for ( uint x = 0; x < block_width; x++ ) {
+            uint32_t zigzag = 0;
+            uint shift = 0;
+            while ( *data & 0x80 ) {
+                zigzag |= (uint32_t)( *data & 0x7F ) << shift;
+                shift += 7;
+                data++;
+            }
+            zigzag |= (uint32_t)( *data ) << shift;
+            data++;
+
+            uint32_t difference = ( zigzag >> 1 ) ^ ( ~( zigzag & 1 ) + 1 );
+
+            uint32_t prediction = 0;
+            if ( x > 0 ) {
+                prediction = words[y*stride+x-1];
+            }
+            else if ( y > 0 ) {
+                prediction = words[(y-1)*stride];
+            }
+
+            words[y*stride+x] = prediction + difference;
+        }
+    }
+} /* decodeBlock() */
@@ -0,0 +1,49 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+/*
+Fast lossless codec for blocks of a grid tile
+
+Every word is predicted by its left neighbour (first column: the word
+above it), the difference is zigzag encoded and written as a variable
+length integer (7 bits per byte). Neighbouring heights are close to
+each other, so most words need one or two bytes.
+*/
+
+/*
+Encode a block of words and append the bytes to a buffer
+
+Args:
+ - words        : Pointer to the words of the block (row by row)
+ - block_width  : Number of words per row
+ - block_height : Number of rows
+ - stride       : Distance between two rows in the array words
+ - out          : Reference to the buffer to append the bytes to
+*/
+void encodeBlock (
+    const uint32_t* words,
+    uint block_width, uint block_height, uint stride,
+    std::vector<uint8_t>& out
+);
+
+/*
+Decode a block encoded by encodeBlock
+
+Args:
+ - data         : Pointer to the first byte of the encoded block
+ - block_width  : Number of words per row
+ - block_height : Number of rows
+ - stride       : Distance between two rows in the array words
+ - words        : Pointer to the array to store the words in
+*/
+void decodeBlock (
+    const uint8_t* data,
+    uint block_width, uint block_height, uint stride,
+    uint32_t* words
+);
+
+#endif
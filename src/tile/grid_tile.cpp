@@ -3,13 +3,24 @@
 #include "../geometry/polygon.h"
 #include "../raw_data/surface.h"
 #include "../status_codes.h"
+#include "../statistics.h"
+#include "../worker_pool.h"
+#include "block_codec.h"
+#include "tile_allocator.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <tiffio.h>
 #include <cmath>
 #include <pthread.h>
 #include <vector>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*---------------------------------------------------------------*/
 
@@ -21,18 +32,140 @@ GridTile::GridTile( const GridTile& old_gridtile ) {
 
     tile_origin = old_gridtile.getOrigin();
 
-    uint len = width * width;
-    tile = new float [len];
-    memcpy( tile, old_gridtile.getData(), len*4 );
+    layout = old_gridtile.layout;
 
-    tile_memalloc = true;
+    uint len = cellCount();
+
+    if ( old_gridtile.isCompressed() ) {
+        compressed_blocks = old_gridtile.compressed_blocks;
+        block_offsets = old_gridtile.block_offsets;
+        block_width = old_gridtile.block_width;
+        blocks_per_row = old_gridtile.blocks_per_row;
+        compressed_quantised = old_gridtile.compressed_quantised;
+        compressed_id = old_gridtile.compressed_id;
+
+        quantisation_offset = old_gridtile.quantisation_offset;
+        quantisation_step = old_gridtile.quantisation_step;
+        quantisation_nodata = old_gridtile.quantisation_nodata;
+    }
+    else if ( old_gridtile.isQuantised() ) {
+        tile_quantised = allocateTileArray<uint16_t>( len );
+        memcpy( tile_quantised, old_gridtile.tile_quantised, len*sizeof(uint16_t) );
+
+        quantisation_offset = old_gridtile.quantisation_offset;
+        quantisation_step = old_gridtile.quantisation_step;
+        quantisation_nodata = old_gridtile.quantisation_nodata;
+    }
+    else if ( old_gridtile.tile_mapping ) {
+        tile_mapping = old_gridtile.tile_mapping;
+        tile = old_gridtile.tile;
+    }
+    else if ( old_gridtile.lazy_geotiff ) {
+        // The copies decode the blocks of the shared file on demand
+        lazy_geotiff = old_gridtile.lazy_geotiff;
+        tile = old_gridtile.tile;
+    }
+    else {
+        tile = allocateTileArray<float>( len );
+        memcpy( tile, old_gridtile.getData(), len*4 );
+
+        tile_memalloc = true;
+    }
+
+    if ( old_gridtile.hasBuildingIds() ) {
+        building_ids = allocateTileArray<uint16_t>( width*width );
+        memcpy( building_ids, old_gridtile.building_ids, width*width*sizeof(uint16_t) );
+
+        building_names = old_gridtile.building_names;
+        global_building_ids = old_gridtile.global_building_ids;
+    }
+
+    if ( old_gridtile.hasFootprint() ) {
+        uint len_mask = ( len + 7 ) / 8;
+
+        footprint = new uint8_t [len_mask];
+        memcpy( footprint, old_gridtile.footprint, len_mask );
+
+        footprint_edges = new uint8_t [len_mask];
+        memcpy( footprint_edges, old_gridtile.footprint_edges, len_mask );
+
+        masked_edge_values = old_gridtile.masked_edge_values;
+    }
+} /* GridTile() */
+
+GridTile::GridTile( GridTile&& old_gridtile ) {
+    *this = std::move( old_gridtile );
 } /* GridTile() */
 
+GridTile& GridTile::operator= ( GridTile&& old_gridtile ) {
+    if ( this == &old_gridtile ) {
+        return *this;
+    }
+
+    freeBuffers();
+
+    width = old_gridtile.width;
+    tile_name = std::move( old_gridtile.tile_name );
+    tile_origin = old_gridtile.tile_origin;
+    layout = old_gridtile.layout;
+
+    // The buffers are handed over, the old tile is left empty
+    tile = std::exchange( old_gridtile.tile, nullptr );
+    tile_memalloc = std::exchange( old_gridtile.tile_memalloc, false );
+    tile_mapping = std::move( old_gridtile.tile_mapping );
+    lazy_geotiff = std::move( old_gridtile.lazy_geotiff );
+
+    tile_quantised = std::exchange( old_gridtile.tile_quantised, nullptr );
+    quantisation_offset = old_gridtile.quantisation_offset;
+    quantisation_step = old_gridtile.quantisation_step;
+    quantisation_nodata = old_gridtile.quantisation_nodata;
+
+    compressed_blocks = std::move( old_gridtile.compressed_blocks );
+    block_offsets = std::move( old_gridtile.block_offsets );
+    block_width = old_gridtile.block_width;
+    blocks_per_row = old_gridtile.blocks_per_row;
+    compressed_quantised = old_gridtile.compressed_quantised;
+    compressed_id = std::exchange( old_gridtile.compressed_id, 0 );
+
+    footprint = std::exchange( old_gridtile.footprint, nullptr );
+    footprint_edges = std::exchange( old_gridtile.footprint_edges, nullptr );
+    masked_edge_values = std::move( old_gridtile.masked_edge_values );
+
+    building_ids = std::exchange( old_gridtile.building_ids, nullptr );
+    building_names = std::move( old_gridtile.building_names );
+    global_building_ids = std::move( old_gridtile.global_building_ids );
+
+    return *this;
+} /* operator=() */
+
 GridTile::~GridTile () {
+    freeBuffers();
+} /* ~GridTile() */
+
+void GridTile::freeBuffers () {
     if ( tile_memalloc ) {
-        delete[] tile;
+        freeTileBuffer( tile );
     }
-} /* ~GridTile() */
+    tile = NULL;
+    tile_memalloc = false;
+    tile_mapping.reset();
+    lazy_geotiff.reset();
+
+    if ( tile_quantised != NULL ) {
+        freeTileBuffer( tile_quantised );
+        tile_quantised = NULL;
+    }
+    if ( building_ids != NULL ) {
+        freeTileBuffer( building_ids );
+        building_ids = NULL;
+    }
+    if ( footprint != NULL ) {
+        delete[] footprint;
+        delete[] footprint_edges;
+        footprint = NULL;
+        footprint_edges = NULL;
+    }
+} /* freeBuffers() */
 
 
 /*---------------------------------------------------------------*/
@@ -40,10 +173,36 @@ GridTile::~GridTile () {
 void GridTile::emptyGridTileWithWidth ( uint width ) {
     this->width = width;
 
-    tile = new float [width*width];
+    if ( tile_quantised != NULL ) {
+        freeTileBuffer( tile_quantised );
+        tile_quantised = NULL;
+    }
+
+    compressed_blocks.clear();
+    block_offsets.clear();
+    compressed_id = 0;
+
+    if ( tile_memalloc ) {
+        freeTileBuffer( tile );
+    }
+    tile_mapping.reset();
+    lazy_geotiff.reset();
+
+    tile = allocateTileArray<float>( cellCount() );
     tile_memalloc = true;
 } /* emptyGridTileWithWidth () */
 
+void GridTile::footprintTileWithWidth ( uint width, Vector origin ) {
+    freeBuffers();
+
+    compressed_blocks.clear();
+    block_offsets.clear();
+    compressed_id = 0;
+
+    this->width = width;
+    tile_origin = origin;
+} /* footprintTileWithWidth() */
+
 void GridTile::fromGeoTiffFile ( GeoTiffFile& geotiff ) {
     this->width = geotiff.getTileWidth();
     float* values = geotiff.getData();
@@ -54,17 +213,33 @@ void GridTile::fromGeoTiffFile ( GeoTiffFile& geotiff ) {
 
     int len = width * width;
 
-    tile = new float [len];
+    if ( tile_quantised != NULL ) {
+        freeTileBuffer( tile_quantised );
+        tile_quantised = NULL;
+    }
+
+    compressed_blocks.clear();
+    block_offsets.clear();
+    compressed_id = 0;
+
+    if ( tile_memalloc ) {
+        freeTileBuffer( tile );
+    }
+    tile_mapping.reset();
+    lazy_geotiff.reset();
 
-    // Reverse the order of the lines
-    // In TIFF files the lines are presented from top to bottom
-    // whereas in our case we access them from bottom to top
-    // since the latitude increases from the equator towards the
-    // poles.
-    for ( int i=0; i<len; i++ ) {
-        tile[(width-(i/width)-1)*width+(i%width)] = values[i];
+    // The GeoTIFF reader already orders the rows from bottom to top,
+    // so in the row major layout the decoded array becomes the tile
+    if ( layout == ROW_MAJOR ) {
+        tile = geotiff.releaseData();
     }
+    else {
+        tile = allocateTileArray<float>( cellCount() );
 
+        for ( int i=0; i<len; i++ ) {
+            tile[cellIndex( i%width, i/width )] = values[i];
+        }
+    }
 
     tile_memalloc = true;
 } /* fromGeoTiffFile () */
@@ -84,7 +259,12 @@ int GridTile::getValue ( uint x, uint y, float& value ) const {
     if ( x >= width || y >= width ) {
         return COORDINATES_OUTSIDE_TILE;
     };
-    value = tile[y*width+x];
+
+    int status = decodeCell( x, y );
+    if ( status != SUCCESS ) {
+        return status;
+    }
+    value = valueAt( x, y );
 
     return SUCCESS;
 } /* getValue () */
@@ -94,318 +274,1987 @@ int GridTile::setValue ( uint x, uint y, float value ) {
         return COORDINATES_OUTSIDE_TILE;
     }
 
-    tile[width*y+x] = value;
+    if ( compressed_id != 0 ) {
+        decompressTile();
+    }
+
+    if ( tile_quantised != NULL ) {
+        tile_quantised[cellIndex(x, y)] = quantisationLevel( value );
+    }
+    else {
+        if ( tile_mapping ) {
+            detachMapping();
+        }
+
+        int status = decodeLazyTile();
+        if ( status != SUCCESS ) {
+            return status;
+        }
+
+        tile[cellIndex(x, y)] = value;
+    }
 
     return SUCCESS;
 } /* setValue() */
 
 /*---------------------------------------------------------------*/
 
-Vector GridTile::getOrigin () const {
-    return tile_origin;
-} /* getOrigin() */
+int GridTile::getClearance ( uint x, uint y, double height, double& clearance, bool masked ) const {
+    if ( x >= width || y >= width ) {
+        return COORDINATES_OUTSIDE_TILE;
+    }
 
-/*---------------------------------------------------------------*/
+    uint index = cellIndex( x, y );
 
-uint GridTile::getTileWidth () const {
-    return width;
-} /* getGridTileWidth() */
+    if ( masked && footprint != NULL ) {
+        if ( ( footprint[index >> 3] >> (index & 7) ) & 1 ) {
+            clearance = height - MASKED_VALUE;
+            return SUCCESS;
+        }
+        if ( ( footprint_edges[index >> 3] >> (index & 7) ) & 1 ) {
+            clearance = height - masked_edge_values.at( index );
+            return SUCCESS;
+        }
+    }
+
+    if ( tile_quantised != NULL ) {
+        // Compare in quantisation levels, only the difference is scaled back
+        uint16_t cell_level = tile_quantised[index];
+        if ( cell_level == QUANTISED_NODATA ) {
+            clearance = height - quantisation_nodata;
+        }
+        else {
+            double level = ( height - quantisation_offset ) / quantisation_step;
+            clearance = ( level - cell_level ) * quantisation_step;
+        }
+    }
+    else {
+        int status = decodeCell( x, y );
+        if ( status != SUCCESS ) {
+            return status;
+        }
+        clearance = height - valueAt( x, y );
+    }
 
+    return SUCCESS;
+} /* getClearance() */
 
 /*---------------------------------------------------------------*/
 
+/*
+Copy the bits of a bit mask (1 bit per cell) of a tile from one layout
+into another (dst must be cleared)
+*/
+void copyBits ( const uint8_t* src, int src_layout, uint8_t* dst, int dst_layout, uint width ) {
+    for ( uint y = 0; y < width; y++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            uint
+                src_index = layoutIndex( src_layout, width, x, y ),
+                dst_index = layoutIndex( dst_layout, width, x, y );
+
+            if ( ( src[src_index >> 3] >> (src_index & 7) ) & 1 ) {
+                dst[dst_index >> 3] |= 1 << (dst_index & 7);
+            }
+        }
+    }
+} /* copyBits() */
 
-struct indices {
-    uint start;
-    uint end;
-};
+/*---------------------------------------------------------------*/
 
-GridTile* global_grid_tile;
-VectorTile* global_vector_tile;
+int GridTile::setLayout ( int new_layout ) {
+    if ( new_layout != ROW_MAJOR && new_layout != BLOCKED && new_layout != MORTON ) {
+        return INVALID_LAYOUT;
+    }
+    if ( new_layout == layout ) {
+        return SUCCESS;
+    }
 
-void* Thread_maskTile ( void* arg ) {
-    struct indices* thread_data = (struct indices*) arg;
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
 
-    std::vector<Polygon>& polygon_list = global_vector_tile->getPolygons();
+    uint new_len = layoutLength( new_layout, width );
 
-    Vector tile_origin = global_grid_tile->getOrigin();
+    // The blocks of a compressed tile are independent of the layout
+    // The layout is applied when the tile is decompressed
+    if ( tile_quantised != NULL ) {
+        uint16_t* new_tile = allocateTileArray<uint16_t>( new_len );
+        memset( new_tile, 0, new_len*sizeof(uint16_t) );
 
-    for ( uint i = thread_data->start; i < thread_data->end; i++ ) {
-        if ( polygon_list[i].getSurfaceType() != GROUND ) {
-            continue;
+        for ( uint y = 0; y < width; y++ ) {
+            for ( uint x = 0; x < width; x++ ) {
+                new_tile[layoutIndex(new_layout, width, x, y)] = tile_quantised[cellIndex(x, y)];
+            }
         }
 
-        double
-            min_utmx = polygon_list[i].getPoints()[0].getX(),
-            max_utmx = polygon_list[i].getPoints()[0].getX(),
-            min_utmy = polygon_list[i].getPoints()[0].getY(),
-            max_utmy = polygon_list[i].getPoints()[0].getY();
-
-        uint len_point_list = polygon_list[i].getPoints().size();
-        for ( uint j = 1; j < len_point_list; j++ ) {
-            if ( polygon_list[i].getPoints()[j].getX() < min_utmx ) {
-                min_utmx = polygon_list[i].getPoints()[j].getX();
-            }
-            if ( polygon_list[i].getPoints()[j].getX() > max_utmx ) {
-                max_utmx = polygon_list[i].getPoints()[j].getX();
-            }
-            if ( polygon_list[i].getPoints()[j].getY() < min_utmy ) {
-                min_utmy = polygon_list[i].getPoints()[j].getY();
-            }
-            if ( polygon_list[i].getPoints()[j].getY() > max_utmy ) {
-                max_utmy = polygon_list[i].getPoints()[j].getY();
+        freeTileBuffer( tile_quantised );
+        tile_quantised = new_tile;
+    }
+    else if ( tile != NULL ) {
+        float* new_tile = allocateTileArray<float>( new_len );
+        memset( new_tile, 0, new_len*sizeof(float) );
+
+        for ( uint y = 0; y < width; y++ ) {
+            for ( uint x = 0; x < width; x++ ) {
+                new_tile[layoutIndex(new_layout, width, x, y)] = tile[cellIndex(x, y)];
             }
         }
 
+        if ( tile_memalloc ) {
+            freeTileBuffer( tile );
+        }
+        tile_mapping.reset();
+        tile = new_tile;
+        tile_memalloc = true;
+    }
+
+    if ( footprint != NULL ) {
+        uint len_mask = ( new_len + 7 ) / 8;
 
-        double
-            start_x = min_utmx - fmod( min_utmx, 0.2 ),
-            end_x   = max_utmx - fmod( max_utmx, 0.2 ),
-            start_y = min_utmy - fmod( min_utmy, 0.2 ),
-            end_y   = max_utmy - fmod( max_utmy, 0.2 );
+        uint8_t* new_footprint = new uint8_t [len_mask];
+        uint8_t* new_edges = new uint8_t [len_mask];
+        memset( new_footprint, 0, len_mask );
+        memset( new_edges, 0, len_mask );
+
+        copyBits( footprint, layout, new_footprint, new_layout, width );
+        copyBits( footprint_edges, layout, new_edges, new_layout, width );
 
-        Vector test_point( 0.0, 0.0, 0.0 );
+        std::unordered_map<uint32_t, float> new_edge_values;
+        for ( uint y = 0; y < width; y++ ) {
+            for ( uint x = 0; x < width; x++ ) {
+                auto it = masked_edge_values.find( cellIndex(x, y) );
+                if ( it != masked_edge_values.end() ) {
+                    new_edge_values[layoutIndex(new_layout, width, x, y)] = it->second;
+                }
+            }
+        }
+
+        delete[] footprint;
+        delete[] footprint_edges;
 
-        for ( double y = start_y; y <= end_y; y += 0.2 ) {
-            for ( double x = start_x; x <= end_x; x += 0.2 ) {
-                test_point.setX( x );
-                test_point.setY( y );
+        footprint = new_footprint;
+        footprint_edges = new_edges;
+        masked_edge_values = new_edge_values;
+    }
+
+    layout = new_layout;
 
-                if ( polygon_list[i].isPointInPolygon(test_point, true) ) {
-                    Vector coord_in_tile = ( test_point - tile_origin ) / 0.2;
+    return SUCCESS;
+} /* setLayout() */
 
-                    int
-                        tile_x = (uint) coord_in_tile.getX(),
-                        tile_y = (uint) coord_in_tile.getY();
+int GridTile::getLayout () const {
+    return layout;
+} /* getLayout() */
 
-                    if ( tile_x < 0 || tile_y < 0 ) {
-                        continue;
-                    }
+/*---------------------------------------------------------------*/
 
-                    global_grid_tile->setValue( tile_x, tile_y, -9999.0 );
+int GridTile::quantiseTile ( double step ) {
+    if ( step <= 0.0 ) {
+        return INVALID_QUANTISATION_STEP;
+    }
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+    if ( compressed_id != 0 ) {
+        decompressTile();
+    }
+    if ( tile_quantised != NULL ) {
+        dequantiseTile();
+    }
 
+    uint len = cellCount();
+
+    // Only the cells within the tile (not the padding of the layout)
+    // Cells without data would widen the range and coarsen the step
+    float min = INFINITY, max = -INFINITY;
+    bool nodata_found = false;
+    for ( uint y = 0; y < width; y++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            float value = tile[cellIndex(x, y)];
+            if ( !(value > NODATA_THRESHOLD) ) {
+                if ( !nodata_found ) {
+                    quantisation_nodata = value;
+                    nodata_found = true;
                 }
+                continue;
             }
+            if ( value < min ) min = value;
+            if ( value > max ) max = value;
         }
     }
-    return NULL;
-} /* Thread_maskTile() */
 
-void GridTile::maskTile ( VectorTile& vector_tile, int n_threads ) {
-    if ( n_threads <= 1 ) {
-        n_threads = MAX_THREADS;
+    // Tile without data
+    if ( min > max ) {
+        min = max = 0.0f;
+    }
+
+    // Coarsen the step if the range of the tile does not fit into 16 bits
+    // (without the level QUANTISED_NODATA)
+    if ( ( max - min ) / step > QUANTISED_NODATA - 1 ) {
+        step = ( max - min ) / ( QUANTISED_NODATA - 1 );
     }
 
-    global_grid_tile = this;
-    global_vector_tile = &vector_tile;
-    uint len_polygon_list = vector_tile.getPolygons().size();
+    quantisation_offset = min;
+    quantisation_step = step;
 
-    double part_size = (double) len_polygon_list / (double) n_threads;
-    double start = 0.0;
+    tile_quantised = allocateTileArray<uint16_t>( len );
+    memset( tile_quantised, 0, len*sizeof(uint16_t) );
+    for ( uint y = 0; y < width; y++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            uint index = cellIndex( x, y );
+            tile_quantised[index] = quantisationLevel( tile[index] );
+        }
+    }
 
-    struct indices* data = new struct indices [n_threads];
-    pthread_t* threads = new pthread_t [n_threads];
+    if ( tile_memalloc ) {
+        freeTileBuffer( tile );
+        tile_memalloc = false;
+    }
+    tile_mapping.reset();
+    tile = NULL;
 
-    for ( int i = 0; i < n_threads; i++ ) {
-        data[i].start = start;
-        start += part_size;
-        data[i].end = start;
+    return SUCCESS;
+} /* quantiseTile() */
 
-        pthread_create( &threads[i], NULL, Thread_maskTile, (void*)&data[i] );
+void GridTile::dequantiseTile () {
+    if ( compressed_id != 0 ) {
+        decompressTile();
+    }
+    if ( tile_quantised == NULL ) {
+        return;
     }
 
-    for ( int i = 0; i < n_threads; i++ ) {
-        pthread_join( threads[i], NULL );
+    uint len = cellCount();
+
+    tile = allocateTileArray<float>( len );
+    for ( uint i = 0; i < len; i++ ) {
+        tile[i] = quantisedHeight( tile_quantised[i] );
     }
+    tile_memalloc = true;
 
-    delete[] data;
-    delete[] threads;
-}
+    freeTileBuffer( tile_quantised );
+    tile_quantised = NULL;
+} /* dequantiseTile() */
 
-/*---------------------------------------------------------------*/
+uint16_t GridTile::quantisationLevel ( float height ) const {
+    if ( !(height > NODATA_THRESHOLD) ) {
+        return QUANTISED_NODATA;
+    }
 
-std::string GridTile::getTileName () const {
-    return tile_name;
-} /* getTileName() */
+    double level = round( (height - quantisation_offset) / quantisation_step );
+    if ( level < 0.0 ) level = 0.0;
+    if ( level > QUANTISED_NODATA - 1 ) level = QUANTISED_NODATA - 1;
 
-/*---------------------------------------------------------------*/
+    return (uint16_t) level;
+} /* quantisationLevel() */
 
-float* GridTile::getData () const {
-    return tile;
-} /* getData() */
+bool GridTile::isQuantised () const {
+    return tile_quantised != NULL || ( compressed_id != 0 && compressed_quantised );
+} /* isQuantised() */
 
 /*---------------------------------------------------------------*/
 
-float GridTile::block_accumulate (
-    int x_start, int y_start,
-    int x_end, int y_end,
-    int downsampling_method
-) {
-    float sum = 0.0, cnt = 0, min, max;
-    switch ( downsampling_method ) {
-        case AVG:
-            for ( int y = y_start; y < y_end; y++ ) {
-                for ( int x = x_start; x < x_end; x++ ) {
-                    sum += tile[y*width+x];
-                    cnt++;
-                }
-            }
+// IDs of the compressed tiles (0 = not compressed)
+static std::atomic<uint64_t> next_compressed_id { 1 };
 
-            return sum / cnt;
+int GridTile::compressTile ( uint block_width ) {
+    if ( block_width == 0 ) {
+        return INVALID_BLOCK_WIDTH;
+    }
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+    if ( compressed_id != 0 ) {
+        decompressTile();
+    }
 
+    this->block_width = block_width;
+    blocks_per_row = ( width + block_width - 1 ) / block_width;
 
-        case MIN:
-            min = tile[y_start*width+x_start];
-            for ( int y = y_start; y < y_end; y++ ) {
-                for ( int x = x_start; x < x_end; x++ ) {
-                    if ( tile[y*width+x] < min ) {
-                        min = tile[y*width+x];
-                    }
-                }
+    compressed_quantised = tile_quantised != NULL;
+
+    // Words to encode (quantisation levels or bit patterns of the floats)
+    // in row-major order
+    uint32_t* words = new uint32_t [width * width];
+    for ( uint y = 0; y < width; y++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            uint index = cellIndex( x, y );
+            if ( compressed_quantised ) {
+                words[y*width+x] = tile_quantised[index];
             }
+            else {
+                memcpy( &words[y*width+x], &tile[index], 4 );
+            }
+        }
+    }
 
-            return min;
+    compressed_blocks.clear();
+    block_offsets.clear();
 
+    for ( uint block_y = 0; block_y < blocks_per_row; block_y++ ) {
+        for ( uint block_x = 0; block_x < blocks_per_row; block_x++ ) {
+            uint
+                x_start = block_x * block_width,
+                y_start = block_y * block_width,
+                w = std::min( block_width, width - x_start ),
+                h = std::min( block_width, width - y_start );
 
-        case MAX:
-            max = tile[y_start*width+x_start];
-            for ( int y = y_start; y < y_end; y++ ) {
-                for ( int x = x_start; x < x_end; x++ ) {
-                    if ( tile[y*width+x] > max ) {
-                        max = tile[y*width+x];
-                    }
-                }
-            }
+            block_offsets.push_back( compressed_blocks.size() );
+            encodeBlock( &words[y_start*width+x_start], w, h, width, compressed_blocks );
+        }
+    }
+    block_offsets.push_back( compressed_blocks.size() );
+    compressed_blocks.shrink_to_fit();
 
-            return max;
+    delete[] words;
 
-        default:
-            return tile[y_start*width+x_start];
+    if ( compressed_quantised ) {
+        freeTileBuffer( tile_quantised );
+        tile_quantised = NULL;
+    }
+    else {
+        if ( tile_memalloc ) {
+            freeTileBuffer( tile );
+            tile_memalloc = false;
+        }
+        tile_mapping.reset();
+        tile = NULL;
     }
-} /* block_accumulate() */
 
+    compressed_id = next_compressed_id++;
 
-int GridTile::resampleTile ( float factor, int downsampling_method ) {
-    int new_width = (int)( width * factor );
-    float* new_tile = new float[new_width * new_width];
+    return SUCCESS;
+} /* compressTile() */
 
-    if ( factor == 1.0 ) {
-        return SUCCESS;
+void GridTile::decompressTile () {
+    if ( compressed_id == 0 ) {
+        return;
     }
-    if ( factor <= 0.0 ) {
-        return INVALID_RESAMPLING_FACTOR;
+
+    uint len = cellCount();
+
+    if ( compressed_quantised ) {
+        tile_quantised = allocateTileArray<uint16_t>( len );
+        memset( tile_quantised, 0, len*sizeof(uint16_t) );
+    }
+    else {
+        tile = allocateTileArray<float>( len );
+        memset( tile, 0, len*sizeof(float) );
+        tile_memalloc = true;
+    }
+
+    for ( uint block_y = 0; block_y < blocks_per_row; block_y++ ) {
+        for ( uint block_x = 0; block_x < blocks_per_row; block_x++ ) {
+            uint
+                x_start = block_x * block_width,
+                y_start = block_y * block_width,
+                w = std::min( block_width, width - x_start ),
+                h = std::min( block_width, width - y_start );
+
+            uint32_t* words = new uint32_t [w * h];
+            decodeBlock( &compressed_blocks[block_offsets[block_y*blocks_per_row+block_x]], w, h, w, words );
+
+            for ( uint y = 0; y < h; y++ ) {
+                for ( uint x = 0; x < w; x++ ) {
+                    uint index = cellIndex( x_start+x, y_start+y );
+                    if ( compressed_quantised ) {
+                        tile_quantised[index] = (uint16_t) words[y*w+x];
+                    }
+                    else {
+                        memcpy( &tile[index], &words[y*w+x], 4 );
+                    }
+                }
+            }
+
+            delete[] words;
+        }
     }
 
-    // Downsampling
-    if ( factor < 1.0 ) {
+    compressed_blocks.clear();
+    compressed_blocks.shrink_to_fit();
+    block_offsets.clear();
+    compressed_id = 0;
+} /* decompressTile() */
+
+bool GridTile::isCompressed () const {
+    return compressed_id != 0;
+} /* isCompressed() */
 
-        float step = 1.0 / factor;
-        float x_idx = 0.0, y_idx = 0.0;
+/*---------------------------------------------------------------*/
+
+void GridTile::decodeTileBlock ( uint block, float* values ) const {
+    uint
+        x_start = ( block % blocks_per_row ) * block_width,
+        y_start = ( block / blocks_per_row ) * block_width,
+        w = std::min( block_width, width - x_start ),
+        h = std::min( block_width, width - y_start );
 
-        for ( int y = 0; y < new_width; y++ ) {
-            for ( int x = 0; x < new_width; x++ ) {
-                float new_value = block_accumulate(
-                    (int)x_idx, (int)y_idx,
-                    (int)(x_idx+step), (int)(y_idx+step),
-                    downsampling_method
-                );
-                x_idx += step;
+    static thread_local std::vector<uint32_t> words;
+    words.resize( block_width * block_width );
 
-                new_tile[y*new_width+x] = new_value;
+    decodeBlock( &compressed_blocks[block_offsets[block]], w, h, block_width, words.data() );
+
+    for ( uint y = 0; y < h; y++ ) {
+        for ( uint x = 0; x < w; x++ ) {
+            uint index = y*block_width+x;
+            if ( compressed_quantised ) {
+                values[index] = quantisedHeight( words[index] );
+            }
+            else {
+                memcpy( &values[index], &words[index], 4 );
             }
-            x_idx = 0.0;
-            y_idx += step;
         }
-    } /* Downsampling */
+    }
+} /* decodeTileBlock() */
 
-    // Upsampling
-    else {
+/*---------------------------------------------------------------*/
 
-        float step = factor;
+// Cache of decoded blocks of every thread (direct mapped)
+// The rays are traced on the threads of WORKER_POOL, so the cache of a
+// thread is kept from one ray to the next. The entries are identified by
+// compressed_id (unique for every compressed tile, shared by its copies)
+// and the block index, so a reloaded tile never hits old entries.
+struct Decoded_Block {
+    uint64_t compressed_id = 0;
+    uint block = 0;
+    std::vector<float> values;
+};
 
-        float x_it = 0.0, y_it = 0.0;
-        uint x_block_start, x_block_end, y_block_start, y_block_end;
-        uint block_width, block_height;
+static thread_local std::vector<Decoded_Block> decoded_blocks;
 
-        float height_x, height_y, height_avg;
+float GridTile::compressedValueAt ( uint x, uint y ) const {
+    uint block = ( y / block_width ) * blocks_per_row + x / block_width;
 
-        for ( uint y_outer = 0; y_outer < width; y_outer++ ) {
-            for ( uint x_outer = 0; x_outer < width; x_outer++ ) {
-                x_block_start = (int)x_it;
-                x_block_end = (int)( x_it + step );
-                y_block_start = (int)y_it;
-                y_block_end = (int)( y_it + step);
+    if ( decoded_blocks.size() != (uint) std::max( BLOCK_CACHE_SIZE, 1 ) ) {
+        decoded_blocks.clear();
+        decoded_blocks.resize( std::max(BLOCK_CACHE_SIZE, 1) );
+    }
 
-                block_width = x_block_end - x_block_start;
-                block_height = y_block_end - y_block_start;
+    uint slot = ( compressed_id * 0x9E3779B97F4A7C15ULL + block ) % decoded_blocks.size();
+    Decoded_Block& decoded = decoded_blocks[slot];
 
-                if ( y_outer < width - 1 && x_outer < width - 1 ) {
-                    for ( uint y_inner = 0; y_inner < block_height; y_inner++ ) {
-                        height_y =
-                            ( tile[y_outer*width+x_outer+1] - tile[y_outer*width+x_outer] ) /
-                            block_height * y_inner + tile[y_outer*width+x_outer];
+    if ( decoded.compressed_id != compressed_id || decoded.block != block ) {
+        decoded.values.resize( block_width * block_width );
+        decodeTileBlock( block, decoded.values.data() );
 
-                        for ( uint x_inner = 0; x_inner < block_width; x_inner++ ) {
-                            height_x =
-                                ( tile[(y_outer+1)*width+x_outer] - tile[y_outer*width+x_outer] ) /
-                                block_width * x_inner + tile[y_outer*width+x_outer];
+        decoded.compressed_id = compressed_id;
+        decoded.block = block;
 
-                            height_avg = ( height_x + height_y ) / 2.0;
+        RUN_STATISTICS.blocks_decoded++;
+    }
 
-                            new_tile[(y_block_start+y_inner)*new_width+x_block_start+x_inner] = height_avg;
-                        }
-                    }
-                }
-                else {
-                    for ( uint y_inner = 0; y_inner < block_height; y_inner++ ) {
-                        for ( uint x_inner = 0; x_inner < block_width; x_inner++ ) {
-                            new_tile[(y_block_start+y_inner)*new_width+x_block_start+x_inner] =
-                                tile[y_outer*width+x_outer];
-                        }
-                    }
-                }
+    return decoded.values[( y % block_width ) * block_width + x % block_width];
+} /* compressedValueAt() */
 
-                x_it += step;
-            }
-            x_it = 0.0;
-            y_it += step;
-        }
-    } /* Upsampling */
+/*---------------------------------------------------------------*/
 
+Vector GridTile::getOrigin () const {
+    return tile_origin;
+} /* getOrigin() */
 
-    width = new_width;
-    delete[] tile;
-    tile = new_tile;
+/*---------------------------------------------------------------*/
 
-    return SUCCESS;
-} /* resampleTile() */
+uint GridTile::getTileWidth () const {
+    return width;
+} /* getGridTileWidth() */
 
 /*---------------------------------------------------------------*/
 
-int GridTile::createTifFile ( std::string file_path ) {
-    TIFF* tif = TIFFOpen( file_path.data(), "w" );
-    if ( !tif ) {
-        return FILE_NOT_CREATABLE;
+size_t GridTile::getMemorySize () const {
+    size_t size = 0;
+
+    if ( compressed_id != 0 ) {
+        size += compressed_blocks.size() + block_offsets.size() * sizeof(uint32_t);
+    }
+    else if ( tile_quantised != NULL ) {
+        size += (size_t)cellCount() * sizeof(uint16_t);
+    }
+    else if ( tile != NULL ) {
+        size += (size_t)cellCount() * sizeof(float);
     }
 
-    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
-    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, width);
-    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
-    TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+    if ( footprint != NULL ) {
+        size += 2 * ( ((size_t)cellCount() + 7) / 8 );
+        size += masked_edge_values.size() * ( sizeof(uint32_t) + sizeof(float) );
+    }
+
+    if ( building_ids != NULL ) {
+        size += (size_t)width * width * sizeof(uint16_t);
+        size += global_building_ids.size() * sizeof(uint32_t);
+        for ( const std::string& name : building_names ) {
+            size += name.size();
+        }
+    }
+
+    return size;
+} /* getMemorySize() */
+
+
+/*---------------------------------------------------------------*/
+
+
+/*
+Edge of a polygon in cell coordinates (See rasterisePolygon)
+*/
+struct Raster_Edge {
+    double
+        y_min, y_max,   // Range of the edge on the y axis
+        x_at_y_min,     // x coordinate at y_min
+        slope;          // dx/dy
+};
+
+/*
+Rasterise a polygon onto a grid with an even-odd scanline fill
+A cell (x,y) is inside the polygon if its sample point
+origin + (x,y) * cell_size is inside. The edges are sorted by their
+lowest row (edge table) and the crossings of the active edges with
+every row are paired to spans of cells.
+
+Args:
+ - points    : Corners of the polygon (the z coordinates are ignored)
+ - origin    : Sample point of the cell (0,0)
+ - cell_size : Width of a cell
+ - width     : Width of the grid in cells
+ - fill      : Function void(uint y, uint x_start, uint x_end) called for
+               every span of cells x_start...x_end-1 inside the polygon
+*/
+template <typename Fill>
+static void rasterisePolygon (
+    const std::vector<Vector>& points,
+    Vector origin,
+    double cell_size,
+    uint width,
+    Fill fill
+) {
+    size_t n_points = points.size();
+    if ( n_points < 3 ) {
+        return;
+    }
+
+    std::vector<Raster_Edge> edges;
+    edges.reserve( n_points );
+
+    double y_max = -INFINITY;
+
+    for ( size_t i = 0; i < n_points; i++ ) {
+        const Vector& p1 = points[i];
+        const Vector& p2 = points[(i+1) % n_points];
+
+        double
+            x1 = ( p1.getX() - origin.getX() ) / cell_size,
+            y1 = ( p1.getY() - origin.getY() ) / cell_size,
+            x2 = ( p2.getX() - origin.getX() ) / cell_size,
+            y2 = ( p2.getY() - origin.getY() ) / cell_size;
+
+        // Horizontal edges don't cross any row
+        if ( y1 == y2 ) {
+            continue;
+        }
+        if ( y1 > y2 ) {
+            std::swap( x1, x2 );
+            std::swap( y1, y2 );
+        }
+
+        edges.push_back( { y1, y2, x1, (x2 - x1) / (y2 - y1) } );
+        y_max = std::max( y_max, y2 );
+    }
+
+    if ( edges.empty() ) {
+        return;
+    }
+
+    std::sort(
+        edges.begin(), edges.end(),
+        [] ( const Raster_Edge& a, const Raster_Edge& b ) { return a.y_min < b.y_min; }
+    );
+
+    // Rows whose sample line crosses the polygon (every edge covers the
+    // rows in [y_min, y_max), so every row crosses an even number of edges)
+    double
+        row_start = std::max( 0.0, std::ceil(edges[0].y_min) ),
+        row_end   = std::min( (double) width, std::ceil(y_max) );
+
+    std::vector<const Raster_Edge*> active_edges;
+    std::vector<double> crossings;
+
+    size_t next_edge = 0;
+
+    for ( uint y = row_start; y < row_end; y++ ) {
+        while ( next_edge < edges.size() && edges[next_edge].y_min <= y ) {
+            active_edges.push_back( &edges[next_edge] );
+            next_edge++;
+        }
+        std::erase_if(
+            active_edges,
+            [y] ( const Raster_Edge* edge ) { return edge->y_max <= y; }
+        );
+
+        crossings.clear();
+        for ( const Raster_Edge* edge : active_edges ) {
+            crossings.push_back( edge->x_at_y_min + (y - edge->y_min) * edge->slope );
+        }
+        std::sort( crossings.begin(), crossings.end() );
+
+        for ( size_t i = 0; i + 1 < crossings.size(); i += 2 ) {
+            double
+                x_start = std::max( 0.0, std::ceil(crossings[i]) ),
+                x_end   = std::min( (double) width, std::ceil(crossings[i+1]) );
+
+            if ( x_start < x_end ) {
+                fill( y, (uint) x_start, (uint) x_end );
+            }
+        }
+    }
+} /* rasterisePolygon() */
+
+void* Thread_maskTile ( void* arg ) {
+    Mask_Thread_Data* thread_data = (Mask_Thread_Data*) arg;
+
+    std::vector<Polygon>& polygon_list = *thread_data->polygons;
+
+    GridTile* grid_tile = thread_data->grid_tile;
+
+    for ( uint i = thread_data->start; i < thread_data->end; i++ ) {
+        if ( polygon_list[i].getSurfaceType() != GROUND ) {
+            continue;
+        }
+
+        uint16_t building_id = (*thread_data->polygon_building_ids)[i];
+
+        // Cells of the DOM20 grid (0.2 m) whose lower left corner is
+        // covered by the polygon
+        rasterisePolygon(
+            polygon_list[i].getPoints(), grid_tile->getOrigin(), 0.2, grid_tile->width,
+            [grid_tile, building_id] ( uint y, uint x_start, uint x_end ) {
+                grid_tile->setFootprintSpan( x_start, x_end, y );
+
+                if ( building_id == 0 ) {
+                    return;
+                }
+
+                // Overlapping polygons may be masked by different threads,
+                // the highest ID (the last polygon of the list) wins like
+                // it would when masking the polygons one after the other
+                uint16_t* row = grid_tile->building_ids + (size_t)y * grid_tile->width;
+                for ( uint x = x_start; x < x_end; x++ ) {
+                    std::atomic_ref<uint16_t> cell( row[x] );
+                    uint16_t current = cell.load( std::memory_order_relaxed );
+                    while ( current < building_id &&
+                            !cell.compare_exchange_weak( current, building_id, std::memory_order_relaxed ) );
+                }
+            }
+        );
+    }
+    return NULL;
+} /* Thread_maskTile() */
+
+void GridTile::maskTile ( VectorTile& vector_tile, int n_parts ) {
+    maskTiles( { this }, vector_tile, n_parts );
+} /* maskTile() */
+
+void GridTile::maskTiles ( std::vector<GridTile*> grid_tiles, VectorTile& vector_tile, int n_parts ) {
+    if ( n_parts < 1 ) {
+        n_parts = ( MAX_THREADS > 0 ) ? MAX_THREADS : NUM_CORES;
+    }
+
+    std::vector<Polygon>& polygons = vector_tile.getPolygons();
+    uint len_polygon_list = polygons.size();
+
+    // Local building ID of every polygon for every tile
+    std::vector<std::vector<uint16_t>> polygon_building_ids( grid_tiles.size() );
+
+    std::vector<Mask_Thread_Data> data;
+    data.reserve( grid_tiles.size() * n_parts );
+
+    for ( size_t t = 0; t < grid_tiles.size(); t++ ) {
+        GridTile* grid_tile = grid_tiles[t];
+        std::vector<uint16_t>& tile_building_ids = polygon_building_ids[t];
+
+        grid_tile->enableFootprint();
+
+        // Assign a local building ID to every GROUND polygon
+        // ID 0 is reserved for cells without a building
+        tile_building_ids.assign( len_polygon_list, 0 );
+        if ( grid_tile->building_ids != NULL ) {
+            grid_tile->building_names.clear();
+
+            for ( uint i = 0; i < len_polygon_list; i++ ) {
+                if ( polygons[i].getSurfaceType() != GROUND || grid_tile->building_names.size() >= UINT16_MAX ) {
+                    continue;
+                }
+                grid_tile->building_names.push_back( polygons[i].getID() );
+                tile_building_ids[i] = grid_tile->building_names.size();
+            }
+        }
+
+        double part_size = (double) len_polygon_list / (double) n_parts;
+        double start = 0.0;
+
+        for ( int i = 0; i < n_parts; i++ ) {
+            Mask_Thread_Data part;
+            part.grid_tile = grid_tile;
+            part.polygons = &polygons;
+            part.polygon_building_ids = &tile_building_ids;
+            part.start = start;
+            start += part_size;
+            part.end = ( i == n_parts-1 ) ? len_polygon_list : (uint) start;
+
+            data.push_back( part );
+        }
+    }
+
+    std::vector<void*> args;
+    for ( Mask_Thread_Data& part : data ) {
+        args.push_back( (void*)&part );
+    }
+
+    WORKER_POOL.run( Thread_maskTile, args );
+} /* maskTiles() */
+
+/*---------------------------------------------------------------*/
+
+std::string GridTile::getTileName () const {
+    return tile_name;
+} /* getTileName() */
+
+/*---------------------------------------------------------------*/
+
+float* GridTile::getData () const {
+    if ( lazy_geotiff && lazy_geotiff->decodeAllBlocks() != SUCCESS ) {
+        return NULL;
+    }
+    return tile;
+} /* getData() */
+
+/*---------------------------------------------------------------*/
+
+float GridTile::block_accumulate (
+    int x_start, int y_start,
+    int x_end, int y_end,
+    int downsampling_method,
+    bool masked
+) {
+    // Value of a cell with or without masking
+    auto cell_value = [&]( int x, int y ) -> float {
+        uint index = cellIndex( x, y );
+        if ( masked && ( footprint[index >> 3] >> (index & 7) ) & 1 ) {
+            return MASKED_VALUE;
+        }
+        return tile[index];
+    };
+
+    float sum = 0.0, cnt = 0, min, max;
+    switch ( downsampling_method ) {
+        case AVG:
+            for ( int y = y_start; y < y_end; y++ ) {
+                for ( int x = x_start; x < x_end; x++ ) {
+                    sum += cell_value( x, y );
+                    cnt++;
+                }
+            }
+
+            return sum / cnt;
+
+
+        case MIN:
+            min = cell_value( x_start, y_start );
+            for ( int y = y_start; y < y_end; y++ ) {
+                for ( int x = x_start; x < x_end; x++ ) {
+                    if ( cell_value(x, y) < min ) {
+                        min = cell_value( x, y );
+                    }
+                }
+            }
+
+            return min;
+
+
+        case MAX:
+            max = cell_value( x_start, y_start );
+            for ( int y = y_start; y < y_end; y++ ) {
+                for ( int x = x_start; x < x_end; x++ ) {
+                    if ( cell_value(x, y) > max ) {
+                        max = cell_value( x, y );
+                    }
+                }
+            }
+
+            return max;
+
+        default:
+            return cell_value( x_start, y_start );
+    }
+} /* block_accumulate() */
+
+
+/*---------------------------------------------------------------*/
+
+/*
+Calculate the borders of the blocks of cells of a resampling
+Block i covers the cells block_start[i]...block_end[i]-1
+
+Args:
+ - n_blocks    : Number of blocks
+ - step        : Width of a block in cells
+ - limit       : Number of cells (the blocks are clamped to it)
+ - block_start : Reference to the vector to store the first cells in
+ - block_end   : Reference to the vector to store the end cells in
+*/
+static void resampleBlockBorders (
+    int n_blocks, float step, int limit,
+    std::vector<int>& block_start, std::vector<int>& block_end
+) {
+    block_start.resize( n_blocks );
+    block_end.resize( n_blocks );
+
+    // Same float accumulation as the original per-pixel resampling,
+    // so that the blocks and thus the results are unchanged
+    float position = 0.0;
+    for ( int i = 0; i < n_blocks; i++ ) {
+        block_start[i] = std::min( (int) position, limit );
+        block_end[i] = std::min( (int)( position + step ), limit );
+
+        if ( block_start[i] >= block_end[i] ) {
+            block_start[i] = std::min( block_start[i], limit - 1 );
+            block_end[i] = block_start[i] + 1;
+        }
+
+        position += step;
+    }
+} /* resampleBlockBorders() */
+
+/*---------------------------------------------------------------*/
+
+const float* GridTile::tileRow ( uint y, float* buffer ) const {
+    if ( layout == ROW_MAJOR ) {
+        return &tile[ (size_t) y * width ];
+    }
+
+    for ( uint x = 0; x < width; x++ ) {
+        buffer[x] = tile[cellIndex(x, y)];
+    }
+    return buffer;
+} /* tileRow() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::downsampleRows ( Resample_Thread_Data& data ) {
+    const std::vector<int>
+        &block_start = *data.block_start,
+        &block_end   = *data.block_end;
+
+    int method = data.downsampling_method;
+
+    // Reduction of the old rows of a block for every old column
+    float* columns = new float [width];
+    float* row_buffer = new float [width];
+
+    for ( int y = data.first_row; y < data.end_row; y++ ) {
+        int
+            y_start = block_start[y],
+            y_end   = block_end[y];
+
+        const float* row = tileRow( y_start, row_buffer );
+        memcpy( columns, row, width * sizeof(float) );
+
+        // Without an accumulation method the first cell of the block is used
+        if ( method == AVG || method == MIN || method == MAX ) {
+            for ( int y_old = y_start + 1; y_old < y_end; y_old++ ) {
+                row = tileRow( y_old, row_buffer );
+
+                // Contiguous loops without branches (vectorised by the compiler)
+                switch ( method ) {
+                    case AVG:
+                        for ( uint x = 0; x < width; x++ ) {
+                            columns[x] += row[x];
+                        }
+                        break;
+
+                    case MIN:
+                        for ( uint x = 0; x < width; x++ ) {
+                            columns[x] = std::min( columns[x], row[x] );
+                        }
+                        break;
+
+                    case MAX:
+                        for ( uint x = 0; x < width; x++ ) {
+                            columns[x] = std::max( columns[x], row[x] );
+                        }
+                        break;
+                }
+            }
+        }
+
+        // Reduce the columns of every block
+        for ( int x = 0; x < data.new_width; x++ ) {
+            int
+                x_start = block_start[x],
+                x_end   = block_end[x];
+
+            float value = columns[x_start];
+
+            switch ( method ) {
+                case AVG:
+                    for ( int x_old = x_start + 1; x_old < x_end; x_old++ ) {
+                        value += columns[x_old];
+                    }
+                    value /= (float)( (x_end - x_start) * (y_end - y_start) );
+                    break;
+
+                case MIN:
+                    for ( int x_old = x_start + 1; x_old < x_end; x_old++ ) {
+                        value = std::min( value, columns[x_old] );
+                    }
+                    break;
+
+                case MAX:
+                    for ( int x_old = x_start + 1; x_old < x_end; x_old++ ) {
+                        value = std::max( value, columns[x_old] );
+                    }
+                    break;
+            }
+
+            data.new_tile[layoutIndex(layout, data.new_width, x, y)] = value;
+        }
+    }
+
+    delete[] columns;
+    delete[] row_buffer;
+} /* downsampleRows() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::upsampleRows ( Resample_Thread_Data& data ) {
+    const std::vector<int>
+        &block_start = *data.block_start,
+        &block_end   = *data.block_end;
+
+    float* row_buffer = new float [width];
+    float* row_above_buffer = new float [width];
+    float* new_row_buffer = new float [data.new_width];
+
+    for ( int y_outer = data.first_row; y_outer < data.end_row; y_outer++ ) {
+        const float* row = tileRow( y_outer, row_buffer );
+        const float* row_above = NULL;
+        if ( y_outer < (int) width - 1 ) {
+            row_above = tileRow( y_outer + 1, row_above_buffer );
+        }
+
+        int
+            y_block_start = block_start[y_outer],
+            block_height  = block_end[y_outer] - y_block_start;
+
+        for ( int y_inner = 0; y_inner < block_height; y_inner++ ) {
+            float* new_row = new_row_buffer;
+            if ( layout == ROW_MAJOR ) {
+                new_row = &data.new_tile[ (size_t)( y_block_start + y_inner ) * data.new_width ];
+            }
+
+            for ( uint x_outer = 0; x_outer < width; x_outer++ ) {
+                int
+                    x_block_start = block_start[x_outer],
+                    block_width   = block_end[x_outer] - x_block_start;
+
+                float height = row[x_outer];
+                float height_right, height_above;
+
+                // The right and upper edge hold their value
+                bool interpolate = row_above != NULL && x_outer < width - 1;
+                if ( interpolate ) {
+                    height_right = row[x_outer+1];
+                    height_above = row_above[x_outer];
+                }
+
+                float* new_cells = &new_row[x_block_start];
+
+                if ( interpolate ) {
+                    float
+                        height_y = ( height_right - height ) / block_height * y_inner + height,
+                        slope_x  = ( height_above - height ) / block_width;
+
+                    for ( int x_inner = 0; x_inner < block_width; x_inner++ ) {
+                        float height_x = slope_x * x_inner + height;
+                        new_cells[x_inner] = ( height_x + height_y ) / 2.0f;
+                    }
+                }
+                else {
+                    for ( int x_inner = 0; x_inner < block_width; x_inner++ ) {
+                        new_cells[x_inner] = height;
+                    }
+                }
+            }
+
+            if ( layout != ROW_MAJOR ) {
+                for ( int x = 0; x < data.new_width; x++ ) {
+                    data.new_tile[layoutIndex(layout, data.new_width, x, y_block_start+y_inner)] =
+                        new_row[x];
+                }
+            }
+        }
+    }
+
+    delete[] row_buffer;
+    delete[] row_above_buffer;
+    delete[] new_row_buffer;
+} /* upsampleRows() */
+
+/*---------------------------------------------------------------*/
+
+void* Thread_resampleTile ( void* arg ) {
+    Resample_Thread_Data* data = (Resample_Thread_Data*) arg;
+
+    if ( data->downsampling ) {
+        data->grid_tile->downsampleRows( *data );
+    }
+    else {
+        data->grid_tile->upsampleRows( *data );
+    }
+
+    return NULL;
+} /* Thread_resampleTile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::resampleTile ( float factor, int downsampling_method ) {
+    if ( factor == 1.0 ) {
+        return SUCCESS;
+    }
+    if ( factor <= 0.0 ) {
+        return INVALID_RESAMPLING_FACTOR;
+    }
+
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    // Resample the float heights and quantise/compress the result again
+    bool compressed = isCompressed();
+    uint old_block_width = block_width;
+    if ( compressed ) {
+        decompressTile();
+    }
+
+    bool quantised = isQuantised();
+    double step = quantisation_step;
+    if ( quantised ) {
+        dequantiseTile();
+    }
+
+    int new_width = (int)( width * factor );
+    float* new_tile = allocateTileArray<float>( layoutLength(layout, new_width) );
+
+    // Downsampling: Reduce blocks of old cells into new cells, separably
+    // (first the rows of a block for all columns, then the columns)
+    // Upsampling: Interpolate every old cell into a block of new cells
+    bool downsampling = factor < 1.0;
+
+    std::vector<int> block_start, block_end;
+    if ( downsampling ) {
+        resampleBlockBorders( new_width, 1.0 / factor, width, block_start, block_end );
+    }
+    else {
+        resampleBlockBorders( width, factor, new_width, block_start, block_end );
+    }
+
+    // The tasks calculate distinct rows of the new tile
+    // (Downsampling: rows of the new tile, upsampling: rows of the old tile)
+    int n_rows = downsampling ? new_width : width;
+
+    int n_threads = ( MAX_THREADS > 0 ) ? MAX_THREADS : NUM_CORES;
+    if ( n_threads > n_rows ) {
+        n_threads = n_rows;
+    }
+    if ( n_threads < 1 ) {
+        n_threads = 1;
+    }
+
+    std::vector<Resample_Thread_Data> thread_data( n_threads );
+    std::vector<void*> args;
+
+    for ( int i = 0; i < n_threads; i++ ) {
+        thread_data[i].grid_tile = this;
+        thread_data[i].new_tile = new_tile;
+        thread_data[i].new_width = new_width;
+        thread_data[i].downsampling = downsampling;
+        thread_data[i].downsampling_method = downsampling_method;
+        thread_data[i].block_start = &block_start;
+        thread_data[i].block_end = &block_end;
+        thread_data[i].first_row = (long) n_rows * i / n_threads;
+        thread_data[i].end_row = (long) n_rows * (i+1) / n_threads;
+
+        args.push_back( (void*)&thread_data[i] );
+    }
+
+    WORKER_POOL.run( Thread_resampleTile, args );
+
+
+    if ( building_ids != NULL ) {
+        resampleBuildingIds( factor, new_width );
+    }
+    if ( footprint != NULL ) {
+        resampleFootprint( factor, new_width, downsampling_method );
+    }
+
+    width = new_width;
+    if ( tile_memalloc ) {
+        freeTileBuffer( tile );
+    }
+    tile_mapping.reset();
+    tile = new_tile;
+    tile_memalloc = true;
+
+    if ( quantised ) {
+        quantiseTile( step );
+    }
+    if ( compressed ) {
+        compressTile( old_block_width );
+    }
+
+    return SUCCESS;
+} /* resampleTile() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::resampleFootprint ( float factor, int new_width, int downsampling_method ) {
+    uint len_mask = ( layoutLength(layout, new_width) + 7 ) / 8;
+
+    uint8_t* new_footprint = new uint8_t [len_mask];
+    uint8_t* new_edges = new uint8_t [len_mask];
+    memset( new_footprint, 0, len_mask );
+    memset( new_edges, 0, len_mask );
+
+    std::unordered_map<uint32_t, float> new_edge_values;
+
+    float step = 1.0 / factor;
+
+    for ( int y = 0; y < new_width; y++ ) {
+        for ( int x = 0; x < new_width; x++ ) {
+            uint new_index = layoutIndex( layout, new_width, x, y );
+
+            // Upsampling: Bit of the source cell
+            if ( factor >= 1.0 ) {
+                uint
+                    x_old = (uint)( x * step ),
+                    y_old = (uint)( y * step ),
+                    old_index = cellIndex( x_old, y_old );
+
+                if ( x_old < width && y_old < width && ( footprint[old_index >> 3] >> (old_index & 7) ) & 1 ) {
+                    new_footprint[new_index >> 3] |= 1 << (new_index & 7);
+                }
+                continue;
+            }
+
+            // Downsampling: Count the building cells in the block
+            // (The block borders are the same as in resampleTile)
+            int
+                x_start = (int)( x * step ),
+                y_start = (int)( y * step ),
+                x_end   = (int)( x * step + step ),
+                y_end   = (int)( y * step + step );
+
+            if ( x_end > (int) width ) x_end = width;
+            if ( y_end > (int) width ) y_end = width;
+
+            uint n_cells = 0, n_building_cells = 0;
+            for ( int y_old = y_start; y_old < y_end; y_old++ ) {
+                for ( int x_old = x_start; x_old < x_end; x_old++ ) {
+                    uint old_index = cellIndex( x_old, y_old );
+                    n_building_cells += ( footprint[old_index >> 3] >> (old_index & 7) ) & 1;
+                    n_cells++;
+                }
+            }
+
+            if ( n_building_cells == 0 ) {
+                continue;
+            }
+
+            if ( n_building_cells == n_cells ) {
+                new_footprint[new_index >> 3] |= 1 << (new_index & 7);
+            }
+            else {
+                new_edges[new_index >> 3] |= 1 << (new_index & 7);
+                new_edge_values[new_index] = block_accumulate(
+                    x_start, y_start, x_end, y_end, downsampling_method, true );
+            }
+        }
+    }
+
+    delete[] footprint;
+    delete[] footprint_edges;
+
+    footprint = new_footprint;
+    footprint_edges = new_edges;
+    masked_edge_values = new_edge_values;
+} /* resampleFootprint() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::resampleBuildingIds ( float factor, int new_width ) {
+    uint16_t* new_ids = allocateTileArray<uint16_t>( new_width * new_width );
+
+    float step = 1.0 / factor;
+
+    for ( int y = 0; y < new_width; y++ ) {
+        for ( int x = 0; x < new_width; x++ ) {
+            uint16_t id = 0;
+
+            // Downsampling: First building found in the block
+            if ( factor < 1.0 ) {
+                uint
+                    x_start = (uint)( x * step ),
+                    y_start = (uint)( y * step ),
+                    x_end   = (uint)( (x+1) * step ),
+                    y_end   = (uint)( (y+1) * step );
+
+                if ( x_end > width ) x_end = width;
+                if ( y_end > width ) y_end = width;
+
+                for ( uint y_old = y_start; y_old < y_end && id == 0; y_old++ ) {
+                    for ( uint x_old = x_start; x_old < x_end && id == 0; x_old++ ) {
+                        id = building_ids[y_old*width+x_old];
+                    }
+                }
+            }
+
+            // Upsampling: Nearest cell
+            else {
+                uint
+                    x_old = (uint)( x * step ),
+                    y_old = (uint)( y * step );
+
+                if ( x_old < width && y_old < width ) {
+                    id = building_ids[y_old*width+x_old];
+                }
+            }
+
+            new_ids[y*new_width+x] = id;
+        }
+    }
+
+    freeTileBuffer( building_ids );
+    building_ids = new_ids;
+} /* resampleBuildingIds() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::createTifFile ( std::string file_path ) {
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    TIFF* tif = TIFFOpen( file_path.data(), "w" );
+    if ( !tif ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+    TIFFSetField(tif, TIFFTAG_IMAGELENGTH, width);
+    TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+    TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+    TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
 
     TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 
-    for ( uint row = 0; row < width; row++ ) {
-        float* row_data = &tile[(width-row-1) * width];
-        if ( TIFFWriteScanline(tif, row_data, row, 0) < 0 ) {
-            return FILE_NOT_CREATABLE;
+    float* row_data = new float [width];
+
+    for ( uint row = 0; row < width; row++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            row_data[x] = valueAt( x, width-row-1 );
+        }
+        if ( TIFFWriteScanline(tif, row_data, row, 0) < 0 ) {
+            delete[] row_data;
+            return FILE_NOT_CREATABLE;
+        }
+    }
+
+    delete[] row_data;
+
+    TIFFClose(tif);
+    return SUCCESS;
+} /* createTifFile() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::enableBuildingIds () {
+    if ( building_ids != NULL ) {
+        freeTileBuffer( building_ids );
+    }
+
+    building_ids = allocateTileArray<uint16_t>( width*width );
+    memset( building_ids, 0, width*width*sizeof(uint16_t) );
+} /* enableBuildingIds() */
+
+bool GridTile::hasBuildingIds () const {
+    return building_ids != NULL;
+} /* hasBuildingIds() */
+
+/*---------------------------------------------------------------*/
+
+uint16_t GridTile::getLocalBuildingId ( uint x, uint y ) const {
+    if ( building_ids == NULL || x >= width || y >= width ) {
+        return 0;
+    }
+    return building_ids[y*width+x];
+} /* getLocalBuildingId() */
+
+uint32_t GridTile::getBuildingId ( uint x, uint y ) const {
+    uint16_t local_id = getLocalBuildingId( x, y );
+    if ( local_id >= global_building_ids.size() ) {
+        return 0;
+    }
+    return global_building_ids[local_id];
+} /* getBuildingId() */
+
+/*---------------------------------------------------------------*/
+
+std::vector<std::string>& GridTile::getBuildingNames () {
+    return building_names;
+} /* getBuildingNames() */
+
+void GridTile::setGlobalBuildingIds ( std::vector<uint32_t>& global_ids ) {
+    global_building_ids = global_ids;
+} /* setGlobalBuildingIds() */
+
+/*---------------------------------------------------------------*/
+
+union building_block {
+    uint16_t u16;
+    uint32_t u32;
+
+    char bytes [4];
+};
+
+int GridTile::createBuildingIdFile ( std::string file_path ) {
+    if ( building_ids == NULL ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    FILE* file = fopen( file_path.data(), "wb" );
+    if ( !file ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    union building_block data;
+
+    fprintf( file, "BLDG" );
+
+    data.u32 = width;
+    fwrite( data.bytes, 1, 4, file );
+
+    data.u32 = building_names.size();
+    fwrite( data.bytes, 1, 4, file );
+
+    for ( std::string& name : building_names ) {
+        data.u16 = name.length();
+        fwrite( data.bytes, 1, 2, file );
+        fwrite( name.data(), 1, name.length(), file );
+    }
+
+    fprintf( file, "IDS " );
+    fwrite( building_ids, sizeof(uint16_t), width*width, file );
+
+    fclose( file );
+
+    return SUCCESS;
+} /* createBuildingIdFile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::fromBuildingIdFile ( std::string file_path ) {
+    FILE* file = fopen( file_path.data(), "rb" );
+    if ( !file ) {
+        return FILE_NOT_FOUND;
+    }
+
+    union building_block data;
+
+    if ( fread(data.bytes, 1, 4, file) != 4 || !STRNEQUAL(data.bytes, "BLDG", 4) ) {
+        fclose( file );
+        return FILE_CORRUPT;
+    }
+
+    fread( data.bytes, 1, 4, file );
+    if ( data.u32 != width ) {
+        fclose( file );
+        return TILE_SIZES_UNEQUAL;
+    }
+
+    fread( data.bytes, 1, 4, file );
+    uint32_t n_names = data.u32;
+
+    building_names.clear();
+    for ( uint32_t i = 0; i < n_names; i++ ) {
+        if ( fread(data.bytes, 1, 2, file) != 2 ) {
+            fclose( file );
+            return FILE_CORRUPT;
         }
+
+        std::string name( data.u16, ' ' );
+        fread( name.data(), 1, data.u16, file );
+        building_names.push_back( name );
     }
 
-    TIFFClose(tif);
+    fread( data.bytes, 1, 4, file );
+    if ( !STRNEQUAL(data.bytes, "IDS ", 4) ) {
+        fclose( file );
+        return FILE_CORRUPT;
+    }
+
+    enableBuildingIds();
+    if ( fread(building_ids, sizeof(uint16_t), width*width, file) != width*width ) {
+        fclose( file );
+        return FILE_CORRUPT;
+    }
+
+    fclose( file );
+
     return SUCCESS;
-} /* createTifFile() */
+} /* fromBuildingIdFile() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::enableFootprint () {
+    uint len_mask = ( cellCount() + 7 ) / 8;
+
+    if ( footprint != NULL ) {
+        delete[] footprint;
+        delete[] footprint_edges;
+    }
+
+    footprint = new uint8_t [len_mask];
+    footprint_edges = new uint8_t [len_mask];
+    memset( footprint, 0, len_mask );
+    memset( footprint_edges, 0, len_mask );
+
+    masked_edge_values.clear();
+} /* enableFootprint() */
+
+bool GridTile::hasFootprint () const {
+    return footprint != NULL;
+} /* hasFootprint() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::takeFootprint ( GridTile& masked_tile ) {
+    if ( masked_tile.width != width || masked_tile.footprint == NULL ) {
+        return TILE_SIZES_UNEQUAL;
+    }
+
+    // Only the mask is brought into the layout of the tile (the heights
+    // of the masked tile are not needed, a lazy tile stays undecoded)
+    uint len_mask = ( cellCount() + 7 ) / 8;
+
+    uint8_t* new_footprint = new uint8_t [len_mask];
+    uint8_t* new_edges = new uint8_t [len_mask];
+    memset( new_footprint, 0, len_mask );
+    memset( new_edges, 0, len_mask );
+
+    copyBits( masked_tile.footprint, masked_tile.layout, new_footprint, layout, width );
+    copyBits( masked_tile.footprint_edges, masked_tile.layout, new_edges, layout, width );
+
+    std::unordered_map<uint32_t, float> new_edge_values;
+    for ( uint y = 0; y < width; y++ ) {
+        for ( uint x = 0; x < width; x++ ) {
+            auto it = masked_tile.masked_edge_values.find( masked_tile.cellIndex(x, y) );
+            if ( it != masked_tile.masked_edge_values.end() ) {
+                new_edge_values[cellIndex(x, y)] = it->second;
+            }
+        }
+    }
+
+    if ( footprint != NULL ) {
+        delete[] footprint;
+        delete[] footprint_edges;
+    }
+
+    footprint = new_footprint;
+    footprint_edges = new_edges;
+    masked_edge_values = std::move( new_edge_values );
+
+    // The building IDs are always stored row by row
+    if ( masked_tile.building_ids != NULL ) {
+        if ( building_ids != NULL ) {
+            freeTileBuffer( building_ids );
+        }
+
+        building_ids = std::exchange( masked_tile.building_ids, nullptr );
+        building_names = std::move( masked_tile.building_names );
+        global_building_ids = std::move( masked_tile.global_building_ids );
+    }
+
+    return SUCCESS;
+} /* takeFootprint() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::setFootprintBit ( uint x, uint y ) {
+    if ( x >= width || y >= width ) {
+        return;
+    }
+
+    uint index = cellIndex( x, y );
+
+    // Several masking threads may write into the same byte
+    std::atomic_ref<uint8_t>( footprint[index >> 3] ).fetch_or( 1 << (index & 7) );
+} /* setFootprintBit() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::setFootprintSpan ( uint x_start, uint x_end, uint y ) {
+    if ( layout != ROW_MAJOR ) {
+        for ( uint x = x_start; x < x_end; x++ ) {
+            setFootprintBit( x, y );
+        }
+        return;
+    }
+
+    // Bits start...end-1 of the mask
+    size_t
+        start = (size_t)y * width + x_start,
+        end   = (size_t)y * width + x_end;
+
+    // Several masking threads may write into the same byte
+    auto setBits = [this] ( size_t byte, uint8_t bits ) {
+        std::atomic_ref<uint8_t>( footprint[byte] ).fetch_or( bits, std::memory_order_relaxed );
+    };
+
+    if ( (start >> 3) == (end >> 3) ) {
+        setBits( start >> 3, (uint8_t)( (1 << (end & 7)) - (1 << (start & 7)) ) );
+        return;
+    }
+
+    setBits( start >> 3, (uint8_t)( 0xff << (start & 7) ) );
+
+    for ( size_t byte = (start >> 3) + 1; byte < (end >> 3); byte++ ) {
+        setBits( byte, 0xff );
+    }
+
+    if ( end & 7 ) {
+        setBits( end >> 3, (uint8_t)( (1 << (end & 7)) - 1 ) );
+    }
+} /* setFootprintSpan() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::getMaskedValue ( uint x, uint y, float& value ) const {
+    if ( x >= width || y >= width ) {
+        return COORDINATES_OUTSIDE_TILE;
+    }
+
+    uint index = cellIndex( x, y );
+
+    if ( footprint != NULL ) {
+        if ( ( footprint[index >> 3] >> (index & 7) ) & 1 ) {
+            value = MASKED_VALUE;
+            return SUCCESS;
+        }
+        if ( ( footprint_edges[index >> 3] >> (index & 7) ) & 1 ) {
+            value = masked_edge_values.at( index );
+            return SUCCESS;
+        }
+    }
+
+    int status = decodeCell( x, y );
+    if ( status != SUCCESS ) {
+        return status;
+    }
+    value = valueAt( x, y );
+
+    return SUCCESS;
+} /* getMaskedValue() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::createFootprintFile ( std::string file_path ) {
+    if ( footprint == NULL ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    FILE* file = fopen( file_path.data(), "wb" );
+    if ( !file ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    union building_block data;
+
+    fprintf( file, "FTPR" );
+
+    data.u32 = width;
+    fwrite( data.bytes, 1, 4, file );
+
+    // The file is always in row-major order
+    uint len_mask = ( width * width + 7 ) / 8;
+    if ( layout == ROW_MAJOR ) {
+        fwrite( footprint, 1, len_mask, file );
+    }
+    else {
+        uint8_t* bits = new uint8_t [len_mask];
+        memset( bits, 0, len_mask );
+        copyBits( footprint, layout, bits, ROW_MAJOR, width );
+
+        fwrite( bits, 1, len_mask, file );
+        delete[] bits;
+    }
+
+    fclose( file );
+
+    return SUCCESS;
+} /* createFootprintFile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::fromFootprintFile ( std::string file_path ) {
+    FILE* file = fopen( file_path.data(), "rb" );
+    if ( !file ) {
+        return FILE_NOT_FOUND;
+    }
+
+    union building_block data;
+
+    if ( fread(data.bytes, 1, 4, file) != 4 || !STRNEQUAL(data.bytes, "FTPR", 4) ) {
+        fclose( file );
+        return FILE_CORRUPT;
+    }
+
+    fread( data.bytes, 1, 4, file );
+    if ( data.u32 != width ) {
+        fclose( file );
+        return TILE_SIZES_UNEQUAL;
+    }
+
+    uint len_mask = ( width * width + 7 ) / 8;
+    uint8_t* bits = new uint8_t [len_mask];
+    if ( fread(bits, 1, len_mask, file) != len_mask ) {
+        delete[] bits;
+        fclose( file );
+        return FILE_CORRUPT;
+    }
+
+    fclose( file );
+
+    enableFootprint();
+    copyBits( bits, ROW_MAJOR, footprint, layout, width );
+
+    delete[] bits;
+
+    return SUCCESS;
+} /* fromFootprintFile() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::fromLazyGeoTiffFile ( std::shared_ptr<GeoTiffFile> geotiff ) {
+    freeBuffers();
+
+    compressed_blocks.clear();
+    block_offsets.clear();
+    compressed_id = 0;
+
+    width = geotiff->getTileWidth();
+    tile_name = geotiff->getTileName();
+
+    tile_origin.setX( (double)geotiff->getUtmOriginX() );
+    tile_origin.setY( (double)geotiff->getUtmOriginY() );
+
+    // The data of the GeoTIFF file is in the row major layout
+    layout = ROW_MAJOR;
+
+    lazy_geotiff = geotiff;
+    tile = geotiff->getData();
+    tile_memalloc = false;
+} /* fromLazyGeoTiffFile() */
+
+bool GridTile::isLazy () const {
+    return lazy_geotiff != NULL;
+} /* isLazy() */
+
+int GridTile::decodeLazyTile () {
+    if ( !lazy_geotiff ) {
+        return SUCCESS;
+    }
+
+    int status = lazy_geotiff->decodeAllBlocks();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    // Copies of the tile still read the data of the shared file
+    if ( lazy_geotiff.use_count() > 1 ) {
+        tile = allocateTileArray<float>( cellCount() );
+        memcpy( tile, lazy_geotiff->getData(), cellCount() * sizeof(float) );
+    }
+    else {
+        tile = lazy_geotiff->releaseData();
+    }
+    tile_memalloc = true;
+
+    lazy_geotiff.reset();
+
+    return SUCCESS;
+} /* decodeLazyTile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::decodeCell ( uint x, uint y ) const {
+    if ( lazy_geotiff ) {
+        return lazy_geotiff->decodeBlockAt( x, y );
+    }
+    return SUCCESS;
+} /* decodeCell() */
+
+/*---------------------------------------------------------------*/
+
+void GridTile::detachMapping () {
+    uint len = cellCount();
+
+    float* new_tile = allocateTileArray<float>( len );
+    memcpy( new_tile, tile, len*sizeof(float) );
+
+    tile_mapping.reset();
+    tile = new_tile;
+    tile_memalloc = true;
+} /* detachMapping() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::createResampledFile ( std::string file_path, uint64_t source_signature ) {
+    int status = decodeLazyTile();
+    if ( status != SUCCESS ) {
+        return status;
+    }
+
+    if ( layout != ROW_MAJOR || tile == NULL || isQuantised() || isCompressed() ) {
+        return INVALID_LAYOUT;
+    }
+
+    // Write to a temporary file first so that other processes never
+    // map a partially written file
+    std::string tmp_file_path = file_path + ".tmp" + std::to_string( getpid() );
+
+    FILE* file = fopen( tmp_file_path.data(), "wb" );
+    if ( !file ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    uint8_t header [RESAMPLED_FILE_HEADER_SIZE] = { 0 };
+    uint32_t
+        version  = RESAMPLED_FILE_VERSION,
+        origin_x = (uint32_t) tile_origin.getX(),
+        origin_y = (uint32_t) tile_origin.getY(),
+        flags    = ( footprint != NULL ? 1 : 0 ) | ( building_ids != NULL ? 2 : 0 );
+
+    memcpy( header, "RTIL", 4 );
+    memcpy( header+4, &version, 4 );
+    memcpy( header+8, &source_signature, 8 );
+    memcpy( header+16, &width, 4 );
+    memcpy( header+20, &origin_x, 4 );
+    memcpy( header+24, &origin_y, 4 );
+    memcpy( header+28, &flags, 4 );
+    strncpy( (char*)header+32, tile_name.data(), RESAMPLED_FILE_HEADER_SIZE-33 );
+
+    size_t len = (size_t)width * width;
+
+    bool written =
+        fwrite( header, 1, RESAMPLED_FILE_HEADER_SIZE, file ) == RESAMPLED_FILE_HEADER_SIZE &&
+        fwrite( tile, sizeof(float), len, file ) == len;
+
+    if ( footprint != NULL ) {
+        size_t len_mask = ( len + 7 ) / 8;
+        uint32_t n_edges = masked_edge_values.size();
+
+        written = written &&
+            fwrite( footprint, 1, len_mask, file ) == len_mask &&
+            fwrite( footprint_edges, 1, len_mask, file ) == len_mask &&
+            fwrite( &n_edges, 4, 1, file ) == 1;
+
+        for ( auto& [index, value] : masked_edge_values ) {
+            written = written &&
+                fwrite( &index, 4, 1, file ) == 1 &&
+                fwrite( &value, 4, 1, file ) == 1;
+        }
+    }
+
+    if ( building_ids != NULL ) {
+        uint32_t n_names = building_names.size();
+
+        written = written &&
+            fwrite( building_ids, sizeof(uint16_t), len, file ) == len &&
+            fwrite( &n_names, 4, 1, file ) == 1;
+
+        for ( std::string& name : building_names ) {
+            uint32_t name_len = name.size();
+            written = written &&
+                fwrite( &name_len, 4, 1, file ) == 1 &&
+                fwrite( name.data(), 1, name_len, file ) == name_len;
+        }
+    }
+
+    if ( fclose(file) != 0 || !written || rename(tmp_file_path.data(), file_path.data()) != 0 ) {
+        remove( tmp_file_path.data() );
+        return FILE_NOT_CREATABLE;
+    }
+
+    return SUCCESS;
+} /* createResampledFile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::fromResampledFile ( std::string file_path, uint64_t source_signature ) {
+    int fd = open( file_path.data(), O_RDONLY );
+    if ( fd < 0 ) {
+        return FILE_NOT_FOUND;
+    }
+
+    struct stat file_stat;
+    if ( fstat(fd, &file_stat) != 0 || file_stat.st_size < RESAMPLED_FILE_HEADER_SIZE ) {
+        close( fd );
+        return FILE_CORRUPT;
+    }
+    size_t file_size = file_stat.st_size;
+
+    void* mapping = mmap( NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( mapping == MAP_FAILED ) {
+        return FILE_CORRUPT;
+    }
+
+    std::shared_ptr<uint8_t> file_mapping(
+        (uint8_t*) mapping,
+        [file_size] ( uint8_t* mapping ) { munmap( mapping, file_size ); }
+    );
+
+    uint64_t file_signature;
+    memcpy( &file_signature, file_mapping.get()+8, 8 );
+
+    if ( file_signature != source_signature && STRNEQUAL((char*)file_mapping.get(), "RTIL", 4) ) {
+        return FILE_OUTDATED;
+    }
+
+    return fromResampledData( file_mapping, file_mapping.get(), file_size );
+} /* fromResampledFile() */
+
+/*---------------------------------------------------------------*/
+
+int GridTile::fromResampledData ( std::shared_ptr<uint8_t> mapping, uint8_t* data, size_t file_size ) {
+    if ( file_size < RESAMPLED_FILE_HEADER_SIZE ) {
+        return FILE_CORRUPT;
+    }
+
+    uint32_t version, file_width, origin_x, origin_y, flags;
+
+    memcpy( &version, data+4, 4 );
+    memcpy( &file_width, data+16, 4 );
+    memcpy( &origin_x, data+20, 4 );
+    memcpy( &origin_y, data+24, 4 );
+    memcpy( &flags, data+28, 4 );
+
+    if ( !STRNEQUAL((char*)data, "RTIL", 4) || version != RESAMPLED_FILE_VERSION ) {
+        return FILE_CORRUPT;
+    }
+
+    // Check the sections before changing the tile
+    size_t
+        len = (size_t)file_width * file_width,
+        len_mask = ( len + 7 ) / 8,
+        heights_offset = RESAMPLED_FILE_HEADER_SIZE,
+        footprint_offset = heights_offset + len * sizeof(float),
+        building_offset = footprint_offset;
+
+    if ( footprint_offset > file_size ) {
+        return FILE_CORRUPT;
+    }
+
+    uint32_t n_edges = 0;
+    if ( flags & 1 ) {
+        if ( footprint_offset + 2*len_mask + 4 > file_size ) {
+            return FILE_CORRUPT;
+        }
+        memcpy( &n_edges, data + footprint_offset + 2*len_mask, 4 );
+
+        building_offset = footprint_offset + 2*len_mask + 4 + (size_t)n_edges * 8;
+        if ( building_offset > file_size ) {
+            return FILE_CORRUPT;
+        }
+    }
+
+    std::vector<std::string> file_building_names;
+    if ( flags & 2 ) {
+        size_t offset = building_offset + len * sizeof(uint16_t);
+        if ( offset + 4 > file_size ) {
+            return FILE_CORRUPT;
+        }
+
+        uint32_t n_names;
+        memcpy( &n_names, data + offset, 4 );
+        offset += 4;
+
+        for ( uint32_t i = 0; i < n_names; i++ ) {
+            uint32_t name_len;
+            if ( offset + 4 > file_size ) {
+                return FILE_CORRUPT;
+            }
+            memcpy( &name_len, data + offset, 4 );
+            offset += 4;
+
+            if ( offset + name_len > file_size ) {
+                return FILE_CORRUPT;
+            }
+            file_building_names.push_back( std::string((char*)data + offset, name_len) );
+            offset += name_len;
+        }
+    }
+
+    // Replace the data of the tile
+    if ( tile_memalloc ) {
+        freeTileBuffer( tile );
+    }
+    if ( tile_quantised != NULL ) {
+        freeTileBuffer( tile_quantised );
+        tile_quantised = NULL;
+    }
+    compressed_blocks.clear();
+    block_offsets.clear();
+    compressed_id = 0;
+
+    width = file_width;
+    layout = ROW_MAJOR;
+    tile_name = std::string( (char*)data+32, strnlen((char*)data+32, RESAMPLED_FILE_HEADER_SIZE-33) );
+    tile_origin.setX( (double) origin_x );
+    tile_origin.setY( (double) origin_y );
+
+    lazy_geotiff.reset();
+    tile_mapping = mapping;
+    tile = (float*)( data + heights_offset );
+    tile_memalloc = false;
+
+    if ( flags & 1 ) {
+        enableFootprint();
+        memcpy( footprint, data + footprint_offset, len_mask );
+        memcpy( footprint_edges, data + footprint_offset + len_mask, len_mask );
+
+        size_t offset = footprint_offset + 2*len_mask + 4;
+        for ( uint32_t i = 0; i < n_edges; i++ ) {
+            uint32_t index;
+            float value;
+            memcpy( &index, data + offset, 4 );
+            memcpy( &value, data + offset + 4, 4 );
+            masked_edge_values[index] = value;
+            offset += 8;
+        }
+    }
+
+    if ( flags & 2 ) {
+        enableBuildingIds();
+        memcpy( building_ids, data + building_offset, len * sizeof(uint16_t) );
+        building_names = file_building_names;
+    }
+
+    return SUCCESS;
+} /* fromResampledData() */
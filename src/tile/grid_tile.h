@@ -9,6 +9,30 @@
 #include "../shared.h"
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+// Height of masked cells (buildings) in the DOM_MASKED layer
+#define MASKED_VALUE -9999.0
+
+// Heights at or below this value mark cells without data (e.g. -9999 or
+// -3.4e38 in the GeoTIFF files) (See GridTile::quantiseTile)
+#define NODATA_THRESHOLD -9000.0
+
+// Quantisation level of the cells without data (See GridTile::quantiseTile)
+#define QUANTISED_NODATA UINT16_MAX
+
+// Width and height of the blocks of a compressed tile
+#define TILE_BLOCK_WIDTH 64
+
+// Size of the header of a resampled tile file (See GridTile::createResampledFile)
+#define RESAMPLED_FILE_HEADER_SIZE 64
+
+// Version of the resampled tile files (Increase it whenever the format or
+// the resampled heights change, older files are then recreated)
+#define RESAMPLED_FILE_VERSION 2
 
 enum DownsamplingMethods {
     AVG,
@@ -16,6 +40,110 @@ enum DownsamplingMethods {
     MAX
 };
 
+// Memory layouts of the cells of a grid tile (See GridTile::setLayout)
+enum TileLayouts {
+    ROW_MAJOR,  // Row by row
+    BLOCKED,    // Blocks of LAYOUT_BLOCK_WIDTH x LAYOUT_BLOCK_WIDTH cells, row by row within a block
+    MORTON      // Blocks of LAYOUT_BLOCK_WIDTH x LAYOUT_BLOCK_WIDTH cells, Morton order within a block
+};
+
+// Width and height of the blocks of the BLOCKED and MORTON layout
+// (Power of 2, see LAYOUT_BLOCK_BITS)
+#define LAYOUT_BLOCK_WIDTH 32
+#define LAYOUT_BLOCK_BITS 5
+
+/*
+Interleave the lower 16 bits of v with zeros (Morton order)
+*/
+inline uint spreadBits ( uint v ) {
+    v &= 0xFFFF;
+    v = ( v | (v << 8) ) & 0x00FF00FF;
+    v = ( v | (v << 4) ) & 0x0F0F0F0F;
+    v = ( v | (v << 2) ) & 0x33333333;
+    v = ( v | (v << 1) ) & 0x55555555;
+    return v;
+}
+
+/*
+Return the index of the cell (x,y) in the array of a tile
+
+Args:
+ - layout : Layout of the tile (See enum TileLayouts)
+ - width  : Width of the tile
+ - x      : x coordinate
+ - y      : y coordinate
+*/
+inline uint layoutIndex ( int layout, uint width, uint x, uint y ) {
+    if ( layout == ROW_MAJOR ) {
+        return y*width+x;
+    }
+
+    uint
+        blocks_per_row = ( width + LAYOUT_BLOCK_WIDTH - 1 ) >> LAYOUT_BLOCK_BITS,
+        block = ( y >> LAYOUT_BLOCK_BITS ) * blocks_per_row + ( x >> LAYOUT_BLOCK_BITS ),
+        x_in_block = x & ( LAYOUT_BLOCK_WIDTH - 1 ),
+        y_in_block = y & ( LAYOUT_BLOCK_WIDTH - 1 );
+
+    if ( layout == MORTON ) {
+        return ( block << (2*LAYOUT_BLOCK_BITS) ) | spreadBits( x_in_block ) | ( spreadBits(y_in_block) << 1 );
+    }
+    return ( block << (2*LAYOUT_BLOCK_BITS) ) | ( y_in_block << LAYOUT_BLOCK_BITS ) | x_in_block;
+}
+
+/*
+Return the number of cells of the array of a tile
+(The BLOCKED and MORTON layout pad the tile to full blocks)
+*/
+inline uint layoutLength ( int layout, uint width ) {
+    if ( layout == ROW_MAJOR ) {
+        return width*width;
+    }
+
+    uint padded_width = ( ( width + LAYOUT_BLOCK_WIDTH - 1 ) >> LAYOUT_BLOCK_BITS ) << LAYOUT_BLOCK_BITS;
+    return padded_width*padded_width;
+}
+
+class GridTile;
+
+/*
+Rows of a tile resampled by one thread (See GridTile::resampleTile)
+*/
+struct Resample_Thread_Data {
+    GridTile* grid_tile;
+
+    // New heights (See layoutIndex)
+    float* new_tile;
+    int new_width;
+
+    bool downsampling;
+    int downsampling_method;
+
+    // Downsampling: old cells block_start[i]...block_end[i]-1 form new cell i
+    // Upsampling: old cell i becomes new cells block_start[i]...block_end[i]-1
+    // (The same borders are used for both axes)
+    const std::vector<int>* block_start;
+    const std::vector<int>* block_end;
+
+    // Rows of the new tile (downsampling) or of the old tile (upsampling)
+    int first_row, end_row;
+};
+
+/*
+Polygons of a LOD2 tile rasterised into the footprint mask of a tile by
+one task (See GridTile::maskTiles)
+*/
+struct Mask_Thread_Data {
+    GridTile* grid_tile;
+
+    std::vector<Polygon>* polygons;
+
+    // Local building ID of every polygon (0 if the building IDs are not recorded)
+    const std::vector<uint16_t>* polygon_building_ids;
+
+    // Polygons start...end-1
+    uint start, end;
+};
+
 /*
 Class to represent a tile (e.g. from a GeoTIFF file)
 */
@@ -29,6 +157,12 @@ public:
     // Copy constructor
     GridTile ( const GridTile& old_gridtile );
 
+    // Move constructor (takes over the buffers of the old tile)
+    GridTile ( GridTile&& old_gridtile );
+
+    // Move assignment (takes over the buffers of the old tile)
+    GridTile& operator= ( GridTile&& old_gridtile );
+
     /*
     Create an empty grid tile
 
@@ -37,6 +171,16 @@ public:
     */
     void emptyGridTileWithWidth ( uint width );
 
+    /*
+    Create a tile without heights that only receives a footprint mask
+    (e.g. to mask a tile without loading its DOM20 file, See maskTiles)
+
+    Args:
+    - width  : Width and height of the grid
+    - origin : UTM coordinates of the lower left corner of the tile
+    */
+    void footprintTileWithWidth ( uint width, Vector origin );
+
     /*
     Create a grid from float values (read from a GeoTIFF file)
 
@@ -45,6 +189,23 @@ public:
     */
     void fromGeoTiffFile ( GeoTiffFile& geotiff );
 
+    /*
+    Create a grid whose heights are decoded from a GeoTIFF file opened with
+    GeoTiffFile::openGeoTiffFile the first time a cell of a block of the
+    file is read
+    Operations on the whole tile (resampling, layouts, quantisation,
+    compression, writing files) decode the remaining blocks first
+
+    Args:
+     - geotiff : GeoTiffFile object opened with openGeoTiffFile
+    */
+    void fromLazyGeoTiffFile ( std::shared_ptr<GeoTiffFile> geotiff );
+
+    /*
+    Return whether the heights are decoded on demand (See fromLazyGeoTiffFile)
+    */
+    bool isLazy () const;
+
     /* DESTRUCTOR */
     ~GridTile ();
 
@@ -52,6 +213,7 @@ public:
     Upsample or downsample a tile
     Reduce a block of pixels into one (downsampling) or turn one pixel
     into a block of pixels (upsampling) using lienar interpolation
+    The rows of the tile are resampled in parallel (MAX_THREADS threads)
 
     Args:
      - factor :              Factor by which the tile should be rescaled
@@ -69,6 +231,7 @@ public:
         - SUCCESS
 
         - INVALID_RESAMPLING_FACTOR
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
     */
     int resampleTile ( float factor, int downsampling_method = MAX );
 
@@ -88,14 +251,44 @@ public:
         - SUCCESS
 
         - COORDINATES_OUTSIDE_TILE
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
     */
     int getValue ( uint x, uint y, float& value ) const;
 
+    /*
+    Return the signed distance between a height and the value in the
+    position (x,y) of the grid (zero or negative if the height is at or
+    below the surface)
+    For a quantised tile the height is converted into the quantised domain
+    once and compared with the stored value without decoding it
+
+    Args:
+     - x         : x coordinate
+     - y         : y coordinate
+     - height    : Height in meters
+     - clearance : Reference to the double variable to store the distance in
+     - masked    : Use the value of the DOM_MASKED layer (See getMaskedValue)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - COORDINATES_OUTSIDE_TILE
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int getClearance ( uint x, uint y, double height, double& clearance, bool masked = false ) const;
+
     /*
     Return the width of the tile
     */
     uint getTileWidth () const;
 
+    /*
+    Return the memory occupied by the data of the tile in bytes
+    (heights, footprint mask and building IDs)
+    */
+    size_t getMemorySize () const;
+
     /*
     Return the name of the tile
 
@@ -108,7 +301,9 @@ public:
     Return the pointer to the tile data
 
     Returns:
-     - Pointer to the array 'tile'
+     - Pointer to the array 'tile' in the layout of the tile
+       (NULL if the tile is quantised or compressed or if a block of a
+       lazy tile can't be decoded)
     */
     float* getData () const;
 
@@ -125,6 +320,7 @@ public:
         - SUCCESS
 
         - COORDINATES_OUTSIDE_TILE
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
     */
     int setValue ( uint x, uint y, float value );
 
@@ -134,16 +330,213 @@ public:
     Vector getOrigin() const;
 
 
+    /* LAYOUT */
+
+    /*
+    Rearrange the cells of the tile in memory
+    In the BLOCKED and MORTON layout neighbouring cells in all directions
+    are close to each other in memory, so the cache misses of a ray
+    no longer depend on its azimuth
+
+    Args:
+     - layout : New layout (See enum TileLayouts)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_LAYOUT
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int setLayout ( int layout );
+
+    /*
+    Return the layout of the tile (See enum TileLayouts)
+    */
+    int getLayout () const;
+
+
+    /* QUANTISATION */
+
+    /*
+    Store the heights as unsigned 16 bit integers relative to the lowest
+    height of the tile, which halves the memory of the tile
+    The step is increased if the range of heights of the tile does not fit
+    into 16 bits with the given step
+    Cells without data (See NODATA_THRESHOLD) are stored as
+    QUANTISED_NODATA and don't count towards the range of heights
+
+    Args:
+     - step : Height difference in meters between two quantisation levels
+              (e.g. 0.01 -> centimetres)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_QUANTISATION_STEP
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int quantiseTile ( double step );
+
+    /*
+    Restore the 32 bit float heights of a quantised tile
+    */
+    void dequantiseTile ();
+
+    /*
+    Return whether the heights are stored as 16 bit integers
+    */
+    bool isQuantised () const;
+
+
+    /* COMPRESSION */
+
+    /*
+    Split the tile into blocks and compress every block losslessly
+    (See block_codec.h)
+    The blocks are decoded on access and kept in a cache of decoded blocks
+    per worker thread (See BLOCK_CACHE_SIZE and WORKER_POOL), so only the
+    blocks touched by the rays occupy uncompressed memory
+    Works on float and on quantised tiles
+
+    Args:
+     - block_width : Width and height of the blocks (Default: TILE_BLOCK_WIDTH)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - INVALID_BLOCK_WIDTH
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int compressTile ( uint block_width = TILE_BLOCK_WIDTH );
+
+    /*
+    Restore the uncompressed heights of a compressed tile
+    */
+    void decompressTile ();
+
+    /*
+    Return whether the heights are stored in compressed blocks
+    */
+    bool isCompressed () const;
+
+
     /*
     Mask DOM20 tile with LOD2 building model to remove buildings
     (infrastructure) from the DOM20 surface model
 
+    The heights of the tile are not changed. Instead, every cell covered
+    by a GROUND polygon is marked in the footprint mask (1 bit per cell)
+    and the masked height is resolved by getMaskedValue
+
     Args:
      - vector_tile : Reference to the LOD2 tile object which is in
                      the same region as the DOM20 tile
-     - n_threads   : Number of threads to execute simultaneously
+     - n_parts     : Number of parts the polygons are split into
+                     (tasks of the worker pool, See maskTiles)
     */
-    void maskTile ( VectorTile& vector_tile, int n_threads = MAX_THREADS );
+    void maskTile ( VectorTile& vector_tile, int n_parts = MAX_THREADS );
+
+    /*
+    Mask several DOM20 tiles with one LOD2 tile (See maskTile)
+
+    The polygons are rasterised into all tiles at once on the shared
+    worker pool (WORKER_POOL). Every call has its own context, so tiles
+    can be masked by several threads at the same time.
+
+    Args:
+     - grid_tiles  : Pointers to the DOM20 tiles in the region of the
+                     LOD2 tile (e.g. the 4 tiles under a 2 km LOD2 tile)
+     - vector_tile : Reference to the LOD2 tile object
+     - n_parts     : Number of parts the polygons are split into per tile
+                     (Number of worker threads if < 1)
+    */
+    static void maskTiles (
+        std::vector<GridTile*> grid_tiles,
+        VectorTile& vector_tile,
+        int n_parts = MAX_THREADS
+    );
+
+
+    /* BUILDING FOOTPRINT */
+
+    /*
+    Allocate an empty footprint mask
+    */
+    void enableFootprint ();
+
+    /*
+    Return whether the tile has a footprint mask
+    */
+    bool hasFootprint () const;
+
+    /*
+    Take over the footprint mask and the building IDs of another tile of
+    the same grid (e.g. to add the DOM_MASKED layer to a loaded DOM tile)
+    The mask is converted into the layout of the tile, the heights of
+    the tile are not changed
+
+    Args:
+     - masked_tile : Tile with the footprint mask (loses its mask and
+                     building IDs)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_SIZES_UNEQUAL (or the masked tile has no footprint mask)
+    */
+    int takeFootprint ( GridTile& masked_tile );
+
+    /*
+    Return the value of the DOM_MASKED layer in the position (x,y) of the grid
+    (MASKED_VALUE where a building stands, the DOM value elsewhere)
+
+    Args:
+     - x     : x coordinate
+     - y     : y coordinate
+     - value : Reference to the float variable to store the value in
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - COORDINATES_OUTSIDE_TILE
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int getMaskedValue ( uint x, uint y, float& value ) const;
+
+    /*
+    Write the footprint mask to a binary file
+
+    Args:
+     - file_path : Path of the binary file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_CREATABLE
+    */
+    int createFootprintFile ( std::string file_path );
+
+    /*
+    Read the footprint mask from a binary file created by createFootprintFile
+
+    Args:
+     - file_path : Path of the binary file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+        - TILE_SIZES_UNEQUAL
+    */
+    int fromFootprintFile ( std::string file_path );
 
 
     /*
@@ -157,20 +550,317 @@ public:
         - SUCCESS
 
         - FILE_NOT_CREATABLE
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
     */
     int createTifFile ( std::string file_path );
 
 
+    /* BUILDING IDS */
+
+    /*
+    Allocate the building ID raster (one ID per cell, 0 = no building)
+    maskTile writes the index of the masking GROUND polygon into this
+    raster if it has been allocated before
+    */
+    void enableBuildingIds ();
+
+    /*
+    Return whether the tile has a building ID raster
+    */
+    bool hasBuildingIds () const;
+
+    /*
+    Return the local building ID in the position (x,y) of the grid
+    (0 = no building, otherwise index + 1 in the list of building names)
+    */
+    uint16_t getLocalBuildingId ( uint x, uint y ) const;
+
+    /*
+    Return the run-wide building ID in the position (x,y) of the grid
+    using the table set by setGlobalBuildingIds (0 = no building)
+    */
+    uint32_t getBuildingId ( uint x, uint y ) const;
+
+    /*
+    Return the list of building (GROUND polygon) names of the tile
+    */
+    std::vector<std::string>& getBuildingNames ();
+
+    /*
+    Set the table mapping the local building IDs of the tile to
+    run-wide building IDs (index 0 must map to 0)
+    */
+    void setGlobalBuildingIds ( std::vector<uint32_t>& global_ids );
+
+    /*
+    Write the building ID raster and the building names to a binary file
+
+    Args:
+     - file_path : Path of the binary file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_CREATABLE
+    */
+    int createBuildingIdFile ( std::string file_path );
+
+    /*
+    Read the building ID raster and the building names from a binary file
+    created by createBuildingIdFile
+
+    Args:
+     - file_path : Path of the binary file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+        - TILE_SIZES_UNEQUAL
+    */
+    int fromBuildingIdFile ( std::string file_path );
+
+    /*
+    Write the tile with its footprint mask and building IDs to a resampled
+    tile file that can be mapped into memory by fromResampledFile
+    The tile must be in the ROW_MAJOR layout and must be neither quantised
+    nor compressed
+
+    File layout:
+     - Header (RESAMPLED_FILE_HEADER_SIZE bytes):
+       "RTIL" + version (uint32) + source signature (uint64)
+       + width, origin x, origin y, flags (uint32) + tile name (zero-terminated)
+       (flags: bit 0 = footprint mask, bit 1 = building IDs)
+     - Heights (float, row-major)
+     - Footprint mask: footprint bits, edge bits, number of edge values (uint32)
+       + (cell index (uint32), masked value (float)) pairs
+     - Building IDs: IDs (uint16, row-major), number of names (uint32)
+       + (length (uint32), name) pairs
+
+    Args:
+     - file_path        : Path of the resampled tile file
+     - source_signature : Signature of the source files of the tile
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_CREATABLE
+        - INVALID_LAYOUT
+        - FILE_CORRUPT (Lazy tile with an undecodable block)
+    */
+    int createResampledFile ( std::string file_path, uint64_t source_signature );
+
+    /*
+    Map a resampled tile file created by createResampledFile into memory
+    The heights are used directly from the mapping (no copy) until the
+    tile is modified; copies of the tile share the mapping
+
+    Args:
+     - file_path        : Path of the resampled tile file
+     - source_signature : Signature of the source files of the tile
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+        - FILE_OUTDATED
+    */
+    int fromResampledFile ( std::string file_path, uint64_t source_signature );
+
+    /*
+    Initialize the tile from the content of a resampled tile file in
+    memory (See createResampledFile)
+    The heights are used directly from the memory (no copy) until the
+    tile is modified
+
+    Args:
+     - mapping : Owner of the memory (kept alive by the tile and its copies)
+     - data    : Pointer to the content of the file within the memory
+     - size    : Size of the content in bytes
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int fromResampledData ( std::shared_ptr<uint8_t> mapping, uint8_t* data, size_t size );
+
+
 private:
-    float* tile;
+    float* tile = NULL;
     bool tile_memalloc = false;
 
+    // Mapping of a resampled tile file the heights point into
+    // (See fromResampledFile)
+    std::shared_ptr<uint8_t> tile_mapping;
+
+    /*
+    Copy the heights out of the mapping of a resampled tile file
+    before they are modified
+    */
+    void detachMapping ();
+
+    // GeoTIFF file the heights are decoded from on demand
+    // (tile points into its data, See fromLazyGeoTiffFile)
+    std::shared_ptr<GeoTiffFile> lazy_geotiff;
+
+    /*
+    Decode the remaining blocks of a lazy tile and take over the heights
+    (The tile stays lazy if a block can't be decoded)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int decodeLazyTile ();
+
+    /*
+    Free all buffers of the tile (heights, footprint mask and building IDs)
+    */
+    void freeBuffers ();
+
+    // Quantised heights (See quantiseTile)
+    // height = quantisation_offset + tile_quantised[i] * quantisation_step
+    // (quantisation_nodata for the level QUANTISED_NODATA)
+    uint16_t* tile_quantised = NULL;
+    double quantisation_offset = 0.0, quantisation_step = 1.0;
+    float quantisation_nodata = MASKED_VALUE;
+
+    // Compressed blocks (See compressTile)
+    // Block i is stored in compressed_blocks[block_offsets[i]...block_offsets[i+1]]
+    std::vector<uint8_t> compressed_blocks;
+    std::vector<uint32_t> block_offsets;
+    uint block_width = 0, blocks_per_row = 0;
+    bool compressed_quantised = false;
+
+    // Identifies the compressed data in the caches of decoded blocks
+    // (Copies of a tile share the ID)
+    uint64_t compressed_id = 0;
+
+    /*
+    Return the height of the cell (x,y) of the grid
+    (The block of the cell must be decoded in a lazy tile, See decodeCell)
+    */
+    inline float valueAt ( uint x, uint y ) const {
+        if ( tile_quantised != NULL ) {
+            return quantisedHeight( tile_quantised[cellIndex(x, y)] );
+        }
+        if ( compressed_id != 0 ) {
+            return compressedValueAt( x, y );
+        }
+        return tile[cellIndex(x, y)];
+    }
+
+    /*
+    Decode the block containing the cell (x,y) of a lazy tile
+    (No effect for other tiles)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT (The cell must not be read)
+    */
+    int decodeCell ( uint x, uint y ) const;
+
+    /*
+    Return the height of a quantisation level (See quantiseTile)
+    */
+    inline float quantisedHeight ( uint32_t level ) const {
+        if ( level == QUANTISED_NODATA ) {
+            return quantisation_nodata;
+        }
+        return quantisation_offset + level * quantisation_step;
+    }
+
+    /*
+    Return the quantisation level of a height (See quantiseTile)
+    */
+    uint16_t quantisationLevel ( float height ) const;
+
+    /*
+    Return the height in the position (x,y) of a compressed tile
+    */
+    float compressedValueAt ( uint x, uint y ) const;
+
+    /*
+    Decode a block of a compressed tile into an array of heights
+
+    Args:
+     - block  : Index of the block
+     - values : Array with space for block_width*block_width heights
+                (row stride: block_width)
+    */
+    void decodeTileBlock ( uint block, float* values ) const;
+
     uint width;
 
     std::string tile_name;
 
     Vector tile_origin;
 
+    // Memory layout of the heights and the footprint mask
+    int layout = ROW_MAJOR;
+
+    /*
+    Return the index of the cell (x,y) in the arrays of the tile
+    */
+    inline uint cellIndex ( uint x, uint y ) const {
+        return layoutIndex( layout, width, x, y );
+    }
+
+    /*
+    Return the number of cells of the arrays of the tile
+    */
+    inline uint cellCount () const {
+        return layoutLength( layout, width );
+    }
+
+    // Footprint mask (1 bit per cell (See cellIndex), set where a building stands)
+    uint8_t* footprint = NULL;
+
+    // Cells only partially covered by buildings after downsampling
+    // (1 bit per cell) and their masked values
+    uint8_t* footprint_edges = NULL;
+    std::unordered_map<uint32_t, float> masked_edge_values;
+
+    /*
+    Set the footprint bit of a cell (thread-safe)
+    */
+    void setFootprintBit ( uint x, uint y );
+
+    /*
+    Set the footprint bits of the cells x_start...x_end-1 of row y
+    (thread-safe, whole bytes are set at once in the ROW_MAJOR layout)
+    */
+    void setFootprintSpan ( uint x_start, uint x_end, uint y );
+
+    /*
+    Resample the footprint mask along with the tile and calculate the masked
+    values of the cells only partially covered by buildings
+    */
+    void resampleFootprint ( float factor, int new_width, int downsampling_method );
+
+    // Building ID raster (See maskTile)
+    uint16_t* building_ids = NULL;
+    std::vector<std::string> building_names;
+    std::vector<uint32_t> global_building_ids;
+
+    /*
+    Resample the building ID raster along with the tile
+    (Downsampling: first building in the block, upsampling: nearest cell)
+    */
+    void resampleBuildingIds ( float factor, int new_width );
+
     /*
     Accumulate a block of pixels for downsampling using
     the specified downsampling method
@@ -189,6 +879,7 @@ private:
                               - MAX : Maximum value within the block
                               (Default: MAX)
                               -> See enum DownsamplingMethods
+     - masked              : Use MASKED_VALUE for cells in the footprint mask
 
     Returns:
      - Downsampled pixel block as a float value
@@ -196,8 +887,37 @@ private:
     float block_accumulate (
         int x_start, int y_start,
         int x_end, int y_end,
-        int downsampling_method
+        int downsampling_method,
+        bool masked = false
     );
+
+    /*
+    Return a row of the heights as a contiguous array
+
+    Args:
+     - y      : Row
+     - buffer : Array with space for width heights (used unless the
+                tile is in the ROW_MAJOR layout)
+    */
+    const float* tileRow ( uint y, float* buffer ) const;
+
+    /*
+    Downsample the rows data.first_row...data.end_row-1 of the new tile
+    (See resampleTile)
+    */
+    void downsampleRows ( Resample_Thread_Data& data );
+
+    /*
+    Upsample the rows data.first_row...data.end_row-1 of the old tile
+    (See resampleTile)
+    */
+    void upsampleRows ( Resample_Thread_Data& data );
+
+    friend void* Thread_maskTile ( void* arg );
+    friend void* Thread_resampleTile ( void* arg );
 };
 
+void* Thread_maskTile ( void* arg );
+void* Thread_resampleTile ( void* arg );
+
 #endif
@@ -10,15 +10,314 @@
 
 #include <unistd.h>
 #include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <pthread.h>
+#include <sys/stat.h>
 
 /*---------------------------------------------------------------*/
 
-int getGridTile ( GridTile& grid_tile, std::string tile_name, int tile_type ) {
+// Signatures of source files not read from the data directory
+// (See setSourceFileSignature)
+static std::unordered_map<std::string, uint64_t> source_signatures;
+static pthread_mutex_t source_signatures_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void setSourceFileSignature ( std::string file_path, uint64_t signature ) {
+    pthread_mutex_lock( &source_signatures_mutex );
+    source_signatures[file_path] = signature;
+    pthread_mutex_unlock( &source_signatures_mutex );
+} /* setSourceFileSignature() */
+
+uint64_t getSourceFileSignature ( std::string file_path ) {
+    pthread_mutex_lock( &source_signatures_mutex );
+    auto recorded = source_signatures.find( file_path );
+    if ( recorded != source_signatures.end() ) {
+        uint64_t signature = recorded->second;
+        pthread_mutex_unlock( &source_signatures_mutex );
+        return signature;
+    }
+    pthread_mutex_unlock( &source_signatures_mutex );
+
+    struct stat file_stat;
+    if ( stat(file_path.data(), &file_stat) != 0 ) {
+        return 0;
+    }
+
+    uint64_t
+        size = file_stat.st_size,
+        mtime = file_stat.st_mtime,
+        signature = HASH_START;
+    signature = hashBytes( signature, &size, 8 );
+    signature = hashBytes( signature, &mtime, 8 );
+
+    return signature;
+} /* getSourceFileSignature() */
+
+/*
+Return a signature of a file downloaded into memory: its size and its
+validators (ETag, Last-Modified), its content if the server sent none
+*/
+static uint64_t downloadSignature ( const std::vector<uint8_t>& data, const Download_Response& response ) {
+    uint64_t
+        size = data.size(),
+        signature = HASH_START;
+    signature = hashBytes( signature, &size, 8 );
+
+    if ( response.etag.empty() && response.last_modified.empty() ) {
+        return hashBytes( signature, data.data(), data.size() );
+    }
+
+    signature = hashBytes( signature, response.etag.data(), response.etag.size() );
+    signature = hashBytes( signature, response.last_modified.data(), response.last_modified.size() );
+
+    return signature;
+} /* downloadSignature() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Read a GeoTIFF file into a GridTile (See getGridTile)
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - TILE_NOT_AVAILABLE
+*/
+static int readRawGridTile (
+    GridTile& grid_tile,
+    std::string raw_file_path,
+    int tile_type,
+    bool lazy
+) {
+    if ( lazy ) {
+        std::shared_ptr<GeoTiffFile> geotiff = std::make_shared<GeoTiffFile>();
+        if ( geotiff->openGeoTiffFile(raw_file_path, tile_type) != SUCCESS ) {
+            return TILE_NOT_AVAILABLE;
+        }
+        grid_tile.fromLazyGeoTiffFile( geotiff );
+
+        return SUCCESS;
+    }
+
+    GeoTiffFile geotiff;
+    if ( geotiff.readGeoTiffFile(raw_file_path, tile_type) != SUCCESS ) {
+        return TILE_NOT_AVAILABLE;
+    }
+    grid_tile.fromGeoTiffFile( geotiff );
+
+    return SUCCESS;
+} /* readRawGridTile() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Download a GeoTIFF file into memory and decode it into a GridTile
+without the detour over the disk (See MEMORY_DOWNLOADS)
+The file is saved in the background if PERSIST_DOWNLOADS is set.
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - TILE_NOT_AVAILABLE
+*/
+static int downloadRawGridTile (
+    GridTile& grid_tile,
+    std::string url,
+    std::string raw_file_path,
+    int tile_type
+) {
+    std::shared_ptr<std::vector<uint8_t>> data;
+    Download_Response response;
+    if ( DOWNLOAD_MANAGER.download(url, data, response) != SUCCESS ) {
+        return TILE_NOT_AVAILABLE;
+    }
+
+    GeoTiffFile geotiff;
+    if ( geotiff.readGeoTiffBuffer(data->data(), data->size(), extractFilename(raw_file_path), tile_type) != SUCCESS ) {
+        return TILE_NOT_AVAILABLE;
+    }
+    grid_tile.fromGeoTiffFile( geotiff );
+
+    // The file may not exist on disk (See ResultCache)
+    setSourceFileSignature( raw_file_path, downloadSignature(*data, response) );
+
+    if ( PERSIST_DOWNLOADS ) {
+        DOWNLOAD_MANAGER.persist( data, raw_file_path );
+    }
+
+    return SUCCESS;
+} /* downloadRawGridTile() */
+
+/*---------------------------------------------------------------*/
+
+// Source files being prepared (downloaded or converted) by a thread
+static std::set<std::string> source_files_in_use;
+static pthread_mutex_t source_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t source_files_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+Wait until no other thread prepares a source file and claim it
+(Several tiles can be loaded in parallel that need the same source file)
+*/
+static void lockSourceFile ( const std::string& file_path ) {
+    pthread_mutex_lock( &source_files_mutex );
+    while ( !source_files_in_use.insert( file_path ).second ) {
+        pthread_cond_wait( &source_files_cond, &source_files_mutex );
+    }
+    pthread_mutex_unlock( &source_files_mutex );
+} /* lockSourceFile() */
+
+/*
+Release a source file claimed with lockSourceFile
+*/
+static void unlockSourceFile ( const std::string& file_path ) {
+    pthread_mutex_lock( &source_files_mutex );
+    source_files_in_use.erase( file_path );
+    pthread_cond_broadcast( &source_files_cond );
+    pthread_mutex_unlock( &source_files_mutex );
+} /* unlockSourceFile() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Paths of the footprint mask and building ID files of a DOM20_MASKED tile
+*/
+static std::string footprintFilePath ( const std::string& tile_name ) {
+    return DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_FOOTPRINT.data";
+} /* footprintFilePath() */
+
+static std::string buildingIdFilePath ( const std::string& tile_name ) {
+    return DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_BUILDINGS.data";
+} /* buildingIdFilePath() */
+
+/*---------------------------------------------------------------*/
+
+int getGridTile ( GridTile& grid_tile, std::string tile_name, int tile_type, bool lazy ) {
+    int status;
+
+    // The masked DOM20 tile is the DOM20 tile with the footprint mask
+    // of the buildings
+    if ( tile_type == DOM20_MASKED ) {
+        status = getGridTile( grid_tile, tile_name, DOM20, lazy );
+        if ( status != SUCCESS ) {
+            return status;
+        }
+
+        std::string
+            footprint_file_path = footprintFilePath( tile_name ),
+            building_id_file_path = buildingIdFilePath( tile_name );
+
+        std::string tile_name_parts [2];
+        splitString( tile_name, tile_name_parts, '_' );
+        uint
+            easting  = std::stoi( tile_name_parts[0] ),
+            northing = std::stoi( tile_name_parts[1] ),
+            lod2_easting  = easting  - (easting  % 2),
+            lod2_northing = northing - (northing % 2);
+
+        // The 4 DOM20 tiles under a LOD2 tile are masked together, so
+        // the threads loading them wait for the one masking them
+        std::string group_path =
+            DATA_DIR + "/DOM20_MASKED/" + buildTileName( lod2_easting, lod2_northing );
+
+        lockSourceFile( group_path );
+
+        bool footprint_loaded =
+            FILE_EXISTS( footprint_file_path.data() ) &&
+            grid_tile.fromFootprintFile( footprint_file_path ) == SUCCESS;
+
+        bool building_ids_loaded =
+            !BUILDING_ATTRIBUTION || (
+                FILE_EXISTS( building_id_file_path.data() ) &&
+                grid_tile.fromBuildingIdFile( building_id_file_path ) == SUCCESS
+            );
+
+        if ( footprint_loaded && building_ids_loaded ) {
+            unlockSourceFile( group_path );
+            return SUCCESS;
+        }
+
+        // Rasterise the buildings of the LOD2 tile
+        VectorTile vector_tile;
+        status = getVectorTile( vector_tile, tile_name );
+        if ( status != SUCCESS ) {
+            unlockSourceFile( group_path );
+            return status;
+        }
+
+        // The other tiles under the LOD2 tile whose files are missing are
+        // masked as well (without loading their DOM20 files)
+        std::vector<GridTile> other_tiles;
+        std::vector<std::string> other_tile_names;
+        other_tiles.reserve( 3 );
+
+        std::vector<GridTile*> grid_tiles = { &grid_tile };
+
+        for ( uint y = lod2_northing; y < lod2_northing + 2; y++ ) {
+            for ( uint x = lod2_easting; x < lod2_easting + 2; x++ ) {
+                if ( x == easting && y == northing ) {
+                    continue;
+                }
+
+                std::string other_tile_name = buildTileName( x, y );
+
+                bool files_exist =
+                    FILE_EXISTS( footprintFilePath(other_tile_name).data() ) && (
+                        !BUILDING_ATTRIBUTION ||
+                        FILE_EXISTS( buildingIdFilePath(other_tile_name).data() )
+                    );
+                if ( files_exist ) {
+                    continue;
+                }
+
+                GridTile& other_tile = other_tiles.emplace_back();
+                other_tile.footprintTileWithWidth(
+                    grid_tile.getTileWidth(), Vector( x * 1000.0, y * 1000.0, 0.0 )
+                );
+                other_tile_names.push_back( other_tile_name );
+            }
+        }
+
+        for ( GridTile& other_tile : other_tiles ) {
+            grid_tiles.push_back( &other_tile );
+        }
+
+        if ( BUILDING_ATTRIBUTION ) {
+            for ( GridTile* tile : grid_tiles ) {
+                tile->enableBuildingIds();
+            }
+        }
+
+        GridTile::maskTiles( grid_tiles, vector_tile );
+
+        grid_tile.createFootprintFile( footprint_file_path );
+        if ( BUILDING_ATTRIBUTION ) {
+            grid_tile.createBuildingIdFile( building_id_file_path );
+        }
+
+        for ( size_t i = 0; i < other_tiles.size(); i++ ) {
+            other_tiles[i].createFootprintFile( footprintFilePath(other_tile_names[i]) );
+            if ( BUILDING_ATTRIBUTION ) {
+                other_tiles[i].createBuildingIdFile( buildingIdFilePath(other_tile_names[i]) );
+            }
+        }
+
+        unlockSourceFile( group_path );
+
+        return SUCCESS;
+    }
+
     // Build the file name/path of the tif file
-    std::string raw_file_name, raw_file_name_masked;
+    std::string raw_file_name;
 
     std::string data_dir = "data";
-    std::string data_dir_masked = "data";
 
     switch ( tile_type ) {
         case DGM1:
@@ -31,123 +330,181 @@ int getGridTile ( GridTile& grid_tile, std::string tile_name, int tile_type ) {
             raw_file_name = "32" + tile_name + "_20_DOM.tif";
             break;
 
-        case DOM20_MASKED:
-            data_dir = DATA_DIR + "/DOM20";
-            data_dir_masked = DATA_DIR + "/DOM20_MASKED";
-            raw_file_name = "32" + tile_name + "_20_DOM.tif";
-            raw_file_name_masked = "32" + tile_name + "_20_DOM_MASKED.tif";
-            break;
+        default:
+            return INVALID_TILE_TYPE;
     }
 
     std::string raw_file_path = data_dir + "/" + raw_file_name;
-    std::string raw_file_path_masked = data_dir_masked + "/" + raw_file_name_masked;
-
-    GeoTiffFile geotiff;
 
-    if ( (tile_type == DGM1 || tile_type == DOM20) && FILE_EXISTS(raw_file_path.data()) ) {
+    if ( FILE_EXISTS(raw_file_path.data()) ) {
 
         // Read the raw tiff file
-        switch ( tile_type ) {
-            case DGM1:
-                geotiff.readGeoTiffFile( raw_file_path, DGM1 );
-                grid_tile.fromGeoTiffFile( geotiff );
-                break;
+        return readRawGridTile( grid_tile, raw_file_path, tile_type, lazy );
+    }
 
-            case DOM20:
-                geotiff.readGeoTiffFile( raw_file_path, DOM20 );
-                grid_tile.fromGeoTiffFile( geotiff );
-                break;
-        }
 
-        return SUCCESS;
+    // Download the raw file
+    std::string url;
+    switch ( tile_type ) {
+        case DGM1:
+            url = CHOSEN_URL_DGM1 + raw_file_name;
+            break;
+
+        case DOM20:
+            url = CHOSEN_URL_DOM20 + raw_file_name;
+            break;
     }
-    else if ( tile_type == DOM20_MASKED && FILE_EXISTS(raw_file_path_masked.data()) ) {
-        geotiff.readGeoTiffFile( raw_file_path_masked, DOM20_MASKED );
-        grid_tile.fromGeoTiffFile( geotiff );
 
-        return SUCCESS;
+    // Fetch only the blocks of the file read by the raytracing
+    // (falls back to downloading the whole file)
+    if ( lazy && REMOTE_GEOTIFF_TILES ) {
+        std::shared_ptr<GeoTiffFile> geotiff = std::make_shared<GeoTiffFile>();
+
+        if ( geotiff->openRemoteGeoTiffFile(url, raw_file_path, tile_type) == SUCCESS ) {
+
+            // The local copy is incomplete until all blocks are fetched,
+            // the file is signed by the server's validator instead
+            size_t size;
+            std::string validator;
+            if ( geotiff->getRemoteValidator(size, validator) && !validator.empty() ) {
+                uint64_t signature = HASH_START;
+                signature = hashBytes( signature, &size, sizeof(size) );
+                signature = hashBytes( signature, validator.data(), validator.size() );
+                setSourceFileSignature( raw_file_path, signature );
+            }
+
+            grid_tile.fromLazyGeoTiffFile( geotiff );
+            return SUCCESS;
+        }
     }
 
-    if ( tile_type == DOM20_MASKED ) {
-        getGridTile( grid_tile, tile_name, DOM20 );
+    if ( MEMORY_DOWNLOADS ) {
+        return downloadRawGridTile( grid_tile, url, raw_file_path, tile_type );
+    }
 
-        VectorTile vector_tile;
-        getVectorTile( vector_tile, tile_name );
+    if ( downloadFile(url, data_dir) == SUCCESS ) {
 
-        std::string dom20_masked_filepath =
-            "data/DOM20_MASKED/32" + tile_name + "_20_DOM_MASKED.tif";
+        // Read the tif file
+        return readRawGridTile( grid_tile, raw_file_path, tile_type, lazy );
+    }
 
-        grid_tile.maskTile( vector_tile );
-        grid_tile.createTifFile( dom20_masked_filepath );
+    return TILE_NOT_AVAILABLE;
+}
 
-        return SUCCESS;
-    }
+/*---------------------------------------------------------------*/
 
+/*
+Return a signature of the source files of a grid tile (0 if a source
+file is missing) (See getSourceFileSignature)
+*/
+static uint64_t sourceSignature ( std::string tile_name, int tile_type, float resample_factor ) {
+    std::vector<std::string> file_paths;
 
-    // Download the raw file
-    std::string url;
     switch ( tile_type ) {
         case DGM1:
-            url = CHOSEN_URL_DGM1 + raw_file_name;
+            file_paths.push_back( DATA_DIR + "/DGM1/" + tile_name + ".tif" );
             break;
 
         case DOM20:
-            url = CHOSEN_URL_DOM20 + raw_file_name;
+            file_paths.push_back( DATA_DIR + "/DOM20/32" + tile_name + "_20_DOM.tif" );
             break;
 
         case DOM20_MASKED:
-            url = CHOSEN_URL_DOM20 + raw_file_name;
+            file_paths.push_back( DATA_DIR + "/DOM20/32" + tile_name + "_20_DOM.tif" );
+            file_paths.push_back( DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_FOOTPRINT.data" );
+            if ( BUILDING_ATTRIBUTION ) {
+                file_paths.push_back( DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_BUILDINGS.data" );
+            }
             break;
     }
 
-    if ( downloadFile(url, data_dir) == SUCCESS ) {
-        GeoTiffFile geotiff;
+    uint64_t signature = HASH_START;
 
-        // Read the tif file
-        switch ( tile_type ) {
-            case DGM1:
-                geotiff.readGeoTiffFile( raw_file_path, DGM1 );
-                grid_tile.fromGeoTiffFile( geotiff );
-                break;
+    for ( std::string& file_path : file_paths ) {
+        uint64_t file_signature = getSourceFileSignature( file_path );
+        if ( file_signature == 0 ) {
+            return 0;
+        }
+        signature = hashBytes( signature, &file_signature, 8 );
+    }
 
-            case DOM20:
-                geotiff.readGeoTiffFile( raw_file_path, DOM20 );
-                grid_tile.fromGeoTiffFile( geotiff );
-                break;
+    uint64_t building_attribution = BUILDING_ATTRIBUTION;
+    signature = hashBytes( signature, &resample_factor, 4 );
+    signature = hashBytes( signature, &building_attribution, 8 );
 
-            case DOM20_MASKED:
-                geotiff.readGeoTiffFile( raw_file_path, DOM20 );
-                grid_tile.fromGeoTiffFile( geotiff );
+    return signature;
+} /* sourceSignature() */
 
-                VectorTile vector_tile;
-                getVectorTile( vector_tile, tile_name );
+/*---------------------------------------------------------------*/
 
-                grid_tile.maskTile( vector_tile );
-                grid_tile.createTifFile( raw_file_path_masked );
+int getResampledGridTile (
+    GridTile& grid_tile,
+    std::string tile_name,
+    int tile_type,
+    float resample_factor
+) {
+    // Tiles in their source resolution are decoded on demand instead
+    if ( LAZY_GEOTIFF_TILES && resample_factor == 1.0 ) {
+        return getGridTile( grid_tile, tile_name, tile_type, true );
+    }
 
-                break;
+    if ( !RESAMPLED_TILE_CACHE ) {
+        int status = getGridTile( grid_tile, tile_name, tile_type );
+        if ( status != SUCCESS ) {
+            return status;
         }
+        return grid_tile.resampleTile( resample_factor );
+    }
 
-        return SUCCESS;
+    std::string layer;
+    switch ( tile_type ) {
+        case DGM1:         layer = "DGM1";         break;
+        case DOM20:        layer = "DOM20";        break;
+        case DOM20_MASKED: layer = "DOM20_MASKED"; break;
+
+        default:
+            return INVALID_TILE_TYPE;
     }
 
-    return TILE_NOT_AVAILABLE;
-}
+    char resolution [32];
+    snprintf( resolution, sizeof(resolution), "%g", GRID_RESOLUTION );
 
-/*---------------------------------------------------------------*/
+    std::string
+        cache_dir = DATA_DIR + "/RESAMPLED/" + layer + "_" + resolution,
+        cache_file_path = cache_dir + "/" + tile_name + ".tile";
 
-int getVectorTile ( VectorTile& vector_tile, std::string tile_name ) {
+    uint64_t signature = sourceSignature( tile_name, tile_type, resample_factor );
+    if ( signature != 0 && grid_tile.fromResampledFile(cache_file_path, signature) == SUCCESS ) {
+        return SUCCESS;
+    }
 
-    std::string tile_name_parts [2];
-    splitString( tile_name, tile_name_parts, '_' );
-    uint
-        easting  = std::stoi( tile_name_parts[0] ),
-        northing = std::stoi( tile_name_parts[1] );
+    int status = getGridTile( grid_tile, tile_name, tile_type );
+    if ( status != SUCCESS ) {
+        return status;
+    }
+    status = grid_tile.resampleTile( resample_factor );
+    if ( status != SUCCESS ) {
+        return status;
+    }
 
-    easting  = easting  - (easting  % 2);
-    northing = northing - (northing % 2);
+    // The source files may have been downloaded or created just now
+    signature = sourceSignature( tile_name, tile_type, resample_factor );
+    if ( signature != 0 ) {
+        mkdir( (DATA_DIR + "/RESAMPLED").data(), 0777 );
+        mkdir( cache_dir.data(), 0777 );
+        grid_tile.createResampledFile( cache_file_path, signature );
+    }
 
-    tile_name = buildTileName( easting, northing );
+    return SUCCESS;
+} /* getResampledGridTile() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Load a vector tile from its binary file or its Gml file (downloaded
+if necessary) (See getVectorTile)
+*/
+static int readVectorTileFiles ( VectorTile& vector_tile, std::string tile_name ) {
 
     // Build the file name/path of the binary file and the raw file (.gml)
 
@@ -181,6 +538,29 @@ int getVectorTile ( VectorTile& vector_tile, std::string tile_name ) {
     // Download the raw file
     std::string url = CHOSEN_URL_LOD2 + raw_file_name;
 
+    // Parse the Gml file directly from memory
+    if ( MEMORY_DOWNLOADS ) {
+        std::shared_ptr<std::vector<uint8_t>> data;
+        Download_Response response;
+        if ( DOWNLOAD_MANAGER.download(url, data, response) != SUCCESS ) {
+            return TILE_NOT_AVAILABLE;
+        }
+
+        GmlFile gml_file;
+        gml_file.readGmlBuffer( (const char*) data->data(), data->size() );
+
+        setSourceFileSignature( raw_file_path, downloadSignature(*data, response) );
+
+        vector_tile.fromGmlFile( gml_file );
+        vector_tile.createBinaryFile( binary_file_path );
+
+        if ( PERSIST_DOWNLOADS ) {
+            DOWNLOAD_MANAGER.persist( data, raw_file_path );
+        }
+
+        return SUCCESS;
+    }
+
     if ( downloadFile(url, data_dir) == SUCCESS ) {
 
         // Read the gml file and generate a binary file
@@ -194,4 +574,95 @@ int getVectorTile ( VectorTile& vector_tile, std::string tile_name ) {
     }
 
     return TILE_NOT_AVAILABLE;
-}
+} /* readVectorTileFiles() */
+
+/*---------------------------------------------------------------*/
+
+int getVectorTile ( VectorTile& vector_tile, std::string tile_name ) {
+
+    std::string tile_name_parts [2];
+    splitString( tile_name, tile_name_parts, '_' );
+    uint
+        easting  = std::stoi( tile_name_parts[0] ),
+        northing = std::stoi( tile_name_parts[1] );
+
+    easting  = easting  - (easting  % 2);
+    northing = northing - (northing % 2);
+
+    tile_name = buildTileName( easting, northing );
+
+    std::string tile_path = DATA_DIR + "/LOD2/" + tile_name;
+
+    lockSourceFile( tile_path );
+    int status = readVectorTileFiles( vector_tile, tile_name );
+    unlockSourceFile( tile_path );
+
+    return status;
+} /* getVectorTile() */
+
+/*---------------------------------------------------------------*/
+
+int requestTileDownload (
+    std::string tile_name,
+    int tile_type,
+    Download_Callback callback,
+    void* arg
+) {
+    std::string data_dir, url;
+    std::vector<std::string> file_paths;
+
+    switch ( tile_type ) {
+        case DGM1:
+            data_dir = DATA_DIR + "/DGM1";
+            url = CHOSEN_URL_DGM1 + tile_name + ".tif";
+            file_paths.push_back( data_dir + "/" + tile_name + ".tif" );
+            break;
+
+        case DOM20:
+        case DOM20_MASKED:
+            data_dir = DATA_DIR + "/DOM20";
+            url = CHOSEN_URL_DOM20 + "32" + tile_name + "_20_DOM.tif";
+            file_paths.push_back( data_dir + "/32" + tile_name + "_20_DOM.tif" );
+            break;
+
+        // The binary file of the tile replaces the Gml file
+        case LOD2: {
+            std::string tile_name_parts [2];
+            splitString( tile_name, tile_name_parts, '_' );
+            uint
+                easting  = std::stoi( tile_name_parts[0] ),
+                northing = std::stoi( tile_name_parts[1] );
+
+            tile_name = buildTileName( easting - (easting % 2), northing - (northing % 2) );
+
+            data_dir = DATA_DIR + "/LOD2";
+            url = CHOSEN_URL_LOD2 + tile_name + ".gml";
+            file_paths.push_back( data_dir + "/" + tile_name + ".gml" );
+            file_paths.push_back( data_dir + "/" + tile_name + "_LOD2.data" );
+            break;
+        }
+
+        default:
+            return INVALID_TILE_TYPE;
+    }
+
+    // GeoTIFF files may be fetched partly when the tile is loaded
+    if ( tile_type != LOD2 && REMOTE_GEOTIFF_TILES && LAZY_GEOTIFF_TILES ) {
+        return FILE_ALREADY_EXISTS;
+    }
+
+    // The files are downloaded into memory when the tile is loaded
+    if ( MEMORY_DOWNLOADS ) {
+        return FILE_ALREADY_EXISTS;
+    }
+
+    for ( std::string& file_path : file_paths ) {
+        if ( FILE_EXISTS(file_path.data()) ) {
+            return FILE_ALREADY_EXISTS;
+        }
+    }
+
+    DOWNLOAD_MANAGER.request( url, data_dir, callback, arg );
+
+    return SUCCESS;
+} /* requestTileDownload() */
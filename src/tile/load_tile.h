@@ -4,7 +4,10 @@
 #include "grid_tile.h"
 #include "vector_tile.h"
 
+#include "../web/download_manager.h"
+
 #include <string>
+#include <cstdint>
 
 /*
 Create an instance of GridTile from a tif file
@@ -13,18 +16,58 @@ Create an instance of GridTile from a tif file
     1. TIFF file available in data folder?
     2. Download the TIFF file
 
+A DOM20_MASKED tile is the DOM20 tile with the footprint mask of the
+buildings (See GridTile::maskTile). The footprint mask is read from the
+DOM20_MASKED folder or created from the LOD2 tile together with the
+masks of the other DOM20 tiles under the LOD2 tile (See GridTile::maskTiles).
+
 Args:
     - grid_tile : Reference to a GridTile object
     - tile_name : Name of the tile (easting_northing)
-    - tile_type : Tile type (DOM20, DGM1)
+    - tile_type : Tile type (DOM20, DOM20_MASKED, DGM1)
+    - lazy      : Decode the blocks of the TIFF file only when they are
+                  read (See GridTile::fromLazyGeoTiffFile) (Default: false)
 
 Returns:
     - Status code
     - SUCCESS
 
     - TILE_NOT_AVAILABLE
+    - INVALID_TILE_TYPE
 */
-int getGridTile ( GridTile& grid_tile, std::string tile_name, int tile_type );
+int getGridTile ( GridTile& grid_tile, std::string tile_name, int tile_type, bool lazy = false );
+
+/*
+Create an instance of GridTile resampled by a factor (See getGridTile and
+GridTile::resampleTile)
+
+If LAZY_GEOTIFF_TILES is set, tiles that are not resampled (factor 1.0)
+are decoded on demand (See getGridTile).
+
+If RESAMPLED_TILE_CACHE is set, the resampled tile is mapped from the
+resampled tile cache (DATA_DIR/RESAMPLED/<layer>_<resolution>) without
+decoding the TIFF file. The cache file is created on the first use and
+recreated when the source files of the tile change.
+
+Args:
+    - grid_tile       : Reference to a GridTile object
+    - tile_name       : Name of the tile (easting_northing)
+    - tile_type       : Tile type (DOM20, DOM20_MASKED, DGM1)
+    - resample_factor : Factor by which the tile is resampled
+
+Returns:
+    - Status code
+    - SUCCESS
+
+    - TILE_NOT_AVAILABLE
+    - INVALID_TILE_TYPE
+*/
+int getResampledGridTile (
+    GridTile& grid_tile,
+    std::string tile_name,
+    int tile_type,
+    float resample_factor
+);
 
 
 /*
@@ -47,4 +90,53 @@ Returns:
 */
 int getVectorTile ( VectorTile& vector_tile, std::string tile_name );
 
+/*
+Request the download of the raw file of a tile in the background if it
+is not available locally (See DownloadManager)
+The callback is not called if no download is needed.
+
+Args:
+    - tile_name : Name of the tile (easting_northing)
+    - tile_type : Tile type (DOM20, DOM20_MASKED, DGM1, LOD2)
+    - callback  : Function called when the download is finished
+    - arg       : Argument passed to the callback
+
+Returns:
+    - Status code
+    - SUCCESS (the download was requested)
+
+    - FILE_ALREADY_EXISTS
+    - INVALID_TILE_TYPE
+*/
+int requestTileDownload (
+    std::string tile_name,
+    int tile_type,
+    Download_Callback callback,
+    void* arg
+);
+
+/*
+Record the signature of a source file of a tile that was not read from
+the data directory (e.g. downloaded into memory) (See
+getSourceFileSignature)
+
+Args:
+    - file_path : Path of the file in the data directory
+    - signature : Signature of the content of the file (not 0)
+*/
+void setSourceFileSignature ( std::string file_path, uint64_t signature );
+
+/*
+Return a signature of a source file of a tile: the one recorded in this
+run (See setSourceFileSignature) or the size and modification time of
+the file in the data directory
+
+Args:
+    - file_path : Path of the file in the data directory
+
+Returns:
+    - Signature (0 if the file is unknown)
+*/
+uint64_t getSourceFileSignature ( std::string file_path );
+
 #endif
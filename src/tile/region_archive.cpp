@@ -0,0 +1,370 @@
+#include "region_archive.h"
+
+#include "load_tile.h"
+#include "tile_types.h"
+#include "../shared.h"
+#include "../utils.h"
+#include "../status_codes.h"
+
+#include <set>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REGION_ARCHIVE_HEADER_SIZE 12
+
+/*---------------------------------------------------------------*/
+
+/*
+Return the key of a tile in the index of an archive
+*/
+static std::string indexKey ( int layer, uint tile_x, uint tile_y, float resolution ) {
+    char resolution_str [32];
+    snprintf( resolution_str, sizeof(resolution_str), "%g", resolution );
+
+    return std::to_string( layer ) + ":" + buildTileName( tile_x, tile_y ) + ":" + resolution_str;
+} /* indexKey() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Record the signature of an entry (archive file and position of the
+payload) for the source files the tile replaces, so the result cache
+notices a changed archive (See getSourceFileSignature)
+*/
+static void recordEntrySignature ( const struct stat& archive_stat, const Region_Archive_Entry& entry ) {
+    uint64_t values [3] = {
+        (uint64_t) archive_stat.st_size, (uint64_t) archive_stat.st_mtime, entry.offset
+    };
+    uint64_t signature = hashBytes( HASH_START, values, sizeof(values) );
+
+    std::string tile_name = buildTileName( entry.tile_x, entry.tile_y );
+
+    switch ( entry.layer ) {
+        case DGM1:
+            setSourceFileSignature( DATA_DIR + "/DGM1/" + tile_name + ".tif", signature );
+            break;
+
+        case DOM20_MASKED:
+            setSourceFileSignature( DATA_DIR + "/DOM20/32" + tile_name + "_20_DOM.tif", signature );
+            setSourceFileSignature( DATA_DIR + "/DOM20_MASKED/32" + tile_name + "_20_DOM_FOOTPRINT.data", signature );
+            break;
+
+        case LOD2:
+            setSourceFileSignature( DATA_DIR + "/LOD2/" + tile_name + ".gml", signature );
+            break;
+    }
+} /* recordEntrySignature() */
+
+/*---------------------------------------------------------------*/
+
+RegionArchive::~RegionArchive () {
+    close();
+} /* ~RegionArchive() */
+
+/*---------------------------------------------------------------*/
+
+int RegionArchive::open ( std::string file_path ) {
+    close();
+
+    int fd = ::open( file_path.data(), O_RDONLY );
+    if ( fd < 0 ) {
+        return FILE_NOT_FOUND;
+    }
+
+    struct stat file_stat;
+    if ( fstat(fd, &file_stat) != 0 || file_stat.st_size < REGION_ARCHIVE_HEADER_SIZE ) {
+        ::close( fd );
+        return FILE_CORRUPT;
+    }
+    size_t file_size = file_stat.st_size;
+
+    void* file_mapping = mmap( NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( file_mapping == MAP_FAILED ) {
+        return FILE_CORRUPT;
+    }
+
+    std::shared_ptr<uint8_t> new_mapping(
+        (uint8_t*) file_mapping,
+        [file_size] ( uint8_t* file_mapping ) { munmap( file_mapping, file_size ); }
+    );
+    uint8_t* data = new_mapping.get();
+
+    uint32_t version, n_entries;
+    memcpy( &version, data+4, 4 );
+    memcpy( &n_entries, data+8, 4 );
+
+    if (
+        !STRNEQUAL((char*)data, "RARC", 4) ||
+        version != REGION_ARCHIVE_VERSION ||
+        REGION_ARCHIVE_HEADER_SIZE + (size_t)n_entries * sizeof(Region_Archive_Entry) > file_size
+    ) {
+        return FILE_CORRUPT;
+    }
+
+    for ( uint32_t i = 0; i < n_entries; i++ ) {
+        Region_Archive_Entry entry;
+        memcpy(
+            &entry,
+            data + REGION_ARCHIVE_HEADER_SIZE + i*sizeof(Region_Archive_Entry),
+            sizeof(Region_Archive_Entry)
+        );
+
+        if ( entry.offset > file_size || entry.length > file_size - entry.offset ) {
+            index.clear();
+            return FILE_CORRUPT;
+        }
+
+        index[indexKey(entry.layer, entry.tile_x, entry.tile_y, entry.resolution)] = entry;
+    }
+
+    // (Tiles of other resolutions are not read from the archive)
+    for ( auto& [key, entry] : index ) {
+        if ( entry.layer == LOD2 || entry.resolution == (float) GRID_RESOLUTION ) {
+            recordEntrySignature( file_stat, entry );
+        }
+    }
+
+    mapping = new_mapping;
+    size = file_size;
+
+    return SUCCESS;
+} /* open() */
+
+/*---------------------------------------------------------------*/
+
+void RegionArchive::close () {
+    mapping.reset();
+    size = 0;
+    index.clear();
+} /* close() */
+
+/*---------------------------------------------------------------*/
+
+bool RegionArchive::isOpen () const {
+    return mapping != nullptr;
+} /* isOpen() */
+
+/*---------------------------------------------------------------*/
+
+const Region_Archive_Entry* RegionArchive::find ( int layer, uint tile_x, uint tile_y, float resolution ) const {
+    auto it = index.find( indexKey(layer, tile_x, tile_y, resolution) );
+    if ( it == index.end() ) {
+        return NULL;
+    }
+    return &it->second;
+} /* find() */
+
+/*---------------------------------------------------------------*/
+
+int RegionArchive::getGridTile ( GridTile& grid_tile, uint tile_x, uint tile_y, int tile_type, double resolution ) {
+    const Region_Archive_Entry* entry = find( tile_type, tile_x, tile_y, resolution );
+    if ( entry == NULL ) {
+        return TILE_NOT_AVAILABLE;
+    }
+
+    return grid_tile.fromResampledData( mapping, mapping.get() + entry->offset, entry->length );
+} /* getGridTile() */
+
+/*---------------------------------------------------------------*/
+
+int RegionArchive::getVectorTile ( VectorTile& vector_tile, uint tile_x, uint tile_y ) {
+    // LOD2 tiles are 2 km wide
+    const Region_Archive_Entry* entry = find( LOD2, tile_x - tile_x % 2, tile_y - tile_y % 2, 0.0 );
+    if ( entry == NULL ) {
+        return TILE_NOT_AVAILABLE;
+    }
+
+    return vector_tile.fromBinaryData( mapping.get() + entry->offset, entry->length );
+} /* getVectorTile() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Collect the names of the tiles in a directory of DATA_DIR
+
+Args:
+ - dir_name : Name of the directory
+ - prefix   : Start of the file names before the tile name
+ - suffix   : End of the file names after the tile name
+ - names    : Reference to the set to add the tile names to
+*/
+static void findTiles ( std::string dir_name, std::string prefix, std::string suffix, std::set<std::string>& names ) {
+    DIR* dir = opendir( (DATA_DIR + "/" + dir_name).data() );
+    if ( dir == NULL ) {
+        return;
+    }
+
+    struct dirent* dir_entry;
+    while ( (dir_entry = readdir(dir)) != NULL ) {
+        std::string file_name = dir_entry->d_name;
+
+        if (
+            file_name.length() > prefix.length() + suffix.length() &&
+            file_name.starts_with( prefix ) &&
+            file_name.ends_with( suffix )
+        ) {
+            names.insert(
+                file_name.substr( prefix.length(), file_name.length() - prefix.length() - suffix.length() )
+            );
+        }
+    }
+
+    closedir( dir );
+} /* findTiles() */
+
+/*
+Append a file to the archive at the next aligned position
+
+Args:
+ - archive   : Archive file
+ - file_path : Path of the file to append
+ - entry     : Reference to the entry to store the offset and the length in
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - FILE_NOT_FOUND
+    - FILE_NOT_CREATABLE
+*/
+static int appendPayload ( FILE* archive, std::string file_path, Region_Archive_Entry& entry ) {
+    FILE* file = fopen( file_path.data(), "rb" );
+    if ( !file ) {
+        return FILE_NOT_FOUND;
+    }
+
+    long position = ftell( archive );
+    long padding = ( REGION_ARCHIVE_ALIGNMENT - position % REGION_ARCHIVE_ALIGNMENT ) % REGION_ARCHIVE_ALIGNMENT;
+
+    static const uint8_t zeros [REGION_ARCHIVE_ALIGNMENT] = { 0 };
+    bool written = fwrite( zeros, 1, padding, archive ) == (size_t)padding;
+
+    entry.offset = position + padding;
+    entry.length = 0;
+
+    std::vector<uint8_t> buffer( 1 << 20 );
+    size_t n_read;
+    while ( written && (n_read = fread(buffer.data(), 1, buffer.size(), file)) > 0 ) {
+        written = fwrite( buffer.data(), 1, n_read, archive ) == n_read;
+        entry.length += n_read;
+    }
+
+    fclose( file );
+
+    return written ? SUCCESS : FILE_NOT_CREATABLE;
+} /* appendPayload() */
+
+/*---------------------------------------------------------------*/
+
+int buildRegionArchive ( std::string archive_path ) {
+    std::set<std::string> dgm_names, dom_names, lod2_names;
+
+    findTiles( "DGM1", "", ".tif", dgm_names );
+    findTiles( "DOM20", "32", "_20_DOM.tif", dom_names );
+    findTiles( "LOD2", "", "_LOD2.data", lod2_names );
+    findTiles( "LOD2", "", ".gml", lod2_names );
+
+    size_t n_tiles = dgm_names.size() + dom_names.size() + lod2_names.size();
+
+    std::string
+        tmp_archive_path = archive_path + ".tmp",
+        tmp_payload_path = archive_path + ".payload";
+
+    FILE* archive = fopen( tmp_archive_path.data(), "wb" );
+    if ( !archive ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    // Space for the header and the index
+    std::vector<uint8_t> header( REGION_ARCHIVE_HEADER_SIZE + n_tiles * sizeof(Region_Archive_Entry), 0 );
+    bool written = fwrite( header.data(), 1, header.size(), archive ) == header.size();
+
+    std::vector<Region_Archive_Entry> entries;
+
+    struct Layer {
+        int tile_type;
+        std::set<std::string>* names;
+        float resample_factor;
+    };
+    Layer layers [] = {
+        { DGM1,         &dgm_names,  (float)( 1.0 / GRID_RESOLUTION ) },
+        { DOM20_MASKED, &dom_names,  (float)( 0.2 / GRID_RESOLUTION ) },
+        { LOD2,         &lod2_names, 0.0f }
+    };
+
+    size_t n_done = 0;
+
+    for ( Layer& layer : layers ) {
+        for ( const std::string& tile_name : *layer.names ) {
+            updateProgressBar( ++n_done, n_tiles );
+
+            std::string tile_name_parts [2];
+            splitString( tile_name, tile_name_parts, '_' );
+
+            Region_Archive_Entry entry = {};
+            entry.layer = layer.tile_type;
+            entry.tile_x = std::stoi( tile_name_parts[0] );
+            entry.tile_y = std::stoi( tile_name_parts[1] );
+
+            std::string payload_path;
+
+            if ( layer.tile_type == LOD2 ) {
+                VectorTile vector_tile;
+                if ( ::getVectorTile(vector_tile, tile_name) != SUCCESS ) {
+                    continue;
+                }
+                payload_path = DATA_DIR + "/LOD2/" + tile_name + "_LOD2.data";
+            }
+            else {
+                GridTile grid_tile;
+                if (
+                    getResampledGridTile( grid_tile, tile_name, layer.tile_type, layer.resample_factor ) != SUCCESS ||
+                    grid_tile.createResampledFile( tmp_payload_path, 0 ) != SUCCESS
+                ) {
+                    continue;
+                }
+                payload_path = tmp_payload_path;
+                entry.resolution = GRID_RESOLUTION;
+            }
+
+            if ( appendPayload(archive, payload_path, entry) != SUCCESS ) {
+                written = false;
+                break;
+            }
+            entries.push_back( entry );
+        }
+    }
+    printf( "\n" );
+
+    remove( tmp_payload_path.data() );
+
+    // Write the header and the index
+    uint32_t
+        version = REGION_ARCHIVE_VERSION,
+        n_entries = entries.size();
+
+    memcpy( header.data(), "RARC", 4 );
+    memcpy( header.data()+4, &version, 4 );
+    memcpy( header.data()+8, &n_entries, 4 );
+    if ( n_entries > 0 ) {
+        memcpy( header.data() + REGION_ARCHIVE_HEADER_SIZE, entries.data(), n_entries * sizeof(Region_Archive_Entry) );
+    }
+
+    written = written &&
+        fseek( archive, 0, SEEK_SET ) == 0 &&
+        fwrite( header.data(), 1, header.size(), archive ) == header.size();
+
+    if ( fclose(archive) != 0 || !written || rename(tmp_archive_path.data(), archive_path.data()) != 0 ) {
+        remove( tmp_archive_path.data() );
+        return FILE_NOT_CREATABLE;
+    }
+
+    return SUCCESS;
+} /* buildRegionArchive() */
@@ -0,0 +1,142 @@
+#ifndef REGION_ARCHIVE_H
+#define REGION_ARCHIVE_H
+
+#include "grid_tile.h"
+#include "vector_tile.h"
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+
+#define REGION_ARCHIVE_VERSION 1
+
+// Alignment of the payloads in the archive (page size)
+#define REGION_ARCHIVE_ALIGNMENT 4096
+
+/*
+Entry of the index of a region archive
+*/
+struct Region_Archive_Entry {
+    uint32_t layer;         // DGM1, DOM20_MASKED or LOD2 (See tile_types.h)
+    uint32_t tile_x;        // Tile coordinates in km
+    uint32_t tile_y;
+    float resolution;       // Grid resolution in meters (0 for LOD2)
+    uint64_t offset;        // Position of the payload in the archive
+    uint64_t length;        // Length of the payload in bytes
+};
+
+/*
+Single file bundling the tiles of all layers of a region
+
+The archive is mapped into memory once and the tiles are initialized
+directly from the mapping.
+
+File layout:
+ - "RARC" + version, number of entries (uint32)
+ - Index (Region_Archive_Entry per tile)
+ - Payloads (aligned to REGION_ARCHIVE_ALIGNMENT bytes)
+    - DGM1, DOM20_MASKED : Resampled tile file (See GridTile::createResampledFile)
+    - LOD2               : Binary file (See VectorTile::createBinaryFile)
+*/
+class RegionArchive {
+public:
+    ~RegionArchive ();
+
+    /*
+    Map an archive into memory and read the index
+
+    Args:
+     - file_path : Path to the archive
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_CORRUPT
+    */
+    int open ( std::string file_path );
+
+    /*
+    Unmap the archive (tiles initialized from the archive keep their
+    part of the mapping)
+    */
+    void close ();
+
+    /*
+    Return whether an archive is open
+    */
+    bool isOpen () const;
+
+    /*
+    Initialize a grid tile from the archive
+
+    Args:
+     - grid_tile  : Reference to the tile
+     - tile_x     : x coordinate of the tile in km (easting)
+     - tile_y     : y coordinate of the tile in km (northing)
+     - tile_type  : Tile type (DGM1, DOM20_MASKED)
+     - resolution : Grid resolution in meters
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
+        - FILE_CORRUPT
+    */
+    int getGridTile ( GridTile& grid_tile, uint tile_x, uint tile_y, int tile_type, double resolution );
+
+    /*
+    Initialize a vector tile from the archive
+
+    Args:
+     - vector_tile : Reference to the tile
+     - tile_x      : x coordinate of a 1 km tile within the LOD2 tile
+     - tile_y      : y coordinate of a 1 km tile within the LOD2 tile
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - TILE_NOT_AVAILABLE
+        - FILE_CORRUPT
+    */
+    int getVectorTile ( VectorTile& vector_tile, uint tile_x, uint tile_y );
+
+private:
+    std::shared_ptr<uint8_t> mapping;
+    size_t size = 0;
+
+    // Index of the archive (key: "layer:tile_x_tile_y:resolution")
+    std::unordered_map<std::string, Region_Archive_Entry> index;
+
+    /*
+    Find an entry of the index
+
+    Returns:
+     - Pointer to the entry (NULL if the tile is not in the archive)
+    */
+    const Region_Archive_Entry* find ( int layer, uint tile_x, uint tile_y, float resolution ) const;
+};
+
+/*
+Build a region archive from the tiles in DATA_DIR at the current
+GRID_RESOLUTION
+Every DGM1 and DOM20 tile found in DATA_DIR is resampled (DOM20 tiles
+are masked, See getGridTile) and every LOD2 tile is converted into its
+binary file
+
+Args:
+ - archive_path : Path of the archive to create
+
+Returns:
+ - Status code
+    - SUCCESS
+
+    - FILE_NOT_CREATABLE
+*/
+int buildRegionArchive ( std::string archive_path );
+
+#endif
@@ -0,0 +1,344 @@
+#include "tile_allocator.h"
+
+#include "../shared.h"
+#include "../statistics.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#define HUGE_PAGE_SIZE ( 2 * 1024 * 1024 )
+
+// Header in front of every buffer
+// (64 bytes to keep the cells aligned to cache lines)
+struct Tile_Buffer_Header {
+    size_t mapped_size;     // 0 if allocated on the heap
+    void* mapping;
+
+    // Usable bytes behind the header (size class, See sizeClass)
+    size_t capacity;
+
+    // TILE_HUGE_PAGES and NUMA_POLICY at the time of the allocation
+    int huge_pages, numa_policy;
+
+    // NUMA node of the pages (-1 if interleaved or unknown)
+    int numa_node;
+
+    char padding [64 - 2*sizeof(size_t) - sizeof(void*) - 3*sizeof(int)];
+};
+
+// Released buffers kept for reuse (See TILE_BUFFER_POOL_SIZE)
+static std::unordered_map<size_t, std::vector<Tile_Buffer_Header*>> buffer_pool;
+static size_t buffer_pool_size = 0;
+static pthread_mutex_t buffer_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*---------------------------------------------------------------*/
+
+// Number of NUMA nodes (counted once from sysfs, 0 if unknown)
+static int numa_node_count = 0;
+static pthread_once_t numa_topology_once = PTHREAD_ONCE_INIT;
+
+static void readNumaTopology () {
+    for ( int node = 0; ; node++ ) {
+        std::string path = "/sys/devices/system/node/node" + std::to_string(node);
+
+        if ( access(path.data(), F_OK) != 0 ) {
+            break;
+        }
+        numa_node_count++;
+    }
+} /* readNumaTopology() */
+
+int getNumaNodeCount () {
+    pthread_once( &numa_topology_once, readNumaTopology );
+
+    if ( numa_node_count == 0 ) {
+        return 1;
+    }
+    return numa_node_count;
+} /* getNumaNodeCount() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Return the NUMA node of the CPU the calling thread runs on (-1 if unknown)
+*/
+static int currentNumaNode () {
+    unsigned int cpu, node;
+    if ( syscall(SYS_getcpu, &cpu, &node, NULL) != 0 ) {
+        return -1;
+    }
+    return node;
+} /* currentNumaNode() */
+
+/*
+Choose the NUMA node of a new buffer according to NUMA_POLICY
+
+Returns:
+ - Node whose memory the buffer should use (-1 if interleaved or if the
+   machine has only one node)
+*/
+static int chooseNumaNode () {
+    if ( getNumaNodeCount() < 2 ) {
+        return -1;
+    }
+
+    static std::atomic<unsigned int> next_node { 0 };
+
+    switch ( NUMA_POLICY ) {
+        case NUMA_FIRST_TOUCH:
+            return currentNumaNode();
+
+        case NUMA_ROUND_ROBIN:
+            return ( next_node++ ) % getNumaNodeCount();
+
+        default:
+            return -1;
+    }
+} /* chooseNumaNode() */
+
+/*
+Apply NUMA_POLICY to a mapped buffer
+
+Args:
+ - buffer : Start of the mapping
+ - size   : Size of the mapping
+ - node   : Node of the buffer (See chooseNumaNode)
+ - move   : Move the pages that are already faulted (buffers from the pool)
+*/
+static void applyNumaPolicy ( void* buffer, size_t size, int node, bool move ) {
+    int n_nodes = getNumaNodeCount();
+    if ( NUMA_POLICY == NUMA_FIRST_TOUCH || n_nodes < 2 ) {
+        return;
+    }
+
+    unsigned long node_mask [16] = { 0 };
+    int mode;
+
+    if ( NUMA_POLICY == NUMA_INTERLEAVE ) {
+        mode = MPOL_INTERLEAVE;
+        for ( int node = 0; node < n_nodes && node < 1024; node++ ) {
+            node_mask[node / 64] |= 1UL << ( node % 64 );
+        }
+    }
+    else {
+        mode = MPOL_BIND;
+        node_mask[node / 64] |= 1UL << ( node % 64 );
+    }
+
+    // Without libnuma: mbind(2) via syscall
+    syscall( SYS_mbind, buffer, size, mode, node_mask, 1024, move ? MPOL_MF_MOVE : 0 );
+} /* applyNumaPolicy() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Round the size of a buffer up to its size class
+Buffers of at least TILE_BUFFER_MIN_POOL_SIZE bytes are rounded up to
+one of four steps per power of two (at most 25 % wasted)
+*/
+static size_t sizeClass ( size_t size ) {
+    if ( size < TILE_BUFFER_MIN_POOL_SIZE ) {
+        return size;
+    }
+
+    int msb = 63 - __builtin_clzl( size );
+    size_t step = (size_t)1 << ( msb - 2 );
+
+    return ( size + step - 1 ) / step * step;
+} /* sizeClass() */
+
+/*
+Take a buffer of a size class out of the pool
+A buffer on the requested NUMA node is preferred. With NUMA_FIRST_TOUCH
+only buffers on the node are taken, since their pages cannot be moved.
+
+Args:
+ - capacity : Size class of the buffer
+ - node     : NUMA node of the new buffer (See chooseNumaNode)
+
+Returns:
+ - Pointer to the header of the buffer (NULL if the pool has none)
+*/
+static Tile_Buffer_Header* takePooledBuffer ( size_t capacity, int node ) {
+    Tile_Buffer_Header* header = NULL;
+
+    pthread_mutex_lock( &buffer_pool_mutex );
+
+    auto it = buffer_pool.find( capacity );
+    if ( it != buffer_pool.end() ) {
+        std::vector<Tile_Buffer_Header*>& buffers = it->second;
+
+        // Only buffers allocated with the current settings
+        size_t found = buffers.size();
+        for ( size_t i = buffers.size(); i > 0; i-- ) {
+            Tile_Buffer_Header* buffer = buffers[i-1];
+            if ( buffer->huge_pages != TILE_HUGE_PAGES || buffer->numa_policy != NUMA_POLICY ) {
+                continue;
+            }
+            if ( buffer->numa_node == node ) {
+                found = i-1;
+                break;
+            }
+            if ( NUMA_POLICY != NUMA_FIRST_TOUCH && found == buffers.size() ) {
+                found = i-1;
+            }
+        }
+
+        if ( found < buffers.size() ) {
+            header = buffers[found];
+            buffers.erase( buffers.begin() + found );
+            buffer_pool_size -= capacity;
+        }
+    }
+
+    pthread_mutex_unlock( &buffer_pool_mutex );
+
+    return header;
+} /* takePooledBuffer() */
+
+/*
+Return a buffer to the system
+*/
+static void releaseBuffer ( Tile_Buffer_Header* header ) {
+    if ( header->mapped_size == 0 ) {
+        free( header->mapping );
+    }
+    else {
+        munmap( header->mapping, header->mapped_size );
+    }
+} /* releaseBuffer() */
+
+/*---------------------------------------------------------------*/
+
+void* allocateTileBuffer ( size_t size ) {
+    size_t capacity = sizeClass( size );
+    size_t total_size = capacity + sizeof(Tile_Buffer_Header);
+
+    Tile_Buffer_Header* header;
+
+    int node = chooseNumaNode();
+
+    if ( capacity >= TILE_BUFFER_MIN_POOL_SIZE ) {
+        header = takePooledBuffer( capacity, node );
+        if ( header != NULL ) {
+            // Move the pages of the buffer to the node of the new tile
+            if ( header->numa_node != node && header->mapped_size != 0 ) {
+                applyNumaPolicy( header->mapping, header->mapped_size, node, true );
+                header->numa_node = node;
+            }
+
+            RUN_STATISTICS.buffer_pool_hits++;
+            return header + 1;
+        }
+        RUN_STATISTICS.buffer_pool_misses++;
+    }
+
+    if (
+        total_size < TILE_BUFFER_MIN_MMAP_SIZE ||
+        ( TILE_HUGE_PAGES == HUGE_PAGES_OFF && NUMA_POLICY == NUMA_FIRST_TOUCH )
+    ) {
+        header = (Tile_Buffer_Header*) aligned_alloc( 64, ( total_size + 63 ) / 64 * 64 );
+        if ( header == NULL ) {
+            return NULL;
+        }
+        header->mapped_size = 0;
+        header->mapping = header;
+        header->capacity = capacity;
+        header->huge_pages = TILE_HUGE_PAGES;
+        header->numa_policy = NUMA_POLICY;
+        header->numa_node = node;
+
+        return header + 1;
+    }
+
+    // Whole huge pages
+    size_t mapped_size = ( total_size + HUGE_PAGE_SIZE - 1 ) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void* mapping = MAP_FAILED;
+
+    if ( TILE_HUGE_PAGES == HUGE_PAGES_EXPLICIT ) {
+        mapping = mmap(
+            NULL, mapped_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+        );
+    }
+    if ( mapping == MAP_FAILED ) {
+        mapping = mmap(
+            NULL, mapped_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+        if ( mapping == MAP_FAILED ) {
+            return NULL;
+        }
+
+        if ( TILE_HUGE_PAGES != HUGE_PAGES_OFF ) {
+            madvise( mapping, mapped_size, MADV_HUGEPAGE );
+        }
+    }
+
+    // Before the first write, so the pages are placed on the right nodes
+    applyNumaPolicy( mapping, mapped_size, node, false );
+
+    header = (Tile_Buffer_Header*) mapping;
+    header->mapped_size = mapped_size;
+    header->mapping = mapping;
+    header->capacity = capacity;
+    header->huge_pages = TILE_HUGE_PAGES;
+    header->numa_policy = NUMA_POLICY;
+    header->numa_node = node;
+
+    return header + 1;
+} /* allocateTileBuffer() */
+
+/*---------------------------------------------------------------*/
+
+void freeTileBuffer ( void* buffer ) {
+    if ( buffer == NULL ) {
+        return;
+    }
+
+    Tile_Buffer_Header* header = (Tile_Buffer_Header*) buffer - 1;
+
+    // Keep the buffer (and its faulted pages) for the next tile
+    if ( header->capacity >= TILE_BUFFER_MIN_POOL_SIZE ) {
+        pthread_mutex_lock( &buffer_pool_mutex );
+
+        bool pooled = false;
+        if ( buffer_pool_size + header->capacity <= (size_t)TILE_BUFFER_POOL_SIZE * 1048576 ) {
+            buffer_pool[header->capacity].push_back( header );
+            buffer_pool_size += header->capacity;
+            pooled = true;
+        }
+
+        pthread_mutex_unlock( &buffer_pool_mutex );
+
+        if ( pooled ) {
+            return;
+        }
+    }
+
+    releaseBuffer( header );
+} /* freeTileBuffer() */
+
+/*---------------------------------------------------------------*/
+
+void clearTileBufferPool () {
+    pthread_mutex_lock( &buffer_pool_mutex );
+
+    for ( auto& [capacity, buffers] : buffer_pool ) {
+        for ( Tile_Buffer_Header* header : buffers ) {
+            releaseBuffer( header );
+        }
+    }
+    buffer_pool.clear();
+    buffer_pool_size = 0;
+
+    pthread_mutex_unlock( &buffer_pool_mutex );
+} /* clearTileBufferPool() */
@@ -0,0 +1,75 @@
+#ifndef TILE_ALLOCATOR_H
+#define TILE_ALLOCATOR_H
+
+#include <cstddef>
+#include <pthread.h>
+
+// Placement of the tile buffers on the NUMA nodes (See NUMA_POLICY)
+enum NumaPolicies {
+    NUMA_FIRST_TOUCH,   // Node of the thread that first writes a page (kernel default)
+    NUMA_INTERLEAVE,    // Pages of every buffer interleaved across all nodes
+    NUMA_ROUND_ROBIN    // Every buffer on one node, the nodes taking turns
+};
+
+// Huge page modes (See TILE_HUGE_PAGES)
+enum HugePageModes {
+    HUGE_PAGES_OFF,
+    HUGE_PAGES_TRANSPARENT, // madvise(MADV_HUGEPAGE)
+    HUGE_PAGES_EXPLICIT     // MAP_HUGETLB (falls back to transparent huge pages)
+};
+
+// Buffers smaller than this are allocated on the heap
+#define TILE_BUFFER_MIN_MMAP_SIZE ( 2 * 1024 * 1024 )
+
+// Buffers smaller than this are not kept in the buffer pool
+#define TILE_BUFFER_MIN_POOL_SIZE ( 64 * 1024 )
+
+/*
+Allocate a buffer for the cells of a tile according to TILE_HUGE_PAGES
+and NUMA_POLICY
+The buffer is aligned to 64 bytes and must be released by freeTileBuffer
+Large buffers are taken from the buffer pool if it has one of the same
+size class. Their pages are moved to the NUMA node the policy chooses
+for the new buffer.
+
+The content of the buffer is undefined (buffers from the pool hold the
+cells of an earlier tile), so every cell must be written or cleared
+before it is read.
+
+Args:
+ - size : Size of the buffer in bytes
+
+Returns:
+ - Pointer to the buffer (NULL if no memory is available)
+*/
+void* allocateTileBuffer ( size_t size );
+
+/*
+Release a buffer allocated by allocateTileBuffer
+Large buffers are returned to the buffer pool as long as the pool
+stays within TILE_BUFFER_POOL_SIZE
+
+Args:
+ - buffer : Pointer to the buffer (NULL is ignored)
+*/
+void freeTileBuffer ( void* buffer );
+
+/*
+Return all buffers of the buffer pool to the system
+*/
+void clearTileBufferPool ();
+
+/*
+Allocate an array for the cells of a tile (See allocateTileBuffer)
+*/
+template <typename T>
+T* allocateTileArray ( size_t n ) {
+    return (T*) allocateTileBuffer( n * sizeof(T) );
+}
+
+/*
+Return the number of NUMA nodes of the machine (1 if unknown)
+*/
+int getNumaNodeCount ();
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <utility>
 #include <iostream>
 
 /*---------------------------------------------------------------*/
@@ -30,6 +31,20 @@ std::vector<Polygon>& VectorTile::getPolygons () {
 
 /*---------------------------------------------------------------*/
 
+size_t VectorTile::getMemorySize () {
+    size_t size = 0;
+
+    for ( Polygon& polygon : polygons ) {
+        size += sizeof(Polygon);
+        size += polygon.getPoints().size() * sizeof(Vector);
+        size += polygon.getID().size();
+    }
+
+    return size;
+} /* getMemorySize() */
+
+/*---------------------------------------------------------------*/
+
 union data_block {
     uint8_t u8;
     uint32_t u32;
@@ -174,6 +189,29 @@ int VectorTile::fromBinaryFile ( std::string file_path ) {
         return FILE_NOT_FOUND;
     }
 
+    int status = fromBinaryStream( file );
+    fclose( file );
+
+    return status;
+} /* fromBinaryFile() */
+
+/*---------------------------------------------------------------*/
+
+int VectorTile::fromBinaryData ( const uint8_t* data, size_t size ) {
+    FILE* file = fmemopen( (void*)data, size, "rb" );
+    if ( !file ) {
+        return FILE_CORRUPT;
+    }
+
+    int status = fromBinaryStream( file );
+    fclose( file );
+
+    return status;
+} /* fromBinaryData() */
+
+/*---------------------------------------------------------------*/
+
+int VectorTile::fromBinaryStream ( FILE* file ) {
     union data_block data;
 
     fread( data.bytes, 1, 4, file );
@@ -213,6 +251,8 @@ int VectorTile::fromBinaryFile ( std::string file_path ) {
     uint32_t n_points;
     int add_count = 0;
 
+    polygons.reserve( polygons.size() + n_polygons );
+
     for ( uint32_t i = 0; i < n_polygons; i++ ) {
         Polygon polygon;
 
@@ -294,13 +334,11 @@ int VectorTile::fromBinaryFile ( std::string file_path ) {
 
 
         add_count++;
-        polygons.push_back( polygon );
+        polygons.push_back( std::move(polygon) );
     }
 
-    fclose( file );
-
     return SUCCESS;
-} /* fromBinaryFile() */
+} /* fromBinaryStream() */
 
 /*---------------------------------------------------------------*/
 
@@ -449,7 +487,7 @@ int VectorTile::fromGmlFile ( GmlFile& gmlfile ) {
         // least three points, add it to the tile's list of polygons
         if ( !point_too_far_away && polygon.getPoints().size() >= 3 ) {
             polygon.getCentroid();
-            polygons.push_back( polygon );
+            polygons.push_back( std::move(polygon) );
 
             add_count++;
             yes++;
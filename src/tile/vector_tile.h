@@ -8,6 +8,8 @@
 
 #include <vector>
 #include <string>
+#include <cstdio>
+#include <cstdint>
 
 /*
 Class to save vector data (surfaces) read from a GML file
@@ -32,6 +34,11 @@ public:
     */
     std::vector<Polygon>& getPolygons ();
 
+    /*
+    Return the memory occupied by the polygons of the tile in bytes
+    */
+    size_t getMemorySize ();
+
 
     /* INPUT / OUTPUT */
 
@@ -64,6 +71,22 @@ public:
     */
     int fromBinaryFile ( std::string file_path );
 
+    /*
+    Deserialize the content of a binary file in memory
+    (See fromBinaryFile)
+
+    Args:
+     - data : Pointer to the content of the binary file
+     - size : Size of the content in bytes
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_CORRUPT
+    */
+    int fromBinaryData ( const uint8_t* data, size_t size );
+
     /*
     Serialize the tile object and write it to a file in a binary
     format
@@ -84,6 +107,11 @@ public:
 private:
     std::vector<Polygon> polygons;
 
+    /*
+    Deserialize a binary file from an open stream (See fromBinaryFile)
+    */
+    int fromBinaryStream ( FILE* file );
+
     Vector
         lower_corner,
         upper_corner;
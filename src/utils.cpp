@@ -161,3 +161,14 @@ void splitString ( std::string str, std::string* strings, char delimiter ) {
     trimString( strings[0] );
     trimString( strings[1] );
 } /* splitString () */
+
+/*---------------------------------------------------------------*/
+
+uint64_t hashBytes ( uint64_t hash, const void* bytes, size_t n_bytes ) {
+    const uint8_t* byte = (const uint8_t*) bytes;
+    for ( size_t i = 0; i < n_bytes; i++ ) {
+        hash ^= byte[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+} /* hashBytes () */
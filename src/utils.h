@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <cstring>
+#include <cstdint>
 #include <string>
 
 #define STRNEQUAL(str1, str2, n)   !strncmp(str1, str2, n)
@@ -121,4 +122,20 @@ Returns:
 */
 void splitString ( std::string str, std::string* strings, char delimiter );
 
+// Start value of a hash (See hashBytes)
+#define HASH_START 14695981039346656037ULL
+
+/*
+Combine a hash value with bytes (FNV-1a)
+
+Args:
+ - hash    : Hash value (HASH_START for a new hash)
+ - bytes   : Pointer to the bytes
+ - n_bytes : Number of bytes
+
+Returns:
+ - New hash value
+*/
+uint64_t hashBytes ( uint64_t hash, const void* bytes, size_t n_bytes );
+
 #endif
@@ -5,7 +5,7 @@
 
 /*
 Download the file from the given URL and save it in the
-given directory
+given directory (See DownloadManager)
 
 Args:
  - url   : URL of the file to be downloaded
@@ -18,7 +18,7 @@ Returns:
 
     - FILE_ALREADY_EXISTS
     - FILE_NOT_CREATABLE
-    - INVALID_URL
+    - FILE_NOT_FOUND
 */
 int downloadFile ( std::string url, std::string dir, bool force = false );
 
@@ -0,0 +1,560 @@
+#include "download_manager.h"
+
+#include "../status_codes.h"
+#include "../shared.h"
+#include "../statistics.h"
+#include "../utils.h"
+
+#include <curl/curl.h>
+#include <cstdio>
+#include <algorithm>
+
+/*---------------------------------------------------------------*/
+
+DownloadManager DOWNLOAD_MANAGER;
+
+/*---------------------------------------------------------------*/
+
+static size_t writeDownload ( char* buf, size_t itemsize, size_t n_items, void* arg ) {
+    Download_Job* job = (Download_Job*) arg;
+
+    if ( job->buffer == NULL ) {
+        return fwrite( buf, itemsize, n_items, job->file );
+    }
+
+    // Allocate the array for the whole file with the first part
+    if ( job->buffer->empty() ) {
+        curl_off_t content_length = -1;
+        curl_easy_getinfo( (CURL*) job->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length );
+        if ( content_length > 0 ) {
+            job->buffer->reserve( content_length );
+        }
+    }
+
+    job->buffer->insert( job->buffer->end(), buf, buf + itemsize*n_items );
+
+    return itemsize*n_items;
+} /* writeDownload() */
+
+/*---------------------------------------------------------------*/
+
+static size_t readDownloadHeader ( char* buf, size_t itemsize, size_t n_items, void* arg ) {
+    Download_Job* job = (Download_Job*) arg;
+    size_t n_bytes = itemsize*n_items;
+
+    std::string line( buf, n_bytes );
+
+    // The headers of a redirect are replaced by the ones of the target
+    if ( line.starts_with("HTTP/") ) {
+        job->response.etag.clear();
+        job->response.last_modified.clear();
+        return n_bytes;
+    }
+
+    size_t colon = line.find( ':' );
+    if ( colon == std::string::npos ) {
+        return n_bytes;
+    }
+
+    std::string name = line.substr( 0, colon );
+    std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+
+    size_t
+        first = line.find_first_not_of( " \t", colon+1 ),
+        last  = line.find_last_not_of( " \t\r\n" );
+
+    std::string value;
+    if ( first != std::string::npos && last != std::string::npos && last >= first ) {
+        value = line.substr( first, last - first + 1 );
+    }
+
+    if ( name == "etag" ) {
+        job->response.etag = value;
+    }
+    else if ( name == "last-modified" ) {
+        job->response.last_modified = value;
+    }
+
+    return n_bytes;
+} /* readDownloadHeader() */
+
+/*---------------------------------------------------------------*/
+
+/*
+State of a download waited for with DownloadManager::download
+*/
+struct Download_Wait {
+    bool done;
+    int status;
+};
+
+void signalDownload ( int status, void* arg ) {
+    Download_Wait* wait = (Download_Wait*) arg;
+    wait->status = status;
+    wait->done = true;
+
+    pthread_cond_broadcast( &DOWNLOAD_MANAGER.done_cond );
+} /* signalDownload() */
+
+/*---------------------------------------------------------------*/
+
+DownloadManager::DownloadManager () {
+    pthread_mutex_init( &mutex, NULL );
+    pthread_cond_init( &done_cond, NULL );
+    pthread_cond_init( &persist_cond, NULL );
+} /* DownloadManager() */
+
+/*---------------------------------------------------------------*/
+
+DownloadManager::~DownloadManager () {
+    stop();
+
+    pthread_cond_destroy( &persist_cond );
+    pthread_cond_destroy( &done_cond );
+    pthread_mutex_destroy( &mutex );
+} /* ~DownloadManager() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::request ( std::string url, std::string dir, Download_Callback callback, void* arg ) {
+    pthread_mutex_lock( &mutex );
+
+    // Join the running download of the file
+    auto running = jobs.find( url );
+    if ( running != jobs.end() ) {
+        if ( callback != NULL ) {
+            running->second->callbacks.push_back( { callback, arg } );
+        }
+        RUN_STATISTICS.downloads_joined++;
+
+        pthread_mutex_unlock( &mutex );
+        return;
+    }
+
+    Download_Job* job = new Download_Job;
+    job->key = url;
+    job->url = url;
+    job->file_path = buildFilepath( dir, extractFilename(url) );
+    job->buffer = NULL;
+    job->curl = NULL;
+    if ( callback != NULL ) {
+        job->callbacks.push_back( { callback, arg } );
+    }
+
+    job->file = fopen( (job->file_path + ".download").data(), "wb" );
+    if ( job->file == NULL ) {
+        finishJob( job, FILE_NOT_CREATABLE );
+
+        pthread_mutex_unlock( &mutex );
+        return;
+    }
+
+    startJob( job );
+
+    pthread_mutex_unlock( &mutex );
+} /* request() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::startJob ( Download_Job* job ) {
+    CURL* curl = curl_easy_init();
+
+    curl_easy_setopt( curl, CURLOPT_URL, job->url.data() );
+    curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, writeDownload );
+    curl_easy_setopt( curl, CURLOPT_WRITEDATA, job );
+    curl_easy_setopt( curl, CURLOPT_PRIVATE, job );
+
+    if ( !job->range.empty() ) {
+        curl_easy_setopt( curl, CURLOPT_RANGE, job->range.data() );
+    }
+    if ( job->header_only ) {
+        curl_easy_setopt( curl, CURLOPT_NOBODY, 1L );
+    }
+    if ( !job->range.empty() || job->header_only ) {
+        curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1L );
+    }
+    if ( job->buffer != NULL ) {
+        curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, readDownloadHeader );
+        curl_easy_setopt( curl, CURLOPT_HEADERDATA, job );
+    }
+
+    job->curl = curl;
+
+    jobs[job->key] = job;
+    new_jobs.push_back( job );
+
+    if ( !thread_running ) {
+        multi = curl_multi_init();
+
+        long max_connections = DOWNLOAD_CONNECTIONS > 0 ? DOWNLOAD_CONNECTIONS : 1;
+        curl_multi_setopt( multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, max_connections );
+        curl_multi_setopt( multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections );
+        curl_multi_setopt( multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+
+        thread_running = pthread_create( &thread, NULL, Thread_download, (void*)this ) == 0;
+
+        if ( !thread_running ) {
+            curl_multi_cleanup( multi );
+            multi = NULL;
+
+            new_jobs.clear();
+            finishJob( job, FILE_NOT_FOUND );
+
+            return;
+        }
+    }
+
+    curl_multi_wakeup( multi );
+} /* startJob() */
+
+/*---------------------------------------------------------------*/
+
+int DownloadManager::download ( std::string url, std::string dir ) {
+    Download_Wait wait = { false, SUCCESS };
+
+    request( url, dir, signalDownload, &wait );
+
+    pthread_mutex_lock( &mutex );
+    while ( !wait.done ) {
+        pthread_cond_wait( &done_cond, &mutex );
+    }
+    pthread_mutex_unlock( &mutex );
+
+    return wait.status;
+} /* download() */
+
+/*---------------------------------------------------------------*/
+
+int DownloadManager::download (
+    std::string url, std::shared_ptr<std::vector<uint8_t>>& data,
+    Download_Response& response
+) {
+    Download_Wait wait = { false, SUCCESS };
+
+    pthread_mutex_lock( &mutex );
+
+    std::string key = "memory:" + url;
+
+    // Join the running download of the file into memory
+    auto running = jobs.find( key );
+    if ( running != jobs.end() ) {
+        Download_Job* job = running->second;
+
+        data = job->data;
+        job->responses.push_back( &response );
+        job->callbacks.push_back( { signalDownload, &wait } );
+        RUN_STATISTICS.downloads_joined++;
+    }
+    else {
+        data = std::make_shared<std::vector<uint8_t>>();
+
+        Download_Job* job = new Download_Job;
+        job->key = key;
+        job->url = url;
+        job->file = NULL;
+        job->buffer = data.get();
+        job->data = data;
+        job->responses.push_back( &response );
+        job->curl = NULL;
+        job->callbacks.push_back( { signalDownload, &wait } );
+
+        startJob( job );
+    }
+
+    while ( !wait.done ) {
+        pthread_cond_wait( &done_cond, &mutex );
+    }
+    pthread_mutex_unlock( &mutex );
+
+    return wait.status;
+} /* download() */
+
+/*---------------------------------------------------------------*/
+
+int DownloadManager::fetch (
+    std::string url, std::string range, bool header_only,
+    std::vector<uint8_t>& data, Download_Response& response
+) {
+    Download_Wait wait = { false, SUCCESS };
+
+    data.clear();
+
+    pthread_mutex_lock( &mutex );
+
+    // The key is unique for every download into memory
+    char key [64];
+    snprintf( key, sizeof(key), "memory:%p", (void*) &wait );
+
+    Download_Job* job = new Download_Job;
+    job->key = key;
+    job->url = url;
+    job->file = NULL;
+    job->buffer = &data;
+    job->range = range;
+    job->header_only = header_only;
+    job->responses.push_back( &response );
+    job->curl = NULL;
+    job->callbacks.push_back( { signalDownload, &wait } );
+
+    startJob( job );
+
+    while ( !wait.done ) {
+        pthread_cond_wait( &done_cond, &mutex );
+    }
+    pthread_mutex_unlock( &mutex );
+
+    if ( wait.status != SUCCESS ) {
+        data.clear();
+    }
+
+    return wait.status;
+} /* fetch() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::persist ( std::shared_ptr<std::vector<uint8_t>> data, std::string file_path ) {
+    pthread_mutex_lock( &mutex );
+
+    // Requests joined with the same download persist the file only once
+    for ( auto& [queued_data, queued_file_path] : persist_queue ) {
+        if ( queued_file_path == file_path ) {
+            pthread_mutex_unlock( &mutex );
+            return;
+        }
+    }
+
+    persist_queue.push_back( { data, file_path } );
+
+    if ( !persist_running ) {
+        persist_running = pthread_create( &persist_thread, NULL, Thread_persist, (void*)this ) == 0;
+
+        if ( !persist_running ) {
+            persist_queue.clear();
+        }
+    }
+
+    pthread_cond_signal( &persist_cond );
+    pthread_mutex_unlock( &mutex );
+} /* persist() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::cancel ( void* arg ) {
+    pthread_mutex_lock( &mutex );
+
+    for ( auto& [url, job] : jobs ) {
+        std::erase_if(
+            job->callbacks,
+            [arg] ( std::pair<Download_Callback, void*>& callback ) {
+                return callback.second == arg;
+            }
+        );
+    }
+
+    pthread_mutex_unlock( &mutex );
+} /* cancel() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::stop () {
+    pthread_mutex_lock( &mutex );
+
+    if ( !thread_running && !persist_running ) {
+        pthread_mutex_unlock( &mutex );
+        return;
+    }
+
+    stopping = true;
+    if ( thread_running ) {
+        curl_multi_wakeup( multi );
+    }
+    pthread_cond_signal( &persist_cond );
+
+    bool
+        join_thread = thread_running,
+        join_persist_thread = persist_running;
+
+    pthread_mutex_unlock( &mutex );
+
+    if ( join_thread ) {
+        pthread_join( thread, NULL );
+    }
+    if ( join_persist_thread ) {
+        pthread_join( persist_thread, NULL );
+    }
+
+    pthread_mutex_lock( &mutex );
+
+    if ( multi != NULL ) {
+        curl_multi_cleanup( multi );
+        multi = NULL;
+    }
+
+    thread_running = false;
+    persist_running = false;
+    stopping = false;
+
+    pthread_mutex_unlock( &mutex );
+} /* stop() */
+
+/*---------------------------------------------------------------*/
+
+void DownloadManager::finishJob ( Download_Job* job, int status ) {
+
+    // Downloads into a file
+    if ( job->buffer == NULL ) {
+        if ( job->file != NULL ) {
+            fclose( job->file );
+        }
+
+        std::string download_path = job->file_path + ".download";
+
+        if ( status == SUCCESS ) {
+            if ( std::rename( download_path.data(), job->file_path.data() ) != 0 ) {
+                status = FILE_NOT_CREATABLE;
+            }
+        }
+        if ( status != SUCCESS ) {
+            std::remove( download_path.data() );
+        }
+    }
+
+    if ( job->curl != NULL ) {
+        curl_easy_cleanup( (CURL*) job->curl );
+    }
+
+    jobs.erase( job->key );
+
+    for ( Download_Response* response : job->responses ) {
+        *response = job->response;
+    }
+
+    for ( auto& [callback, arg] : job->callbacks ) {
+        callback( status, arg );
+    }
+
+    delete job;
+} /* finishJob() */
+
+/*---------------------------------------------------------------*/
+
+void* Thread_download ( void* arg ) {
+    DownloadManager* manager = (DownloadManager*) arg;
+    CURLM* multi = (CURLM*) manager->multi;
+
+    while ( true ) {
+        pthread_mutex_lock( &manager->mutex );
+
+        // Abort the running downloads
+        if ( manager->stopping ) {
+            while ( !manager->jobs.empty() ) {
+                Download_Job* job = manager->jobs.begin()->second;
+                curl_multi_remove_handle( multi, (CURL*) job->curl );
+                manager->finishJob( job, FILE_NOT_FOUND );
+            }
+            manager->new_jobs.clear();
+
+            pthread_mutex_unlock( &manager->mutex );
+            break;
+        }
+
+        for ( Download_Job* job : manager->new_jobs ) {
+            curl_multi_add_handle( multi, (CURL*) job->curl );
+        }
+        manager->new_jobs.clear();
+
+        pthread_mutex_unlock( &manager->mutex );
+
+        int n_running;
+        curl_multi_perform( multi, &n_running );
+
+        CURLMsg* message;
+        int n_messages;
+        while ( (message = curl_multi_info_read(multi, &n_messages)) != NULL ) {
+            if ( message->msg != CURLMSG_DONE ) {
+                continue;
+            }
+
+            CURL* curl = message->easy_handle;
+            CURLcode result = message->data.result;
+
+            Download_Job* job;
+            curl_easy_getinfo( curl, CURLINFO_PRIVATE, (char**) &job );
+
+            long http_code = 0;
+            curl_off_t n_bytes = 0, content_length = -1;
+            curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &http_code );
+            curl_easy_getinfo( curl, CURLINFO_SIZE_DOWNLOAD_T, &n_bytes );
+            curl_easy_getinfo( curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length );
+
+            curl_multi_remove_handle( multi, curl );
+
+            // (The response code of file:// URLs is 0)
+            bool http_ok =
+                http_code == 200 || http_code == 0 ||
+                ( http_code == 206 && !job->range.empty() );
+
+            int status = ( result == CURLE_OK && http_ok ) ? SUCCESS : FILE_NOT_FOUND;
+
+            job->response.http_code = http_code;
+            job->response.content_length = content_length;
+
+            // (Requests of remote files are counted by RemoteFile)
+            if ( status == SUCCESS && job->range.empty() && !job->header_only ) {
+                RUN_STATISTICS.downloads++;
+                RUN_STATISTICS.download_bytes += n_bytes;
+            }
+
+            pthread_mutex_lock( &manager->mutex );
+            manager->finishJob( job, status );
+            pthread_mutex_unlock( &manager->mutex );
+        }
+
+        curl_multi_poll( multi, NULL, 0, 1000, NULL );
+    }
+
+    return NULL;
+} /* Thread_download() */
+
+/*---------------------------------------------------------------*/
+
+void* Thread_persist ( void* arg ) {
+    DownloadManager* manager = (DownloadManager*) arg;
+
+    pthread_mutex_lock( &manager->mutex );
+
+    while ( true ) {
+        while ( manager->persist_queue.empty() && !manager->stopping ) {
+            pthread_cond_wait( &manager->persist_cond, &manager->mutex );
+        }
+
+        // The pending files are written before stopping
+        if ( manager->persist_queue.empty() ) {
+            break;
+        }
+
+        auto [data, file_path] = manager->persist_queue.front();
+        manager->persist_queue.pop_front();
+
+        pthread_mutex_unlock( &manager->mutex );
+
+        std::string download_path = file_path + ".download";
+
+        // (The file may have been written for a joined request already)
+        FILE* file = FILE_EXISTS( file_path.data() ) ? NULL : fopen( download_path.data(), "wb" );
+        if ( file != NULL ) {
+            bool written = fwrite( data->data(), 1, data->size(), file ) == data->size();
+            written = ( fclose(file) == 0 ) && written;
+
+            if ( !written || std::rename(download_path.data(), file_path.data()) != 0 ) {
+                std::remove( download_path.data() );
+            }
+        }
+
+        pthread_mutex_lock( &manager->mutex );
+    }
+
+    pthread_mutex_unlock( &manager->mutex );
+
+    return NULL;
+} /* Thread_persist() */
@@ -0,0 +1,246 @@
+#ifndef DOWNLOAD_MANAGER_H
+#define DOWNLOAD_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <cstdio>
+#include <pthread.h>
+
+/*
+Function called when a download is finished
+
+Args:
+ - status : Status code of the download
+    - SUCCESS
+
+    - FILE_NOT_CREATABLE
+    - FILE_NOT_FOUND
+ - arg    : Argument given to DownloadManager::request
+*/
+typedef void (*Download_Callback) ( int status, void* arg );
+
+/*
+Response to a request of DownloadManager::fetch
+*/
+struct Download_Response {
+    // HTTP response code (0 for file:// URLs)
+    long http_code = 0;
+
+    // Size of the content in bytes (-1 if unknown)
+    int64_t content_length = -1;
+
+    // Validators of the file (empty if the server sent none)
+    std::string etag, last_modified;
+};
+
+/*
+Download in progress (See DownloadManager)
+*/
+struct Download_Job {
+    // Key of the download in DownloadManager::jobs (URL for files,
+    // "memory:<URL>" for whole files into memory, unique for the
+    // requests of DownloadManager::fetch)
+    std::string key;
+
+    std::string url, file_path;
+
+    // Destination of the download (file or memory)
+    FILE* file;
+    std::vector<uint8_t>* buffer;
+
+    // Part of the file ("first-last", empty for the whole file) and
+    // whether only the header is requested (See DownloadManager::fetch)
+    std::string range;
+    bool header_only = false;
+
+    // Response of the server, copied to all requests waiting for it
+    // when the download is finished
+    Download_Response response;
+    std::vector<Download_Response*> responses;
+
+    // Content of a download into memory, shared by the joined requests
+    // (See DownloadManager::download(url, data, response))
+    std::shared_ptr<std::vector<uint8_t>> data;
+
+    void* curl;
+
+    // Callbacks of all requests for the file
+    std::vector<std::pair<Download_Callback, void*>> callbacks;
+};
+
+/*
+Downloads files in parallel on a background thread with libcurl multi
+
+The connections are kept open and reused by the following downloads
+(up to DOWNLOAD_CONNECTIONS at once). Requests for a file that is being
+downloaded already are joined with the running download. The files are
+downloaded to <file_path>.download and renamed when they are complete,
+so partial files are never read as tiles.
+
+Files can also be downloaded into memory and decoded from there (See
+download(url, data)) and written to disk later in the background (See
+persist). The range requests of remote files go through the same
+connections (See fetch and RemoteFile).
+*/
+class DownloadManager {
+public:
+    DownloadManager ();
+    ~DownloadManager ();
+
+    /*
+    Request the download of a file into a directory
+    The download thread is started with the first request
+
+    The callback is called on the download thread with the manager
+    locked, so it must be short and must not call the manager.
+
+    Args:
+     - url      : URL of the file
+     - dir      : Directory path where the file is saved
+     - callback : Function called when the download is finished (or NULL)
+     - arg      : Argument passed to the callback
+    */
+    void request ( std::string url, std::string dir, Download_Callback callback, void* arg );
+
+    /*
+    Download a file into a directory and wait for the download
+
+    Args:
+     - url : URL of the file
+     - dir : Directory path where the file is saved
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_CREATABLE
+        - FILE_NOT_FOUND
+    */
+    int download ( std::string url, std::string dir );
+
+    /*
+    Download a file into memory and wait for the download
+    Requests for a file that is being downloaded into memory already are
+    joined with the running download and share its content.
+
+    Args:
+     - url      : URL of the file
+     - data     : Reference to the pointer to set to the content of the file
+     - response : Reference to store the response code, size and
+                  validators in (See Download_Response)
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+    */
+    int download (
+        std::string url, std::shared_ptr<std::vector<uint8_t>>& data,
+        Download_Response& response
+    );
+
+    /*
+    Request a part of a file or only its header and wait for the response
+    (Not joined with other requests of the file)
+    The validators of the response (ETag, Last-Modified) tell whether
+    the file has changed since an earlier request.
+
+    Args:
+     - url         : URL of the file
+     - range       : Part of the file "first-last" in bytes (empty for the
+                     whole file)
+     - header_only : Request only the header (size of the file)
+     - data        : Reference to the array to store the content in
+     - response    : Reference to store the response code, size and
+                     validators in
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+    */
+    int fetch (
+        std::string url, std::string range, bool header_only,
+        std::vector<uint8_t>& data, Download_Response& response
+    );
+
+    /*
+    Write a file downloaded into memory to disk in the background
+    The file is written to <file_path>.download and renamed when it is
+    complete. The pending files are written before stop returns.
+
+    Args:
+     - data      : Content of the file
+     - file_path : Path of the file
+    */
+    void persist ( std::shared_ptr<std::vector<uint8_t>> data, std::string file_path );
+
+    /*
+    Remove the callbacks with the argument arg from the running downloads
+    The callbacks are not called anymore after cancel returns
+    (The downloads themselves are finished)
+    */
+    void cancel ( void* arg );
+
+    /*
+    Abort the running downloads and stop the download thread and the
+    thread writing the persisted files
+    (The callbacks are called with FILE_NOT_FOUND)
+    */
+    void stop ();
+
+private:
+    // Running downloads (See Download_Job::key)
+    std::unordered_map<std::string, Download_Job*> jobs;
+
+    // Downloads not yet passed to curl
+    std::deque<Download_Job*> new_jobs;
+
+    void* multi = NULL;
+
+    pthread_t thread;
+    bool thread_running = false;
+    bool stopping = false;
+
+    pthread_mutex_t mutex;
+
+    // Signalled when a download waited for with download() is finished
+    pthread_cond_t done_cond;
+
+    // Files to write to disk (See persist)
+    std::deque<std::pair<std::shared_ptr<std::vector<uint8_t>>, std::string>> persist_queue;
+
+    pthread_t persist_thread;
+    bool persist_running = false;
+    pthread_cond_t persist_cond;
+
+    /*
+    Register a download and pass it to the download thread, which is
+    started if necessary (The manager must be locked)
+    */
+    void startJob ( Download_Job* job );
+
+    /*
+    Close the file of a download, call its callbacks and free it
+    (The manager must be locked)
+    */
+    void finishJob ( Download_Job* job, int status );
+
+    friend void* Thread_download ( void* arg );
+    friend void* Thread_persist ( void* arg );
+    friend void signalDownload ( int status, void* arg );
+};
+
+void* Thread_download ( void* arg );
+void* Thread_persist ( void* arg );
+
+// Download manager shared by all downloads of tiles (See downloadFile)
+extern DownloadManager DOWNLOAD_MANAGER;
+
+#endif
@@ -0,0 +1,316 @@
+#include "remote_file.h"
+
+#include "../status_codes.h"
+#include "../statistics.h"
+#include "../utils.h"
+#include "download_manager.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*---------------------------------------------------------------*/
+
+RemoteFile::RemoteFile () {
+    pthread_mutex_init( &mutex, NULL );
+    pthread_cond_init( &chunks_cond, NULL );
+} /* RemoteFile() */
+
+RemoteFile::~RemoteFile () {
+    if ( fd >= 0 ) {
+        close( fd );
+    }
+    pthread_cond_destroy( &chunks_cond );
+    pthread_mutex_destroy( &mutex );
+} /* ~RemoteFile() */
+
+/*---------------------------------------------------------------*/
+
+int RemoteFile::open ( std::string url, std::string file_path ) {
+    this->url = url;
+    this->file_path = file_path;
+    cache_path = file_path + ".part";
+
+    size = 0;
+
+    // Size and validator of the file on the server
+    std::vector<uint8_t> data;
+    Download_Response response;
+
+    int status = DOWNLOAD_MANAGER.fetch( url, "", true, data, response );
+
+    RUN_STATISTICS.remote_requests++;
+
+    if ( status != SUCCESS || response.content_length <= 0 ) {
+        return FILE_NOT_FOUND;
+    }
+
+    size = response.content_length;
+    validator = response.etag.empty() ? response.last_modified : response.etag;
+
+    size_t n_chunks = ( size + REMOTE_FILE_CHUNK_SIZE - 1 ) / REMOTE_FILE_CHUNK_SIZE;
+    chunks.assign( (n_chunks + 7) / 8, 0 );
+    chunks_in_flight.assign( (n_chunks + 7) / 8, 0 );
+
+    // Chunks cached by an earlier run (the cache of a changed file is
+    // started again)
+    bool cached = loadChunkList();
+    if ( !cached ) {
+        std::remove( (cache_path + ".chunks").data() );
+    }
+
+    fd = ::open( cache_path.data(), O_RDWR | O_CREAT | (cached ? 0 : O_TRUNC), 0666 );
+    if ( fd < 0 ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    promoteCacheFile();
+
+    return SUCCESS;
+} /* open() */
+
+/*---------------------------------------------------------------*/
+
+long RemoteFile::read ( size_t offset, void* buf, size_t n_bytes ) {
+    if ( offset >= size || n_bytes == 0 ) {
+        return 0;
+    }
+    n_bytes = std::min( n_bytes, size - offset );
+
+    if ( fetch(offset, n_bytes) != SUCCESS ) {
+        return -1;
+    }
+
+    size_t n_read = 0;
+    while ( n_read < n_bytes ) {
+        ssize_t n = pread( fd, (uint8_t*)buf + n_read, n_bytes - n_read, offset + n_read );
+        if ( n <= 0 ) {
+            return -1;
+        }
+        n_read += n;
+    }
+
+    return n_read;
+} /* read() */
+
+/*---------------------------------------------------------------*/
+
+int RemoteFile::fetch ( size_t offset, size_t n_bytes ) {
+    if ( offset >= size || n_bytes == 0 ) {
+        return SUCCESS;
+    }
+    n_bytes = std::min( n_bytes, size - offset );
+
+    size_t
+        first = offset / REMOTE_FILE_CHUNK_SIZE,
+        end   = ( offset + n_bytes - 1 ) / REMOTE_FILE_CHUNK_SIZE + 1;
+
+    pthread_mutex_lock( &mutex );
+
+    size_t chunk = first;
+    while ( chunk < end ) {
+        if ( hasChunk(chunk) ) {
+            chunk++;
+            continue;
+        }
+
+        // Another thread fetches the chunk (it is fetched here if that
+        // request fails)
+        if ( isChunkInFlight(chunk) ) {
+            pthread_cond_wait( &chunks_cond, &mutex );
+            continue;
+        }
+
+        // Fetch the run of missing chunks nobody else fetches at once
+        size_t run_end = chunk + 1;
+        while ( run_end < end && !hasChunk(run_end) && !isChunkInFlight(run_end) ) {
+            run_end++;
+        }
+        setChunkBits( chunks_in_flight, chunk, run_end, true );
+
+        pthread_mutex_unlock( &mutex );
+
+        size_t fetched_first = chunk, fetched_end = run_end;
+        int status = fetchChunks( fetched_first, fetched_end );
+
+        pthread_mutex_lock( &mutex );
+
+        setChunkBits( chunks_in_flight, chunk, run_end, false );
+        pthread_cond_broadcast( &chunks_cond );
+
+        if ( status != SUCCESS ) {
+            pthread_mutex_unlock( &mutex );
+            return status;
+        }
+
+        setChunkBits( chunks, fetched_first, fetched_end, true );
+        saveChunkList();
+        promoteCacheFile();
+
+        chunk = run_end;
+    }
+
+    pthread_mutex_unlock( &mutex );
+
+    return SUCCESS;
+} /* fetch() */
+
+/*---------------------------------------------------------------*/
+
+size_t RemoteFile::getSize () const {
+    return size;
+} /* getSize() */
+
+std::string RemoteFile::getValidator () const {
+    return validator;
+} /* getValidator() */
+
+/*---------------------------------------------------------------*/
+
+bool RemoteFile::hasChunk ( size_t chunk ) const {
+    return ( chunks[chunk >> 3] >> (chunk & 7) ) & 1;
+} /* hasChunk() */
+
+bool RemoteFile::isChunkInFlight ( size_t chunk ) const {
+    return ( chunks_in_flight[chunk >> 3] >> (chunk & 7) ) & 1;
+} /* isChunkInFlight() */
+
+void RemoteFile::setChunkBits ( std::vector<uint8_t>& bits, size_t first, size_t end, bool value ) {
+    for ( size_t chunk = first; chunk < end; chunk++ ) {
+        if ( value ) {
+            bits[chunk >> 3] |= 1 << (chunk & 7);
+        }
+        else {
+            bits[chunk >> 3] &= ~(1 << (chunk & 7));
+        }
+    }
+} /* setChunkBits() */
+
+/*---------------------------------------------------------------*/
+
+int RemoteFile::fetchChunks ( size_t& first, size_t& end ) {
+    size_t
+        start = first * REMOTE_FILE_CHUNK_SIZE,
+        stop  = std::min( end * REMOTE_FILE_CHUNK_SIZE, size );
+
+    char range [64];
+    snprintf( range, sizeof(range), "%zu-%zu", start, stop - 1 );
+
+    // The request shares the connections of the download manager
+    std::vector<uint8_t> data;
+    Download_Response response;
+
+    int status = DOWNLOAD_MANAGER.fetch( url, range, false, data, response );
+
+    RUN_STATISTICS.remote_requests++;
+    RUN_STATISTICS.remote_bytes += data.size();
+
+    if ( status != SUCCESS ) {
+        return FILE_NOT_FOUND;
+    }
+
+    // The server ignored the range and sent the whole file
+    if ( response.http_code == 200 ) {
+        start = 0;
+        first = 0;
+        end = ( size + REMOTE_FILE_CHUNK_SIZE - 1 ) / REMOTE_FILE_CHUNK_SIZE;
+        stop = size;
+    }
+
+    if ( data.size() != stop - start ) {
+        return FILE_NOT_FOUND;
+    }
+
+    // (The chunks are only read once they are marked as cached, a chunk
+    // written by two requests gets the same bytes twice)
+    if ( pwrite(fd, data.data(), data.size(), start) != (ssize_t) data.size() ) {
+        return FILE_NOT_CREATABLE;
+    }
+
+    return SUCCESS;
+} /* fetchChunks() */
+
+/*---------------------------------------------------------------*/
+
+bool RemoteFile::loadChunkList () {
+    if ( !FILE_EXISTS(cache_path.data()) ) {
+        return false;
+    }
+
+    FILE* chunk_file = fopen( (cache_path + ".chunks").data(), "rb" );
+    if ( chunk_file == NULL ) {
+        return false;
+    }
+
+    uint32_t version = 0, validator_length = 0;
+    uint64_t cached_size = 0;
+
+    bool valid =
+        fread( &version, sizeof(uint32_t), 1, chunk_file ) == 1 &&
+        version == REMOTE_FILE_CHUNKS_VERSION &&
+        fread( &cached_size, sizeof(uint64_t), 1, chunk_file ) == 1 &&
+        cached_size == size &&
+        fread( &validator_length, sizeof(uint32_t), 1, chunk_file ) == 1 &&
+        validator_length == validator.size();
+
+    if ( valid ) {
+        std::string cached_validator( validator_length, '\0' );
+        valid =
+            fread( cached_validator.data(), 1, validator_length, chunk_file ) == validator_length &&
+            cached_validator == validator &&
+            fread( chunks.data(), 1, chunks.size(), chunk_file ) == chunks.size();
+    }
+
+    fclose( chunk_file );
+
+    if ( !valid ) {
+        std::fill( chunks.begin(), chunks.end(), 0 );
+    }
+
+    return valid;
+} /* loadChunkList() */
+
+/*---------------------------------------------------------------*/
+
+void RemoteFile::saveChunkList () {
+    FILE* chunk_file = fopen( (cache_path + ".chunks").data(), "wb" );
+    if ( chunk_file == NULL ) {
+        return;
+    }
+
+    uint32_t
+        version = REMOTE_FILE_CHUNKS_VERSION,
+        validator_length = validator.size();
+    uint64_t file_size = size;
+
+    fwrite( &version, sizeof(uint32_t), 1, chunk_file );
+    fwrite( &file_size, sizeof(uint64_t), 1, chunk_file );
+    fwrite( &validator_length, sizeof(uint32_t), 1, chunk_file );
+    fwrite( validator.data(), 1, validator_length, chunk_file );
+    fwrite( chunks.data(), 1, chunks.size(), chunk_file );
+
+    fclose( chunk_file );
+} /* saveChunkList() */
+
+/*---------------------------------------------------------------*/
+
+void RemoteFile::promoteCacheFile () {
+    if ( cache_path == file_path ) {
+        return;
+    }
+
+    size_t n_chunks = ( size + REMOTE_FILE_CHUNK_SIZE - 1 ) / REMOTE_FILE_CHUNK_SIZE;
+    for ( size_t chunk = 0; chunk < n_chunks; chunk++ ) {
+        if ( !hasChunk(chunk) ) {
+            return;
+        }
+    }
+
+    // (The descriptor stays valid, it refers to the renamed file)
+    if ( std::rename( cache_path.data(), file_path.data() ) == 0 ) {
+        std::remove( (cache_path + ".chunks").data() );
+        cache_path = file_path;
+    }
+} /* promoteCacheFile() */
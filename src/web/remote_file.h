@@ -0,0 +1,177 @@
+#ifndef REMOTE_FILE_H
+#define REMOTE_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <pthread.h>
+
+// Size of the parts of a remote file fetched at once in bytes
+#define REMOTE_FILE_CHUNK_SIZE 65536
+
+// Version of the format of the chunk lists (See RemoteFile)
+#define REMOTE_FILE_CHUNKS_VERSION 2
+
+/*
+File on a web server read with HTTP range requests
+
+Only the chunks of the file that are read are downloaded. They are
+stored in the sparse local cache file <file_path>.part, so every chunk
+is only downloaded once (also across runs). The chunks in the cache file
+are recorded in <file_path>.part.chunks (version (uint32), size of the
+file (uint64), length of the validator (uint32), validator, 1 bit per
+chunk). The validator is the ETag of the file (its Last-Modified date
+if the server sends no ETag). The cached chunks are only used while the
+server reports the same size and validator, otherwise the cache file is
+started again. Once all chunks are cached, the cache file is renamed to
+<file_path>.
+
+Servers ignoring range requests send the whole file with the first
+request, which is then cached completely.
+
+The requests run on the thread of DOWNLOAD_MANAGER, so they share its
+open connections with the downloads of whole files.
+*/
+class RemoteFile {
+public:
+    RemoteFile ();
+    ~RemoteFile ();
+
+    /*
+    Open a remote file
+    The size and the validator of the file are requested from the server
+
+    Args:
+     - url       : URL of the file
+     - file_path : Path of the local copy of the complete file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_NOT_CREATABLE
+    */
+    int open ( std::string url, std::string file_path );
+
+    /*
+    Read a part of the file (thread-safe, See fetch)
+
+    Args:
+     - offset  : Offset of the part in the file in bytes
+     - buf     : Array to store the part in
+     - n_bytes : Size of the part in bytes
+
+    Returns:
+     - Number of bytes read (less than n_bytes at the end of the file,
+       -1 if the part can't be fetched)
+    */
+    long read ( size_t offset, void* buf, size_t n_bytes );
+
+    /*
+    Make sure a part of the file is in the cache file (thread-safe)
+    Missing chunks are fetched with one range request per run of
+    consecutive missing chunks. The requests run without holding the
+    lock of the file, so threads fetching different chunks don't wait
+    for each other. A thread needing a chunk another thread is fetching
+    waits for that request.
+
+    Args:
+     - offset  : Offset of the part in the file in bytes
+     - n_bytes : Size of the part in bytes
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_NOT_CREATABLE
+    */
+    int fetch ( size_t offset, size_t n_bytes );
+
+    /*
+    Return the size of the file in bytes
+    */
+    size_t getSize () const;
+
+    /*
+    Return the ETag or Last-Modified date of the file on the server
+    (empty if the server sent none)
+    */
+    std::string getValidator () const;
+
+private:
+    std::string url, file_path, cache_path;
+
+    size_t size = 0;
+
+    // ETag or Last-Modified date of the file on the server
+    std::string validator;
+
+    // Cache file
+    int fd = -1;
+
+    // 1 bit per chunk, set if the chunk is in the cache file
+    std::vector<uint8_t> chunks;
+
+    // 1 bit per chunk, set while a thread fetches the chunk
+    std::vector<uint8_t> chunks_in_flight;
+
+    // Protects the chunk lists and the cache file name
+    pthread_mutex_t mutex;
+
+    // Signalled when a request for chunks is finished
+    pthread_cond_t chunks_cond;
+
+    /*
+    Return whether a chunk is in the cache file
+    */
+    bool hasChunk ( size_t chunk ) const;
+
+    /*
+    Return whether a thread is fetching a chunk
+    */
+    bool isChunkInFlight ( size_t chunk ) const;
+
+    /*
+    Set or clear the bits of the chunks first...end-1 in a chunk list
+    */
+    static void setChunkBits ( std::vector<uint8_t>& bits, size_t first, size_t end, bool value );
+
+    /*
+    Download the chunks first...end-1 with a range request into the cache file
+    (The file must not be locked, the chunks are not marked as cached)
+    If the server ignores the range and sends the whole file, first and
+    end are set to all chunks of the file
+
+    Returns:
+     - Status code
+        - SUCCESS
+
+        - FILE_NOT_FOUND
+        - FILE_NOT_CREATABLE
+    */
+    int fetchChunks ( size_t& first, size_t& end );
+
+    /*
+    Read the bitmap of the cached chunks from <cache_path>.chunks if the
+    size and the validator of the file are unchanged
+
+    Returns:
+     - Chunk list read?
+    */
+    bool loadChunkList ();
+
+    /*
+    Write the size and validator of the file and the bitmap of the
+    cached chunks to <cache_path>.chunks
+    */
+    void saveChunkList ();
+
+    /*
+    Rename the cache file to file_path if all chunks are cached
+    */
+    void promoteCacheFile ();
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "worker_pool.h"
+
+#include "shared.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+/*---------------------------------------------------------------*/
+
+WorkerPool WORKER_POOL;
+
+// Batch of the task the thread is running
+static thread_local Worker_Batch* current_batch = NULL;
+
+/*---------------------------------------------------------------*/
+
+WorkerPool::WorkerPool () {
+    pthread_mutex_init( &mutex, NULL );
+    pthread_cond_init( &queue_cond, NULL );
+    pthread_cond_init( &done_cond, NULL );
+} /* WorkerPool() */
+
+/*---------------------------------------------------------------*/
+
+WorkerPool::~WorkerPool () {
+    stop();
+
+    pthread_cond_destroy( &done_cond );
+    pthread_cond_destroy( &queue_cond );
+    pthread_mutex_destroy( &mutex );
+} /* ~WorkerPool() */
+
+/*---------------------------------------------------------------*/
+
+void WorkerPool::run ( Worker_Function function, std::vector<void*>& args ) {
+    if ( args.empty() ) {
+        return;
+    }
+
+    pthread_mutex_lock( &mutex );
+
+    resize( ( MAX_THREADS > 0 ) ? MAX_THREADS : NUM_CORES );
+
+    Worker_Batch batch = { (int) args.size(), current_batch };
+
+    for ( void* arg : args ) {
+        queue.push_back( { function, arg, &batch } );
+    }
+    pthread_cond_broadcast( &queue_cond );
+
+    // Callers waiting for an outer batch can help with this one
+    if ( batch.parent != NULL ) {
+        pthread_cond_broadcast( &done_cond );
+    }
+
+    // Only tasks of this batch are run, an unrelated task could wait for
+    // something the caller holds (e.g. a tile being loaded)
+    while ( batch.n_pending > 0 ) {
+        std::deque<Worker_Task>::iterator task = findTask( &batch );
+
+        if ( task != queue.end() ) {
+            runTask( task );
+        }
+        else {
+            pthread_cond_wait( &done_cond, &mutex );
+        }
+    }
+
+    pthread_mutex_unlock( &mutex );
+} /* run() */
+
+/*---------------------------------------------------------------*/
+
+void WorkerPool::resize ( int n_threads ) {
+    // Workers that left after an earlier shrink
+    for ( pthread_t thread : exited_threads ) {
+        pthread_join( thread, NULL );
+        std::erase_if( threads, [thread] ( pthread_t t ) { return pthread_equal(t, thread); } );
+    }
+    exited_threads.clear();
+
+    // The calling thread is one of the threads running the tasks
+    int n_workers = (int) threads.size() - n_surplus;
+    int n_wanted = std::max( n_threads - 1, 0 );
+
+    if ( n_wanted < n_workers ) {
+        n_surplus += n_workers - n_wanted;
+        pthread_cond_broadcast( &queue_cond );
+        return;
+    }
+
+    // Workers that were about to leave stay instead of being replaced
+    int n_kept = std::min( n_surplus, n_wanted - n_workers );
+    n_surplus -= n_kept;
+    n_workers += n_kept;
+
+    for ( int i = n_workers; i < n_wanted; i++ ) {
+        pthread_t thread;
+        if ( pthread_create( &thread, NULL, Thread_worker, (void*)this ) == 0 ) {
+            threads.push_back( thread );
+        }
+    }
+} /* resize() */
+
+/*---------------------------------------------------------------*/
+
+std::deque<Worker_Task>::iterator WorkerPool::findTask ( Worker_Batch* batch ) {
+    for ( auto task = queue.begin(); task != queue.end(); task++ ) {
+        for ( Worker_Batch* b = task->batch; b != NULL; b = b->parent ) {
+            if ( b == batch ) {
+                return task;
+            }
+        }
+    }
+
+    return queue.end();
+} /* findTask() */
+
+/*---------------------------------------------------------------*/
+
+void WorkerPool::runTask ( std::deque<Worker_Task>::iterator position ) {
+    Worker_Task task = *position;
+    queue.erase( position );
+
+    pthread_mutex_unlock( &mutex );
+
+    Worker_Batch* outer_batch = current_batch;
+    current_batch = task.batch;
+
+    task.function( task.arg );
+
+    current_batch = outer_batch;
+
+    pthread_mutex_lock( &mutex );
+
+    task.batch->n_pending--;
+    if ( task.batch->n_pending == 0 ) {
+        pthread_cond_broadcast( &done_cond );
+    }
+} /* runTask() */
+
+/*---------------------------------------------------------------*/
+
+void WorkerPool::stop () {
+    pthread_mutex_lock( &mutex );
+    stopping = true;
+    pthread_cond_broadcast( &queue_cond );
+    pthread_mutex_unlock( &mutex );
+
+    for ( pthread_t& thread : threads ) {
+        pthread_join( thread, NULL );
+    }
+    threads.clear();
+
+    pthread_mutex_lock( &mutex );
+    exited_threads.clear();
+    n_surplus = 0;
+    stopping = false;
+    pthread_mutex_unlock( &mutex );
+} /* stop() */
+
+/*---------------------------------------------------------------*/
+
+void* Thread_worker ( void* arg ) {
+    WorkerPool* pool = (WorkerPool*) arg;
+
+    pthread_mutex_lock( &pool->mutex );
+
+    while ( true ) {
+        while ( pool->queue.empty() && !pool->stopping && pool->n_surplus == 0 ) {
+            pthread_cond_wait( &pool->queue_cond, &pool->mutex );
+        }
+
+        // The pool was made smaller (See WorkerPool::resize)
+        if ( pool->n_surplus > 0 && !pool->stopping ) {
+            pool->n_surplus--;
+            pool->exited_threads.push_back( pthread_self() );
+            break;
+        }
+        if ( pool->queue.empty() ) {
+            break;
+        }
+
+        pool->runTask( pool->queue.begin() );
+    }
+
+    pthread_mutex_unlock( &pool->mutex );
+
+    return NULL;
+} /* Thread_worker() */
@@ -0,0 +1,123 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+/*
+Function of a task (like the start routine of a pthread)
+*/
+typedef void* (*Worker_Function) ( void* arg );
+
+/*
+Tasks passed to WorkerPool::run together
+*/
+struct Worker_Batch {
+    int n_pending;
+
+    // Batch of the task that called WorkerPool::run (NULL outside of tasks)
+    Worker_Batch* parent;
+};
+
+/*
+Task waiting for a worker thread
+*/
+struct Worker_Task {
+    Worker_Function function;
+    void* arg;
+    Worker_Batch* batch;
+};
+
+/*
+Worker threads shared by all operations that split their work into
+tasks (MAX_THREADS threads, the number of cores if MAX_THREADS is 0)
+
+Several threads can run tasks at the same time (e.g. several tiles
+loaded in parallel) without starting threads of their own, so the
+computing threads (ray parts, precalculation, decoding, masking and
+resampling) stay at the number of workers. The I/O threads of the
+prefetcher and of the DownloadManager are not part of the pool, they
+mostly wait for the disk or the network.
+*/
+class WorkerPool {
+public:
+    WorkerPool ();
+    ~WorkerPool ();
+
+    /*
+    Run a function for every argument on the worker threads and wait
+    until all calls are finished
+    The calling thread runs waiting tasks of the batch (and of batches
+    started by these tasks) while it waits, so run may also be called
+    from a task.
+    The worker threads are started with the first call, every call
+    adjusts their number to the current value of MAX_THREADS.
+
+    Args:
+     - function : Function to run
+     - args     : Arguments of the calls (e.g. pointers to thread data)
+    */
+    void run ( Worker_Function function, std::vector<void*>& args );
+
+    /*
+    Stop the worker threads (the waiting tasks are run first)
+    */
+    void stop ();
+
+private:
+    std::deque<Worker_Task> queue;
+
+    std::vector<pthread_t> threads;
+    bool stopping = false;
+
+    // Workers that still have to leave after the pool was made smaller
+    // and workers that left but were not joined yet
+    int n_surplus = 0;
+    std::vector<pthread_t> exited_threads;
+
+    pthread_mutex_t mutex;
+
+    // Signalled when a task is queued
+    pthread_cond_t queue_cond;
+
+    // Signalled when the last task of a batch is finished and when a
+    // task is queued (a waiting caller may run tasks of nested batches)
+    pthread_cond_t done_cond;
+
+    /*
+    Start or stop worker threads until the pool has the given number of
+    threads (the calling thread counts as one of them)
+    (The pool must be locked)
+
+    Args:
+     - n_threads : Number of threads running the tasks
+    */
+    void resize ( int n_threads );
+
+    /*
+    Run a task of the queue and count it as finished
+    (The pool must be locked, it is unlocked while the task runs)
+
+    Args:
+     - position : Position of the task in the queue
+    */
+    void runTask ( std::deque<Worker_Task>::iterator position );
+
+    /*
+    Find a queued task of a batch or of a batch nested in it
+
+    Returns:
+     - Position of the task in the queue, queue.end() if there is none
+    */
+    std::deque<Worker_Task>::iterator findTask ( Worker_Batch* batch );
+
+    friend void* Thread_worker ( void* arg );
+};
+
+void* Thread_worker ( void* arg );
+
+// Worker pool shared by the whole program
+extern WorkerPool WORKER_POOL;
+
+#endif
@@ -0,0 +1,144 @@
+"""
+Local HTTP stand-in for the tile servers (See tests/web/run_web_tests.py)
+
+Serves the files of a directory with HEAD and GET requests, single byte
+ranges ("Range: bytes=first-last") and the validators ETag and
+Last-Modified. The requests are logged and can be listed with
+GET /_requests (one line "METHOD path range" per request) and cleared
+with GET /_reset.
+
+Usage:
+    python3 http_stand_in.py DIR [--port PORT] [--ignore-range] [--delay SECONDS]
+
+ --ignore-range : Answer range requests with the whole file (200)
+ --delay        : Wait before answering a GET request (makes requests
+                  for the same file overlap)
+"""
+
+import argparse
+import email.utils
+import http.server
+import os
+import re
+import threading
+import time
+
+
+class StandInHandler ( http.server.BaseHTTPRequestHandler ):
+    # Set by createServer
+    directory = "."
+    ignore_range = False
+    delay = 0.0
+
+    requests = []
+    requests_lock = threading.Lock()
+
+    protocol_version = "HTTP/1.1"
+
+    def log_message ( self, format, *args ):
+        pass
+
+    def do_HEAD ( self ):
+        self.respond( False )
+
+    def do_GET ( self ):
+        if self.path == "/_requests":
+            with self.requests_lock:
+                body = "".join( line + "\n" for line in self.requests ).encode()
+            self.sendBody( 200, body )
+            return
+
+        if self.path == "/_reset":
+            with self.requests_lock:
+                self.requests.clear()
+            self.sendBody( 200, b"" )
+            return
+
+        if self.delay > 0.0:
+            time.sleep( self.delay )
+
+        self.respond( True )
+
+    def sendBody ( self, code, body ):
+        self.send_response( code )
+        self.send_header( "Content-Length", str(len(body)) )
+        self.end_headers()
+        self.wfile.write( body )
+
+    def respond ( self, with_body ):
+        range_header = self.headers.get( "Range", "" )
+
+        with self.requests_lock:
+            self.requests.append( "%s %s %s" % (self.command, self.path, range_header or "-") )
+
+        path = os.path.join( self.directory, self.path.lstrip("/") )
+        if not os.path.isfile( path ):
+            self.send_response( 404 )
+            self.send_header( "Content-Length", "0" )
+            self.end_headers()
+            return
+
+        stat = os.stat( path )
+        size = stat.st_size
+
+        first, last = 0, size - 1
+        partial = False
+
+        match = re.fullmatch( r"bytes=(\d+)-(\d*)", range_header )
+        if match and not self.ignore_range:
+            first = int( match.group(1) )
+            if match.group(2):
+                last = min( int(match.group(2)), size - 1 )
+            if first > last:
+                self.send_response( 416 )
+                self.send_header( "Content-Range", "bytes */%d" % size )
+                self.send_header( "Content-Length", "0" )
+                self.end_headers()
+                return
+            partial = True
+
+        self.send_response( 206 if partial else 200 )
+        self.send_header( "Content-Length", str(last - first + 1) )
+        if partial:
+            self.send_header( "Content-Range", "bytes %d-%d/%d" % (first, last, size) )
+        self.send_header( "Accept-Ranges", "none" if self.ignore_range else "bytes" )
+        self.send_header( "ETag", '"%x-%x"' % (size, stat.st_mtime_ns) )
+        self.send_header( "Last-Modified", email.utils.formatdate(stat.st_mtime, usegmt=True) )
+        self.end_headers()
+
+        if with_body:
+            with open( path, "rb" ) as file:
+                file.seek( first )
+                self.wfile.write( file.read(last - first + 1) )
+
+
+def createServer ( directory, port = 0, ignore_range = False, delay = 0.0 ):
+    """
+    Create a stand-in server (port 0 = any free port, See server_address)
+    The server is started with serve_forever
+    """
+    handler = type( "Handler", (StandInHandler,), {
+        "directory": directory,
+        "ignore_range": ignore_range,
+        "delay": delay,
+        "requests": [],
+        "requests_lock": threading.Lock(),
+    } )
+
+    server = http.server.ThreadingHTTPServer( ("127.0.0.1", port), handler )
+    server.daemon_threads = True
+
+    return server
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser( description = "Local HTTP stand-in for the tile servers" )
+    parser.add_argument( "dir" )
+    parser.add_argument( "--port", type = int, default = 8000 )
+    parser.add_argument( "--ignore-range", action = "store_true" )
+    parser.add_argument( "--delay", type = float, default = 0.0 )
+    args = parser.parse_args()
+
+    server = createServer( args.dir, args.port, args.ignore_range, args.delay )
+    print( "Serving %s on http://127.0.0.1:%d" % (args.dir, server.server_address[1]) )
+    server.serve_forever()
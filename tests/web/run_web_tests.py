@@ -0,0 +1,74 @@
+"""
+Run the tests of the remote files and the download manager (test_web)
+against local HTTP stand-ins serving a directory of synthetic files
+
+Usage:
+    python3 run_web_tests.py <path of the test_web executable>
+
+Three stand-ins serve the same directory: one answering normally, one
+ignoring range requests and one answering with a delay (so that
+requests for the same file overlap). The test_web executable is built
+with the CMake option BUILD_WEB_TESTS.
+"""
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import threading
+
+from http_stand_in import createServer
+
+# Size of the chunks of the remote files (See REMOTE_FILE_CHUNK_SIZE)
+CHUNK_SIZE = 65536
+
+
+def writeSyntheticFile ( path, size, seed ):
+    generator = random.Random( seed )
+    with open( path, "wb" ) as file:
+        file.write( bytes(generator.getrandbits(8) for _ in range(size)) )
+
+
+def startServer ( directory, **options ):
+    server = createServer( directory, **options )
+    threading.Thread( target = server.serve_forever, daemon = True ).start()
+    return server, "http://127.0.0.1:%d" % server.server_address[1]
+
+
+def main ():
+    if len( sys.argv ) != 2:
+        print( __doc__ )
+        return 2
+
+    with tempfile.TemporaryDirectory() as root:
+        data_dir = os.path.join( root, "www" )
+        work_dir = os.path.join( root, "work" )
+        os.mkdir( data_dir )
+        os.mkdir( work_dir )
+
+        # Files of a few chunks, not ending at a chunk border
+        writeSyntheticFile( os.path.join(data_dir, "range.bin"), 10 * CHUNK_SIZE + 123, 1 )
+        writeSyntheticFile( os.path.join(data_dir, "resume.bin"), 6 * CHUNK_SIZE + 7, 2 )
+        writeSyntheticFile( os.path.join(data_dir, "dedup.bin"), 3 * CHUNK_SIZE, 3 )
+        writeSyntheticFile( os.path.join(data_dir, "callback.bin"), 2 * CHUNK_SIZE + 1, 4 )
+
+        servers = []
+        server, url = startServer( data_dir )
+        servers.append( server )
+        server, url_no_range = startServer( data_dir, ignore_range = True )
+        servers.append( server )
+        server, url_delayed = startServer( data_dir, delay = 0.5 )
+        servers.append( server )
+
+        try:
+            result = subprocess.run( [sys.argv[1], url, url_no_range, url_delayed, data_dir, work_dir] )
+        finally:
+            for server in servers:
+                server.shutdown()
+
+    return result.returncode
+
+
+if __name__ == "__main__":
+    sys.exit( main() )
@@ -0,0 +1,403 @@
+/*
+Tests of the remote files and the download manager against the local
+HTTP stand-in (run with tests/web/run_web_tests.py)
+
+Usage: test_web <URL of the server> <URL of the server ignoring ranges>
+                <URL of the server answering with a delay>
+                <directory served> <working directory>
+*/
+
+#include "../../src/web/remote_file.h"
+#include "../../src/web/download_manager.h"
+#include "../../src/status_codes.h"
+#include "../../src/statistics.h"
+#include "../../src/utils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <pthread.h>
+#include <unistd.h>
+
+static std::string server_url, server_url_no_range, server_url_delayed, data_dir, work_dir;
+
+static int n_failed = 0;
+
+#define CHECK( condition ) \
+    if ( !(condition) ) { \
+        printf( "FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition ); \
+        n_failed++; \
+    }
+
+/*---------------------------------------------------------------*/
+
+/*
+Read a file of the served directory
+*/
+static std::vector<uint8_t> readServedFile ( std::string file_name ) {
+    std::vector<uint8_t> data;
+
+    FILE* file = fopen( buildFilepath(data_dir, file_name).data(), "rb" );
+    if ( file == NULL ) {
+        return data;
+    }
+
+    uint8_t buf [65536];
+    size_t n;
+    while ( (n = fread(buf, 1, sizeof(buf), file)) > 0 ) {
+        data.insert( data.end(), buf, buf + n );
+    }
+    fclose( file );
+
+    return data;
+} /* readServedFile() */
+
+/*
+Return the requests the server received since the last call
+(one line "METHOD path range" per request, See http_stand_in.py)
+*/
+static std::vector<std::string> takeServerRequests ( std::string url ) {
+    std::vector<uint8_t> data, reset_data;
+    Download_Response response;
+    DOWNLOAD_MANAGER.fetch( url + "/_requests", "", false, data, response );
+    DOWNLOAD_MANAGER.fetch( url + "/_reset", "", false, reset_data, response );
+
+    std::vector<std::string> requests;
+
+    std::string lines( data.begin(), data.end() );
+    size_t start = 0, end;
+    while ( (end = lines.find('\n', start)) != std::string::npos ) {
+        std::string line = lines.substr( start, end - start );
+        // The requests of the log itself are not counted
+        if ( line.find(" /_") == std::string::npos ) {
+            requests.push_back( line );
+        }
+        start = end + 1;
+    }
+
+    return requests;
+} /* takeServerRequests() */
+
+/*
+Count the requests with a method for a path
+*/
+static int countRequests ( std::vector<std::string>& requests, std::string method, std::string path ) {
+    int n = 0;
+    for ( std::string& request : requests ) {
+        if ( request.starts_with(method + " " + path + " ") ) {
+            n++;
+        }
+    }
+    return n;
+} /* countRequests() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Only the chunks of a part are fetched, with range requests
+*/
+static void testRangeFetch () {
+    std::vector<uint8_t> expected = readServedFile( "range.bin" );
+    std::string file_path = buildFilepath( work_dir, "range.bin" );
+
+    takeServerRequests( server_url );
+
+    RemoteFile remote;
+    CHECK( remote.open(server_url + "/range.bin", file_path) == SUCCESS );
+    CHECK( remote.getSize() == expected.size() );
+    CHECK( !remote.getValidator().empty() );
+
+    // Part crossing a chunk border in the middle of the file
+    size_t offset = 3 * REMOTE_FILE_CHUNK_SIZE - 100, n_bytes = 1000;
+    std::vector<uint8_t> part( n_bytes );
+
+    CHECK( remote.read(offset, part.data(), n_bytes) == (long) n_bytes );
+    CHECK( memcmp(part.data(), expected.data() + offset, n_bytes) == 0 );
+
+    std::vector<std::string> requests = takeServerRequests( server_url );
+    CHECK( countRequests(requests, "HEAD", "/range.bin") == 1 );
+    CHECK( countRequests(requests, "GET", "/range.bin") == 1 );
+
+    char range [64];
+    snprintf(
+        range, sizeof(range), "bytes=%d-%d",
+        2 * REMOTE_FILE_CHUNK_SIZE, 4 * REMOTE_FILE_CHUNK_SIZE - 1
+    );
+    CHECK( requests.size() == 2 && requests[1].ends_with(range) );
+
+    // Only the cache file exists until all chunks are fetched
+    CHECK( !FILE_EXISTS(file_path.data()) );
+    CHECK( FILE_EXISTS((file_path + ".part").data()) );
+
+    // Read to the end of the file (shorter than requested)
+    std::vector<uint8_t> tail( 2 * REMOTE_FILE_CHUNK_SIZE );
+    long n_tail = remote.read( expected.size() - 10, tail.data(), tail.size() );
+    CHECK( n_tail == 10 );
+    CHECK( memcmp(tail.data(), expected.data() + expected.size() - 10, 10) == 0 );
+
+    // Reading the whole file fetches the rest and renames the cache file
+    std::vector<uint8_t> all( expected.size() );
+    CHECK( remote.read(0, all.data(), all.size()) == (long) all.size() );
+    CHECK( all == expected );
+    CHECK( FILE_EXISTS(file_path.data()) );
+    CHECK( !FILE_EXISTS((file_path + ".part").data()) );
+} /* testRangeFetch() */
+
+/*
+A server ignoring range requests sends the whole file, which is cached
+*/
+static void testWholeFileFallback () {
+    std::vector<uint8_t> expected = readServedFile( "range.bin" );
+    std::string file_path = buildFilepath( work_dir, "fallback.bin" );
+
+    takeServerRequests( server_url_no_range );
+
+    RemoteFile remote;
+    CHECK( remote.open(server_url_no_range + "/range.bin", file_path) == SUCCESS );
+
+    std::vector<uint8_t> part( 1000 );
+    CHECK( remote.read(5 * REMOTE_FILE_CHUNK_SIZE, part.data(), part.size()) == (long) part.size() );
+    CHECK( memcmp(part.data(), expected.data() + 5 * REMOTE_FILE_CHUNK_SIZE, part.size()) == 0 );
+
+    // The complete file is in place, no further requests are needed
+    CHECK( FILE_EXISTS(file_path.data()) );
+    CHECK( remote.read(0, part.data(), part.size()) == (long) part.size() );
+    CHECK( memcmp(part.data(), expected.data(), part.size()) == 0 );
+
+    std::vector<std::string> requests = takeServerRequests( server_url_no_range );
+    CHECK( countRequests(requests, "GET", "/range.bin") == 1 );
+} /* testWholeFileFallback() */
+
+/*
+The chunks cached by an earlier run are used while the file is unchanged
+*/
+static void testChunkCacheResume () {
+    std::vector<uint8_t> expected = readServedFile( "resume.bin" );
+    std::string file_path = buildFilepath( work_dir, "resume.bin" );
+
+    size_t offset = 2 * REMOTE_FILE_CHUNK_SIZE + 10;
+    std::vector<uint8_t> part( 5000 );
+
+    {
+        RemoteFile remote;
+        CHECK( remote.open(server_url + "/resume.bin", file_path) == SUCCESS );
+        CHECK( remote.read(offset, part.data(), part.size()) == (long) part.size() );
+    }
+    takeServerRequests( server_url );
+
+    // Second run: only the header is requested
+    {
+        RemoteFile remote;
+        CHECK( remote.open(server_url + "/resume.bin", file_path) == SUCCESS );
+        std::fill( part.begin(), part.end(), 0 );
+        CHECK( remote.read(offset, part.data(), part.size()) == (long) part.size() );
+        CHECK( memcmp(part.data(), expected.data() + offset, part.size()) == 0 );
+    }
+
+    std::vector<std::string> requests = takeServerRequests( server_url );
+    CHECK( countRequests(requests, "HEAD", "/resume.bin") == 1 );
+    CHECK( countRequests(requests, "GET", "/resume.bin") == 0 );
+
+    // A changed file (other validator) is fetched again
+    std::vector<uint8_t> changed( expected.size() );
+    for ( size_t i = 0; i < changed.size(); i++ ) {
+        changed[i] = expected[i] ^ 0xFF;
+    }
+    FILE* file = fopen( buildFilepath(data_dir, "resume.bin").data(), "wb" );
+    fwrite( changed.data(), 1, changed.size(), file );
+    fclose( file );
+
+    {
+        RemoteFile remote;
+        CHECK( remote.open(server_url + "/resume.bin", file_path) == SUCCESS );
+        CHECK( remote.read(offset, part.data(), part.size()) == (long) part.size() );
+        CHECK( memcmp(part.data(), changed.data() + offset, part.size()) == 0 );
+    }
+
+    requests = takeServerRequests( server_url );
+    CHECK( countRequests(requests, "GET", "/resume.bin") == 1 );
+} /* testChunkCacheResume() */
+
+/*---------------------------------------------------------------*/
+
+/*
+Thread data of a concurrent download into memory (See testRequestDedup)
+*/
+struct Memory_Download_Data {
+    std::shared_ptr<std::vector<uint8_t>> data;
+    Download_Response response;
+    int status;
+};
+
+void* Thread_downloadIntoMemory ( void* arg ) {
+    Memory_Download_Data* download = (Memory_Download_Data*) arg;
+
+    download->status = DOWNLOAD_MANAGER.download(
+        server_url_delayed + "/dedup.bin", download->data, download->response
+    );
+
+    return NULL;
+} /* Thread_downloadIntoMemory() */
+
+/*
+Concurrent requests for the same file share one download
+*/
+static void testRequestDedup () {
+    std::vector<uint8_t> expected = readServedFile( "dedup.bin" );
+
+    takeServerRequests( server_url_delayed );
+
+    unsigned long joined_before = RUN_STATISTICS.downloads_joined;
+
+    const int n_threads = 8;
+    Memory_Download_Data downloads [n_threads];
+    pthread_t threads [n_threads];
+
+    for ( int i = 0; i < n_threads; i++ ) {
+        pthread_create( &threads[i], NULL, Thread_downloadIntoMemory, (void*)&downloads[i] );
+    }
+    for ( int i = 0; i < n_threads; i++ ) {
+        pthread_join( threads[i], NULL );
+    }
+
+    for ( int i = 0; i < n_threads; i++ ) {
+        CHECK( downloads[i].status == SUCCESS );
+        CHECK( downloads[i].data && *downloads[i].data == expected );
+        CHECK( downloads[i].response.http_code == 200 );
+        CHECK( !downloads[i].response.etag.empty() );
+    }
+
+    std::vector<std::string> requests = takeServerRequests( server_url_delayed );
+    CHECK( countRequests(requests, "GET", "/dedup.bin") == 1 );
+    CHECK( RUN_STATISTICS.downloads_joined - joined_before == n_threads - 1 );
+} /* testRequestDedup() */
+
+/*
+Calls of the completion callback (See testCompletionCallbacks)
+*/
+struct Callback_Calls {
+    std::atomic<int> n_calls { 0 };
+    std::atomic<int> status { -1 };
+};
+
+static void countCallback ( int status, void* arg ) {
+    Callback_Calls* calls = (Callback_Calls*) arg;
+    calls->status = status;
+    calls->n_calls++;
+} /* countCallback() */
+
+/*
+Wait until all callbacks were called (at most 10 s)
+*/
+static bool waitForCallbacks ( Callback_Calls* calls, int n ) {
+    for ( int i = 0; i < 1000; i++ ) {
+        bool done = true;
+        for ( int j = 0; j < n; j++ ) {
+            done = done && calls[j].n_calls > 0;
+        }
+        if ( done ) {
+            return true;
+        }
+        usleep( 10000 );
+    }
+    return false;
+} /* waitForCallbacks() */
+
+/*
+Every request of a file gets one call of its callback when the shared
+download is finished
+*/
+static void testCompletionCallbacks () {
+    std::vector<uint8_t> expected = readServedFile( "callback.bin" );
+    std::string file_path = buildFilepath( work_dir, "callback.bin" );
+
+    takeServerRequests( server_url_delayed );
+
+    const int n_requests = 4;
+    Callback_Calls calls [n_requests];
+
+    for ( int i = 0; i < n_requests; i++ ) {
+        DOWNLOAD_MANAGER.request( server_url_delayed + "/callback.bin", work_dir, countCallback, &calls[i] );
+    }
+
+    // A missing file is reported to its callback as well
+    Callback_Calls missing;
+    DOWNLOAD_MANAGER.request( server_url_delayed + "/missing.bin", work_dir, countCallback, &missing );
+
+    CHECK( waitForCallbacks(calls, n_requests) );
+    CHECK( waitForCallbacks(&missing, 1) );
+
+    for ( int i = 0; i < n_requests; i++ ) {
+        CHECK( calls[i].n_calls == 1 );
+        CHECK( calls[i].status == SUCCESS );
+    }
+    CHECK( missing.n_calls == 1 );
+    CHECK( missing.status == FILE_NOT_FOUND );
+
+    // The file is complete when the callbacks are called
+    std::vector<uint8_t> downloaded;
+    FILE* file = fopen( file_path.data(), "rb" );
+    CHECK( file != NULL );
+    if ( file != NULL ) {
+        uint8_t buf [65536];
+        size_t n;
+        while ( (n = fread(buf, 1, sizeof(buf), file)) > 0 ) {
+            downloaded.insert( downloaded.end(), buf, buf + n );
+        }
+        fclose( file );
+    }
+    CHECK( downloaded == expected );
+    CHECK( !FILE_EXISTS((file_path + ".download").data()) );
+    CHECK( !FILE_EXISTS(buildFilepath(work_dir, "missing.bin").data()) );
+
+    std::vector<std::string> requests = takeServerRequests( server_url_delayed );
+    CHECK( countRequests(requests, "GET", "/callback.bin") == 1 );
+
+    // A callback removed with cancel is not called anymore
+    Callback_Calls cancelled, kept;
+    DOWNLOAD_MANAGER.request( server_url_delayed + "/dedup.bin", work_dir, countCallback, &cancelled );
+    DOWNLOAD_MANAGER.request( server_url_delayed + "/dedup.bin", work_dir, countCallback, &kept );
+    DOWNLOAD_MANAGER.cancel( &cancelled );
+
+    CHECK( waitForCallbacks(&kept, 1) );
+    CHECK( kept.status == SUCCESS );
+    CHECK( cancelled.n_calls == 0 );
+} /* testCompletionCallbacks() */
+
+/*---------------------------------------------------------------*/
+
+int main ( int argc, char** argv ) {
+    if ( argc != 6 ) {
+        printf(
+            "Usage: %s <server URL> <server URL ignoring ranges> <server URL with delay> "
+            "<served directory> <working directory>\n", argv[0]
+        );
+        return 2;
+    }
+
+    server_url = argv[1];
+    server_url_no_range = argv[2];
+    server_url_delayed = argv[3];
+    data_dir = argv[4];
+    work_dir = argv[5];
+
+    testRangeFetch();
+    testWholeFileFallback();
+    testChunkCacheResume();
+
+    testRequestDedup();
+    testCompletionCallbacks();
+
+    DOWNLOAD_MANAGER.stop();
+
+    if ( n_failed > 0 ) {
+        printf( "%d checks failed\n", n_failed );
+        return 1;
+    }
+
+    printf( "All checks passed\n" );
+    return 0;
+} /* main() */